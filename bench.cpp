@@ -0,0 +1,1868 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Performance benchmarks for the storage and buffer layers.  Built from the
+ * same sources as badgerdb_main, with this file taking the place of main.cpp.
+ *
+ *   bench                      run every benchmark
+ *   bench <name>... [input]...  run only the named benchmarks
+ *
+ * Arguments that are not benchmark names are passed to the selected benchmarks
+ * as inputs; "policies" replays them as page reference traces.
+ *
+ * Scratch files are created in the current directory and removed afterwards.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "btree.h"
+#include "buffer.h"
+#include "bufHashTbl.h"
+#include "file.h"
+#include "filescan.h"
+#include "numaTopology.h"
+#include "page.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(const Clock::time_point& start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void removeIfExists(const std::string& name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch(const FileNotFoundException&)
+	{
+	}
+}
+
+/**
+ * Creates a blob file holding numPages pages (page numbers 1 to numPages).
+ */
+void createBlobFile(const std::string& name, const PageId numPages, const std::size_t pageSize = Page::SIZE)
+{
+	removeIfExists(name);
+	BlobFile file = BlobFile::create(name, false, pageSize);
+	for (PageId i = 0; i < numPages; i++)
+	{
+		PageId pageNo;
+		file.allocatePage(pageNo);
+	}
+}
+
+/**
+ * Record layout of the relations used by the benchmarks; same as main.cpp.
+ */
+struct BenchRecord
+{
+	int i;
+	double d;
+	char s[64];
+};
+
+/**
+ * Creates a heap file holding numRecords records with keys 0 to numRecords - 1
+ * and returns the number of pages used.
+ */
+PageId createRelation(const std::string& name, const int numRecords)
+{
+	removeIfExists(name);
+	PageFile file = PageFile::create(name);
+
+	BenchRecord record;
+	std::memset(&record, ' ', sizeof(record));
+	PageId numPages = 1;
+	PageId pageNo;
+	Page page = file.allocatePage(pageNo);
+	for (int i = 0; i < numRecords; i++)
+	{
+		record.i = i;
+		record.d = i;
+		std::string data(reinterpret_cast<char*>(&record), sizeof(record));
+		try
+		{
+			page.insertRecord(data);
+		}
+		catch(const InsufficientSpaceException&)
+		{
+			file.writePage(pageNo, page);
+			page = file.allocatePage(pageNo);
+			numPages++;
+			page.insertRecord(data);
+		}
+	}
+	file.writePage(pageNo, page);
+	return numPages;
+}
+
+/**
+ * Small xorshift generator so that worker threads do not share rand() state.
+ */
+struct Rng
+{
+	std::uint64_t state;
+
+	Rng(std::uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+	std::uint32_t next(std::uint32_t bound)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return (std::uint32_t) (state % bound);
+	}
+};
+
+std::vector<unsigned> threadCounts()
+{
+	unsigned maxThreads = std::thread::hardware_concurrency();
+	if (maxThreads < 4)
+		maxThreads = 4;
+
+	std::vector<unsigned> counts;
+	for (unsigned n = 1; n <= maxThreads; n *= 2)
+		counts.push_back(n);
+	return counts;
+}
+
+// -----------------------------------------------------------------------------
+// scaling: readPage/unPinPage throughput against the number of threads
+// -----------------------------------------------------------------------------
+
+/**
+ * Runs numThreads threads pinning and unpinning random pages and returns the
+ * combined number of readPage/unPinPage pairs per second.
+ */
+double scalingRun(BufMgr* bufMgr, File* file, const PageId numPages, const unsigned numThreads, const int opsPerThread)
+{
+	std::vector<std::thread> workers;
+	Clock::time_point start = Clock::now();
+	for (unsigned t = 0; t < numThreads; t++)
+	{
+		workers.push_back(std::thread([=]() {
+			Rng rng(t + 1);
+			Page* page;
+			for (int i = 0; i < opsPerThread; i++)
+			{
+				PageId pageNo = 1 + rng.next(numPages);
+				bufMgr->readPage(file, pageNo, page);
+				bufMgr->unPinPage(file, pageNo, false);
+			}
+		}));
+	}
+	for (unsigned t = 0; t < numThreads; t++)
+		workers[t].join();
+
+	return numThreads * opsPerThread / secondsSince(start);
+}
+
+void printScaling(BufMgr* bufMgr, const unsigned numThreads, const double opsPerSec)
+{
+	std::cout << "  threads:" << numThreads
+		<< "  partitions:" << bufMgr->getNumPartitions()
+		<< "  ops/s:" << (std::uint64_t) opsPerSec << std::endl;
+}
+
+void benchScaling(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.scaling";
+	const PageId numPages = 2048;
+	createBlobFile(name, numPages);
+
+	{
+		BlobFile file = BlobFile::open(name);
+
+		std::cout << "all hits (pool holds the whole file)" << std::endl;
+		for (unsigned n : threadCounts())
+		{
+			BufMgr bufMgr(2 * numPages, n);
+			scalingRun(&bufMgr, &file, numPages, 1, numPages);	// warm up
+			printScaling(&bufMgr, n, scalingRun(&bufMgr, &file, numPages, n, 400000 / n));
+			bufMgr.flushFile(&file);
+		}
+
+		std::cout << "hits and misses (pool holds a quarter of the file)" << std::endl;
+		for (unsigned n : threadCounts())
+		{
+			BufMgr bufMgr(numPages / 4, n);
+			printScaling(&bufMgr, n, scalingRun(&bufMgr, &file, numPages, n, 100000 / n));
+			bufMgr.flushFile(&file);
+		}
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// hashtable: page table hit lookups, open addressing against chained buckets
+// -----------------------------------------------------------------------------
+
+/**
+ * The chained page table BufHashTbl used before it moved to open addressing,
+ * kept here as the baseline: one heap bucket per entry and the File pointer
+ * truncated to an int and added to the page number as the hash.
+ */
+class ChainedHashTbl
+{
+ public:
+	struct Bucket
+	{
+		const File* file;
+		PageId pageNo;
+		FrameId frameNo;
+		Bucket* next;
+	};
+
+	ChainedHashTbl(const int htSize) : HTSIZE(htSize)
+	{
+		ht = new Bucket* [htSize];
+		for (int i = 0; i < HTSIZE; i++)
+			ht[i] = NULL;
+	}
+
+	~ChainedHashTbl()
+	{
+		for (int i = 0; i < HTSIZE; i++)
+		{
+			while (ht[i])
+			{
+				Bucket* tmp = ht[i];
+				ht[i] = ht[i]->next;
+				delete tmp;
+			}
+		}
+		delete [] ht;
+	}
+
+	void insert(const File* file, const PageId pageNo, const FrameId frameNo)
+	{
+		int index = hash(file, pageNo);
+		Bucket* tmp = new Bucket;
+		tmp->file = file;
+		tmp->pageNo = pageNo;
+		tmp->frameNo = frameNo;
+		tmp->next = ht[index];
+		ht[index] = tmp;
+	}
+
+	bool lookup(const File* file, const PageId pageNo, FrameId &frameNo)
+	{
+		for (Bucket* tmp = ht[hash(file, pageNo)]; tmp; tmp = tmp->next)
+		{
+			if (tmp->file == file && tmp->pageNo == pageNo)
+			{
+				frameNo = tmp->frameNo;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void remove(const File* file, const PageId pageNo)
+	{
+		Bucket** link = &ht[hash(file, pageNo)];
+		while (*link && !((*link)->file == file && (*link)->pageNo == pageNo))
+			link = &(*link)->next;
+		if (*link)
+		{
+			Bucket* tmp = *link;
+			*link = tmp->next;
+			delete tmp;
+		}
+	}
+
+ private:
+	int hash(const File* file, const PageId pageNo)
+	{
+		int tmp = (long)file;
+		int value = (tmp + pageNo) % HTSIZE;
+		return value < 0 ? value + HTSIZE : value;
+	}
+
+	int HTSIZE;
+	Bucket** ht;
+};
+
+/**
+ * Fills a table with numEntries pages spread over files, then times random hit
+ * lookups and a remove/insert churn that mimics eviction.  Prints the rates.
+ */
+template <class Table>
+void hashTableRun(const char* label, Table& table, const std::vector<File*>& files, const std::uint32_t numEntries)
+{
+	const PageId pagesPerFile = numEntries / files.size();
+	for (std::uint32_t i = 0; i < numEntries; i++)
+		table.insert(files[i % files.size()], 1 + i / files.size(), i);
+
+	const int numLookups = 20000000;
+	Rng rng(7);
+	FrameId frameNo = 0;
+	std::uint64_t checksum = 0;
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < numLookups; i++)
+	{
+		std::uint32_t entry = rng.next(numEntries);
+		table.lookup(files[entry % files.size()], 1 + entry / files.size(), frameNo);
+		checksum += frameNo;
+	}
+	double lookupSecs = secondsSince(start);
+
+	// evict a random page and bring in a page that is not resident yet
+	const int numChurns = 2000000;
+	start = Clock::now();
+	for (int i = 0; i < numChurns; i++)
+	{
+		std::uint32_t entry = rng.next(numEntries);
+		File* file = files[entry % files.size()];
+		PageId pageNo = 1 + entry / files.size();
+		table.remove(file, pageNo);
+		table.insert(file, pageNo + pagesPerFile, entry);
+		table.remove(file, pageNo + pagesPerFile);
+		table.insert(file, pageNo, entry);
+	}
+	double churnSecs = secondsSince(start);
+
+	std::cout << "  " << label
+		<< "  entries:" << numEntries
+		<< "  hit lookups/s:" << (std::uint64_t) (numLookups / lookupSecs)
+		<< "  remove+insert pairs/s:" << (std::uint64_t) (2 * numChurns / churnSecs)
+		<< "  (checksum " << checksum % 1000 << ")" << std::endl;
+}
+
+void benchHashTable(const std::vector<std::string>& /* inputs */)
+{
+	const int numFiles = 4;
+	std::vector<std::string> names;
+	std::vector<File*> files;
+	for (int i = 0; i < numFiles; i++)
+	{
+		names.push_back("bench.hashtable." + std::to_string(i));
+		removeIfExists(names[i]);
+		files.push_back(new BlobFile(names[i], true));
+	}
+
+	const std::uint32_t sizes[] = {1024, 65536, 1048576};
+	for (std::uint32_t numEntries : sizes)
+	{
+		{
+			// sized the way BufMgr used to size it
+			ChainedHashTbl chained(((((int) (numEntries * 1.2))*2)/2)+1);
+			hashTableRun("chained", chained, files, numEntries);
+		}
+		{
+			BufHashTbl open(numEntries);
+			hashTableRun("open   ", open, files, numEntries);
+		}
+	}
+
+	for (int i = 0; i < numFiles; i++)
+	{
+		delete files[i];
+		File::remove(names[i]);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// coldscan: FileScan over a relation much larger than the buffer pool
+// -----------------------------------------------------------------------------
+
+void benchColdScan(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.coldscan";
+	const int numRecords = 100000;
+	const PageId numPages = createRelation(name, numRecords);
+
+	for (int run = 0; run < 3; run++)
+	{
+		BufMgr bufMgr(64);
+		int numScanned = 0;
+		Clock::time_point start = Clock::now();
+		{
+			FileScan scan(name, &bufMgr);
+			try
+			{
+				RecordId rid;
+				while (true)
+				{
+					scan.scanNext(rid);
+					numScanned++;
+				}
+			}
+			catch(const EndOfFileException&)
+			{
+			}
+		}
+		double secs = secondsSince(start);
+
+		BufStats stats = bufMgr.getBufStats();
+		std::cout << "  pages:" << numPages << "  records:" << numScanned
+			<< "  pages/s:" << (std::uint64_t) (numPages / secs)
+			<< "  diskreads:" << stats.diskreads
+			<< "  read-ahead:" << stats.prefetches << " (hits:" << stats.prefetchhits
+			<< " waited:" << stats.prefetchwaits << " unused:" << stats.prefetchunused << ")" << std::endl;
+	}
+
+	File::remove(name);
+
+	// the same miss path without FileScan's own page reads around it
+	const std::string blobName = "bench.coldscan.blob";
+	createBlobFile(blobName, numPages);
+	{
+		BlobFile file = BlobFile::open(blobName);
+		for (int run = 0; run < 3; run++)
+		{
+			BufMgr bufMgr(64);
+			Page* page;
+			Clock::time_point start = Clock::now();
+			for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+			{
+				bufMgr.readPage(&file, pageNo, page);
+				bufMgr.unPinPage(&file, pageNo, false);
+			}
+			double secs = secondsSince(start);
+			std::cout << "  sequential readPage misses/s:" << (std::uint64_t) (numPages / secs) << std::endl;
+			bufMgr.flushFile(&file);
+		}
+	}
+	File::remove(blobName);
+}
+
+// -----------------------------------------------------------------------------
+// scanring: hot pages surviving a large FileScan, with and without a ring
+// -----------------------------------------------------------------------------
+
+/**
+ * Reads every hot page once and returns how many of them missed the pool.
+ */
+int readHotSet(BufMgr& bufMgr, BlobFile& file, const PageId numPages)
+{
+	const std::uint64_t before = bufMgr.getBufStats().diskreads;
+	Page* page;
+	for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+	{
+		bufMgr.readPage(&file, pageNo, page);
+		bufMgr.unPinPage(&file, pageNo, false);
+	}
+	return (int) (bufMgr.getBufStats().diskreads - before);
+}
+
+void benchScanRing(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.scanring";
+	const std::string hotName = "bench.scanring.hot";
+	const PageId numPages = createRelation(name, 100000);
+	const PageId numHotPages = 128;
+	createBlobFile(hotName, numHotPages);
+
+	const std::uint32_t ringSizes[] = {0, BufAccessStrategy::DEFAULT_RING_SIZE};
+	{
+		BlobFile hotFile = BlobFile::open(hotName);
+		for (std::size_t r = 0; r < sizeof(ringSizes) / sizeof(ringSizes[0]); r++)
+		{
+			// the hot set, standing in for B-tree inner pages, fills half the pool
+			BufMgr bufMgr(256);
+			readHotSet(bufMgr, hotFile, numHotPages);
+			readHotSet(bufMgr, hotFile, numHotPages);
+
+			Clock::time_point start = Clock::now();
+			{
+				FileScan scan(name, &bufMgr, ringSizes[r]);
+				try
+				{
+					RecordId rid;
+					while (true)
+						scan.scanNext(rid);
+				}
+				catch(const EndOfFileException&)
+				{
+				}
+			}
+			double secs = secondsSince(start);
+
+			const int misses = readHotSet(bufMgr, hotFile, numHotPages);
+			std::cout << "  ring:" << ringSizes[r] << "  scan pages:" << numPages
+				<< "  pages/s:" << (std::uint64_t) (numPages / secs)
+				<< "  hot pages reread after scan:" << misses << "/" << numHotPages << std::endl;
+			bufMgr.flushFile(&hotFile);
+		}
+	}
+
+	File::remove(name);
+	File::remove(hotName);
+}
+
+// -----------------------------------------------------------------------------
+// bgwriter: how often eviction has to write a dirty victim itself
+// -----------------------------------------------------------------------------
+
+void benchBgWriter(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.bgwriter";
+	const PageId numPages = 4096;
+	const int numOps = 200000;
+	createBlobFile(name, numPages);
+
+	{
+		BlobFile file = BlobFile::open(name);
+		for (int withWriter = 0; withWriter < 2; withWriter++)
+		{
+			BufMgr bufMgr(512);
+			if (withWriter)
+			{
+				BgWriterConfig config;
+				config.intervalMs = 1;
+				bufMgr.startBgWriter(config);
+			}
+
+			// bursts of skewed reads, one in four of them updating the page, with
+			// idle time in between for the writer to use
+			Rng rng(7);
+			Page* page;
+			double secs = 0;
+			for (int op = 0; op < numOps; )
+			{
+				Clock::time_point start = Clock::now();
+				for (int i = 0; i < 1000; i++, op++)
+				{
+					std::uint64_t r = rng.next(numPages);
+					PageId pageNo = 1 + (PageId) (r * r / numPages);
+					bufMgr.readPage(&file, pageNo, page);
+					bufMgr.unPinPage(&file, pageNo, op % 4 == 0);
+				}
+				secs += secondsSince(start);
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			}
+			bufMgr.stopBgWriter();
+
+			BufStats stats = bufMgr.getBufStats();
+			std::cout << "  background writer:" << (withWriter ? "on " : "off")
+				<< "  ops/s in bursts:" << (std::uint64_t) (numOps / secs)
+				<< "  diskreads:" << stats.diskreads
+				<< "  dirty evictions:" << stats.dirtyevictions
+				<< "  background writes:" << stats.bgwrites << std::endl;
+			bufMgr.flushFile(&file);
+		}
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// pagehandle: cached page hits unpinned by page number or through a PageHandle
+// -----------------------------------------------------------------------------
+
+void benchPageHandle(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.pagehandle";
+	const PageId numPages = 1024;
+	const int numOps = 2000000;
+	createBlobFile(name, numPages);
+
+	{
+		BlobFile file = BlobFile::open(name);
+		BufMgr bufMgr(numPages);
+		Page* page;
+		for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+		{
+			bufMgr.readPage(&file, pageNo, page);
+			bufMgr.unPinPage(&file, pageNo, false);
+		}
+
+		for (int run = 0; run < 3; run++)
+		{
+			Rng rng(run);
+			Clock::time_point start = Clock::now();
+			for (int op = 0; op < numOps; op++)
+			{
+				PageId pageNo = 1 + rng.next(numPages);
+				bufMgr.readPage(&file, pageNo, page);
+				bufMgr.unPinPage(&file, pageNo, false);
+			}
+			double byNumber = secondsSince(start);
+
+			rng = Rng(run);
+			start = Clock::now();
+			for (int op = 0; op < numOps; op++)
+			{
+				PageHandle handle = bufMgr.readPage(&file, 1 + rng.next(numPages));
+			}
+			double byHandle = secondsSince(start);
+
+			std::cout << "  read+unpin/s  unPinPage:" << (std::uint64_t) (numOps / byNumber)
+				<< "  PageHandle:" << (std::uint64_t) (numOps / byHandle) << std::endl;
+		}
+		bufMgr.flushFile(&file);
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// flushfile: cost of flushing a small file as the pool grows
+// -----------------------------------------------------------------------------
+
+void benchFlushFile(const std::vector<std::string>& /* inputs */)
+{
+	const int numFiles = 64;
+	const PageId pagesPerFile = 4;
+	const std::uint32_t poolSizes[] = {1024, 8192, 32768};
+
+	std::vector<std::string> names;
+	for (int f = 0; f < numFiles; f++)
+	{
+		names.push_back("bench.flushfile." + std::to_string(f));
+		createBlobFile(names.back(), pagesPerFile);
+	}
+
+	for (std::size_t s = 0; s < sizeof(poolSizes) / sizeof(poolSizes[0]); s++)
+	{
+		BufMgr bufMgr(poolSizes[s]);
+		std::vector<BlobFile> files;
+		for (int f = 0; f < numFiles; f++)
+			files.push_back(BlobFile::open(names[f]));
+
+		double secs = 0;
+		const int rounds = 20;
+		for (int round = 0; round < rounds; round++)
+		{
+			Page* page;
+			for (int f = 0; f < numFiles; f++)
+			{
+				for (PageId pageNo = pagesPerFile; pageNo >= 1; pageNo--)
+				{
+					bufMgr.readPage(&files[f], pageNo, page);
+					bufMgr.unPinPage(&files[f], pageNo, true);
+				}
+			}
+
+			Clock::time_point start = Clock::now();
+			for (int f = 0; f < numFiles; f++)
+				bufMgr.flushFile(&files[f]);
+			secs += secondsSince(start);
+		}
+
+		std::cout << "  frames:" << poolSizes[s] << "  us per flushFile of " << pagesPerFile << " dirty pages:"
+			<< secs * 1e6 / (rounds * numFiles) << std::endl;
+	}
+
+	for (int f = 0; f < numFiles; f++)
+		File::remove(names[f]);
+}
+
+// -----------------------------------------------------------------------------
+// coalesce: write-back of a large file page by page and in runs
+// -----------------------------------------------------------------------------
+
+void benchCoalesce(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.coalesce";
+	const PageId numPages = 8192;
+	createBlobFile(name, numPages);
+
+	{
+		BlobFile file = BlobFile::open(name);
+		BufMgr bufMgr(numPages);
+
+		// every page dirty, then only every other one so there is nothing to merge
+		for (PageId stride = 1; stride <= 2; stride++)
+		{
+			std::vector<Page> pages;
+			Page* page;
+			for (PageId pageNo = 1; pageNo <= numPages; pageNo += stride)
+			{
+				bufMgr.readPage(&file, pageNo, page);
+				pages.push_back(*page);
+				bufMgr.unPinPage(&file, pageNo, true);
+			}
+
+			Clock::time_point start = Clock::now();
+			for (std::size_t i = 0; i < pages.size(); i++)
+				file.writePage(1 + i * stride, pages[i]);
+			double byPage = secondsSince(start);
+
+			bufMgr.clearBufStats();
+			start = Clock::now();
+			bufMgr.flushFile(&file);
+			double coalesced = secondsSince(start);
+
+			BufStats stats = bufMgr.getBufStats();
+			const double mb = pages.size() * (double) Page::SIZE / (1 << 20);
+			std::cout << "  dirty pages:" << pages.size() << " (stride " << stride << ")"
+				<< "  MB/s  writePage:" << (std::uint64_t) (mb / byPage)
+				<< "  flushFile:" << (std::uint64_t) (mb / coalesced)
+				<< "  write calls saved:" << stats.coalescedwrites
+				<< "  bytes in runs:" << stats.coalescedbytes << std::endl;
+		}
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// direct: buffered against direct I/O, and who ends up caching the file
+// -----------------------------------------------------------------------------
+
+/**
+ * Resident set size of this process in MB.
+ */
+double residentMB()
+{
+	std::ifstream statm("/proc/self/statm");
+	std::uint64_t size = 0, resident = 0;
+	statm >> size >> resident;
+	return resident * (double) sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+/**
+ * MB of the named file held in the kernel page cache.  With dropFirst set the
+ * file is written back and evicted from the cache before counting.
+ */
+double pageCacheMB(const std::string& name, const bool dropFirst)
+{
+	int fd = ::open(name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return 0;
+	struct stat status;
+	fstat(fd, &status);
+	if (dropFirst)
+	{
+		fdatasync(fd);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	}
+
+	const long pageSize = sysconf(_SC_PAGESIZE);
+	std::size_t cached = 0;
+	void* map = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map != MAP_FAILED)
+	{
+		std::vector<unsigned char> resident((status.st_size + pageSize - 1) / pageSize);
+		if (mincore(map, status.st_size, &resident[0]) == 0)
+			for (std::size_t i = 0; i < resident.size(); i++)
+				cached += resident[i] & 1;
+		munmap(map, status.st_size);
+	}
+	::close(fd);
+	return cached * (double) pageSize / (1 << 20);
+}
+
+void benchDirect(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.direct";
+	const PageId numPages = 8192;
+	const int numOps = 100000;
+	createBlobFile(name, numPages);
+
+	for (int direct = 0; direct < 2; direct++)
+	{
+		pageCacheMB(name, true);
+		BlobFile file = BlobFile::open(name, direct != 0);
+		BufMgr bufMgr(2048);
+
+		// skewed reads over a file four times the pool, one in four updating the page
+		Rng rng(11);
+		Page* page;
+		Clock::time_point start = Clock::now();
+		for (int op = 0; op < numOps; op++)
+		{
+			std::uint64_t r = rng.next(numPages);
+			PageId pageNo = 1 + (PageId) (r * r / numPages);
+			bufMgr.readPage(&file, pageNo, page);
+			bufMgr.unPinPage(&file, pageNo, op % 4 == 0);
+		}
+		bufMgr.flushFile(&file);
+		double secs = secondsSince(start);
+
+		std::cout << "  " << (file.directIO() ? "direct  " : "buffered")
+			<< (direct && !file.directIO() ? " (O_DIRECT refused)" : "")
+			<< "  ops/s:" << (std::uint64_t) (numOps / secs)
+			<< "  diskreads:" << bufMgr.getBufStats().diskreads
+			<< "  RSS MB:" << residentMB()
+			<< "  file MB in page cache:" << pageCacheMB(name, false)
+			<< "  pool on hugetlb:" << (bufMgr.poolOnHugeTlb() ? "yes" : "no") << std::endl;
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// resize: growing and shrinking the pool under concurrent readers
+// -----------------------------------------------------------------------------
+
+void benchResize(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.resize";
+	const PageId numPages = 8192;
+	const std::uint32_t sizes[] = {1024, 4096, 512, 8192, 1024};
+	const unsigned numThreads = 4;
+	createBlobFile(name, numPages);
+
+	{
+		BlobFile file = BlobFile::open(name);
+		BufMgr bufMgr(std::vector<PageSizeClass>(1, PageSizeClass(Page::SIZE, sizes[0], numPages)));
+
+		// stamp every page with its number, in its last bytes
+		for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+		{
+			PageHandle handle = bufMgr.readPage(&file, pageNo);
+			std::memcpy(reinterpret_cast<char*>(handle.page()) + Page::SIZE - sizeof(PageId), &pageNo, sizeof(PageId));
+			handle.markDirty();
+		}
+		bufMgr.flushFile(&file);
+
+		// readers check the stamps, and rewrite one page in eight, while the pool changes size
+		std::atomic<bool> stop(false);
+		std::atomic<std::uint64_t> ops(0), mismatches(0);
+		std::vector<std::thread> readers;
+		for (unsigned t = 0; t < numThreads; t++)
+		{
+			readers.push_back(std::thread([&, t]() {
+				Rng rng(t + 1);
+				std::uint64_t n = 0;
+				for (; !stop; ops.fetch_add(1, std::memory_order_relaxed))
+				{
+					std::uint64_t r = rng.next(numPages);
+					PageId pageNo = 1 + (PageId) (r * r / numPages);
+					PageHandle handle = bufMgr.readPage(&file, pageNo);
+					PageId stamp;
+					std::memcpy(&stamp, reinterpret_cast<char*>(handle.page()) + Page::SIZE - sizeof(PageId), sizeof(PageId));
+					if (stamp != pageNo)
+						mismatches++;
+					if (++n % 8 == 0)
+						handle.markDirty();
+				}
+			}));
+		}
+
+		for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+		{
+			Clock::time_point start = Clock::now();
+			std::uint32_t frames = bufMgr.resize(sizes[s]);
+			double resizeSecs = secondsSince(start);
+
+			// let the pool warm up to its new size before measuring
+			std::this_thread::sleep_for(std::chrono::milliseconds(300));
+			bufMgr.clearBufStats();
+			const std::uint64_t opsBefore = ops;
+			std::this_thread::sleep_for(std::chrono::milliseconds(300));
+			const double reads = (double) (ops - opsBefore);
+			BufStats stats = bufMgr.getBufStats();
+			std::cout << "  frames:" << frames << "  resize ms:" << resizeSecs * 1e3
+				<< "  hit ratio after:" << (reads > 0 ? 1.0 - stats.diskreads / reads : 0)
+				<< "  RSS MB:" << residentMB() << std::endl;
+		}
+
+		stop = true;
+		for (unsigned t = 0; t < numThreads; t++)
+			readers[t].join();
+		std::cout << "  reads:" << ops << "  stamp mismatches:" << mismatches << std::endl;
+		bufMgr.flushFile(&file);
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// warmstart: a restart with the saved hot set against a cold one
+// -----------------------------------------------------------------------------
+
+/**
+ * Runs numOps lookups skewed towards the start of the file, the same sequence
+ * for the same seed, and returns the seconds taken.
+ */
+double skewedReads(BufMgr& bufMgr, BlobFile& file, const PageId numPages, const int numOps, const std::uint64_t seed)
+{
+	Rng rng(seed);
+	Page* page;
+	Clock::time_point start = Clock::now();
+	for (int op = 0; op < numOps; op++)
+	{
+		std::uint64_t r = rng.next(numPages);
+		PageId pageNo = 1 + (PageId) (r * r / numPages * r / numPages);
+		bufMgr.readPage(&file, pageNo, page);
+		bufMgr.unPinPage(&file, pageNo, false);
+	}
+	return secondsSince(start);
+}
+
+void benchWarmStart(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.warmstart";
+	const PageId numPages = 16384;
+	const std::uint32_t poolSize = 4096;
+	const int numOps = 5000;
+	createBlobFile(name, numPages);
+
+	// warm a pool up and save its hot set at shutdown
+	std::stringstream hotSet;
+	{
+		BlobFile file = BlobFile::open(name);
+		BufMgr bufMgr(poolSize);
+		bufMgr.setHotSetStream(&hotSet);
+		skewedReads(bufMgr, file, numPages, 500000, 5);
+	}
+	const std::string saved = hotSet.str();
+
+	for (int warm = 0; warm < 2; warm++)
+	{
+		pageCacheMB(name, true);
+		BlobFile file = BlobFile::open(name);
+		BufMgr bufMgr(poolSize);
+
+		double loadSecs = 0;
+		std::uint32_t loaded = 0;
+		if (warm)
+		{
+			std::istringstream in(saved);
+			std::vector<File*> files(1, &file);
+			Clock::time_point start = Clock::now();
+			loaded = bufMgr.loadHotSet(in, files);
+			loadSecs = secondsSince(start);
+		}
+
+		double secs = skewedReads(bufMgr, file, numPages, numOps, 6);
+		BufStats stats = bufMgr.getBufStats();
+		std::cout << "  " << (warm ? "hot set" : "cold   ")
+			<< "  first " << numOps << " lookups ms:" << (std::uint64_t) (secs * 1000)
+			<< "  misses:" << stats.diskreads - stats.prefetches
+			<< "  pages loaded:" << loaded
+			<< "  load ms:" << std::fixed << std::setprecision(2) << loadSecs * 1000
+			<< std::defaultfloat << "  prefetch hits:" << stats.prefetchhits << std::endl;
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// victimcache: misses served by decompressing evicted pages instead of reading them
+// -----------------------------------------------------------------------------
+
+void benchVictimCache(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.victimcache";
+	const PageId numPages = createRelation(name, 300000);
+	const std::uint32_t poolSize = numPages / 4;
+	const std::size_t budgets[] = {0, 1 << 20, 4 << 20};
+	const int numOps = 100000;
+
+	for (std::size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++)
+	{
+		// direct I/O so that a miss costs a device read, not a page cache copy
+		pageCacheMB(name, true);
+		PageFile file = PageFile::open(name, true);
+		BufMgr bufMgr(poolSize);
+		bufMgr.setVictimCacheSize(budgets[b]);
+
+		Rng rng(21);
+		Page* page;
+		Clock::time_point start = Clock::now();
+		for (int op = 0; op < numOps; op++)
+		{
+			PageId pageNo = 1 + rng.next(numPages);
+			bufMgr.readPage(&file, pageNo, page);
+			bufMgr.unPinPage(&file, pageNo, false);
+		}
+		double secs = secondsSince(start);
+
+		BufStats stats = bufMgr.statsSnapshot();
+		std::cout << "  budget MB:" << (budgets[b] >> 20)
+			<< "  ops/s:" << (std::uint64_t) (numOps / secs)
+			<< "  misses:" << stats.misses
+			<< "  disk reads:" << stats.diskreads
+			<< "  victim hits:" << stats.victimhits
+			<< "  compression:" << std::fixed << std::setprecision(2)
+			<< (stats.victimbytesout > 0 ? (double) stats.victimbytesin / stats.victimbytesout : 0)
+			<< std::defaultfloat << "x  rejected:" << stats.victimrejects
+			<< "  cache MB:" << bufMgr.victimCacheBytes() / (double) (1 << 20) << std::endl;
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// ssdcache: misses served from a cache file in a local directory
+// -----------------------------------------------------------------------------
+
+void benchSsdCache(const std::vector<std::string>& inputs)
+{
+	// the directory to put the cache file in, by default the working directory
+	const std::string directory = inputs.empty() ? "." : inputs[0];
+	const std::string name = "bench.ssdcache";
+	const PageId numPages = createRelation(name, 300000);
+	const std::uint32_t poolSize = numPages / 4;
+	const std::uint32_t cachePages[] = {0, numPages / 2, numPages};
+	const int numOps = 100000;
+
+	for (std::size_t c = 0; c < sizeof(cachePages) / sizeof(cachePages[0]); c++)
+	{
+		pageCacheMB(name, true);
+		PageFile file = PageFile::open(name, true);
+		BufMgr bufMgr(poolSize);
+		bufMgr.setSsdCache(directory, (std::size_t) cachePages[c] * Page::SIZE);
+
+		Rng rng(16);
+		Page* page;
+		Clock::time_point start = Clock::now();
+		for (int op = 0; op < numOps; op++)
+		{
+			PageId pageNo = 1 + rng.next(numPages);
+			bufMgr.readPage(&file, pageNo, page);
+			bufMgr.unPinPage(&file, pageNo, false);
+		}
+		double secs = secondsSince(start);
+
+		BufStats stats = bufMgr.statsSnapshot();
+		std::cout << "  cache pages:" << cachePages[c]
+			<< "  ops/s:" << (std::uint64_t) (numOps / secs)
+			<< "  misses:" << stats.misses
+			<< "  disk reads:" << stats.diskreads
+			<< "  ssd hits:" << stats.ssdhits
+			<< "  ssd stores:" << stats.ssdstores
+			<< "  cached:" << bufMgr.ssdCachePages() << std::endl;
+		bufMgr.flushFile(&file);
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// numa: local and remote page accesses under each placement of the partitions
+// -----------------------------------------------------------------------------
+
+void benchNuma(const std::vector<std::string>& /* inputs */)
+{
+	const NumaTopology& topology = NumaTopology::system();
+	const std::uint32_t numNodes = topology.numNodes();
+	std::cout << "  nodes:" << numNodes;
+	for (std::uint32_t n = 0; n < numNodes; n++)
+		std::cout << "  cpus of node " << n << ":" << topology.cpusOf(n).size();
+	std::cout << std::endl;
+	if (numNodes == 1)
+		std::cout << "  single node: every access is local and nothing is bound" << std::endl;
+
+	// two files per node, all cached, so that only the memory accessed differs
+	const std::uint32_t numFiles = 2 * numNodes;
+	const PageId numPages = 1024;
+	std::vector<std::string> names;
+	for (std::uint32_t f = 0; f < numFiles; f++)
+	{
+		names.push_back("bench.numa." + std::to_string(f));
+		createBlobFile(names.back(), numPages);
+	}
+
+	const unsigned numThreads = std::max(2u, std::thread::hardware_concurrency());
+	const int opsPerThread = 400000 / numThreads;
+	const NumaPlacement placements[] = {NUMA_INTERLEAVE, NUMA_FILE_AFFINE};
+	const char* placementNames[] = {"interleave", "file-affine"};
+
+	for (std::size_t p = 0; p < 2; p++)
+	{
+		std::vector<BlobFile> files;
+		files.reserve(numFiles);
+		for (std::uint32_t f = 0; f < numFiles; f++)
+			files.push_back(BlobFile::open(names[f]));
+
+		BufMgr bufMgr(2 * numFiles * numPages, 0, CLOCK_POLICY, placements[p]);
+		Page* page;
+		for (std::uint32_t f = 0; f < numFiles; f++)
+		{
+			for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+			{
+				bufMgr.readPage(&files[f], pageNo, page);
+				bufMgr.unPinPage(&files[f], pageNo, false);
+			}
+		}
+		bufMgr.clearBufStats();
+
+		// each thread runs on one node and reads a file placed there, if any is
+		std::vector<std::thread> workers;
+		Clock::time_point start = Clock::now();
+		for (unsigned t = 0; t < numThreads; t++)
+		{
+			workers.push_back(std::thread([&, t]() {
+				const std::uint32_t node = t % numNodes;
+				topology.bindThread(node);
+				File* file = &files[t % numFiles];
+				for (std::uint32_t f = 0; f < numFiles; f++)
+				{
+					if (bufMgr.nodeOfFile(&files[(t + f) % numFiles]) == node)
+					{
+						file = &files[(t + f) % numFiles];
+						break;
+					}
+				}
+
+				Rng rng(t + 1);
+				Page* threadPage;
+				for (int i = 0; i < opsPerThread; i++)
+				{
+					PageId pageNo = 1 + rng.next(numPages);
+					bufMgr.readPage(file, pageNo, threadPage);
+					bufMgr.unPinPage(file, pageNo, false);
+				}
+			}));
+		}
+		for (unsigned t = 0; t < numThreads; t++)
+			workers[t].join();
+		double secs = secondsSince(start);
+
+		BufStats stats = bufMgr.statsSnapshot();
+		const std::uint64_t counted = stats.localaccesses + stats.remoteaccesses;
+		std::cout << "  placement:" << placementNames[p]
+			<< "  threads:" << numThreads
+			<< "  partitions:" << bufMgr.getNumPartitions()
+			<< "  ops/s:" << (std::uint64_t) (numThreads * opsPerThread / secs)
+			<< "  local:" << (numNodes == 1 ? (std::uint64_t) stats.accesses : (std::uint64_t) stats.localaccesses)
+			<< "  remote:" << stats.remoteaccesses
+			<< "  remote share:" << std::fixed << std::setprecision(1)
+			<< (counted > 0 ? 100.0 * stats.remoteaccesses / counted : 0.0) << std::defaultfloat << "%" << std::endl;
+
+		for (std::uint32_t f = 0; f < numFiles; f++)
+			bufMgr.flushFile(&files[f]);
+	}
+
+	for (std::uint32_t f = 0; f < numFiles; f++)
+		File::remove(names[f]);
+}
+
+// -----------------------------------------------------------------------------
+// framewait: bursts of pins on a small pool, failing against waiting for frames
+// -----------------------------------------------------------------------------
+
+void benchFrameWait(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.framewait";
+	const PageId numPages = 4096;
+	createBlobFile(name, numPages);
+
+	// every thread holds up to pinsPerQuery pages at once; the pool leaves room
+	// for one thread to finish even if all others hold all but one of theirs
+	const unsigned numThreads = 8;
+	const unsigned pinsPerQuery = 4;
+	const std::uint32_t poolSize = numThreads * (pinsPerQuery - 1) + 4;
+	const int queriesPerThread = 2000;
+	const std::uint32_t timeouts[] = {0, 100};
+
+	{
+		BlobFile file = BlobFile::open(name);
+		for (std::size_t t = 0; t < sizeof(timeouts) / sizeof(timeouts[0]); t++)
+		{
+			BufMgr bufMgr(poolSize, 1);
+			bufMgr.setFrameWaitTimeout(timeouts[t]);
+			std::atomic<std::uint64_t> failed(0);
+
+			std::vector<std::thread> workers;
+			Clock::time_point start = Clock::now();
+			for (unsigned w = 0; w < numThreads; w++)
+			{
+				workers.push_back(std::thread([&, w]() {
+					Rng rng(w + 1);
+					for (int q = 0; q < queriesPerThread; q++)
+					{
+						std::vector<PageId> pinned;
+						try
+						{
+							for (unsigned i = 0; i < pinsPerQuery; i++)
+							{
+								PageId pageNo = 1 + rng.next(numPages);
+								Page* page;
+								bufMgr.readPage(&file, pageNo, page);
+								pinned.push_back(pageNo);
+							}
+							std::this_thread::yield();
+						}
+						catch (const BufferExceededException&)
+						{
+							failed++;
+						}
+						for (std::size_t i = 0; i < pinned.size(); i++)
+							bufMgr.unPinPage(&file, pinned[i], false);
+					}
+				}));
+			}
+			for (unsigned w = 0; w < numThreads; w++)
+				workers[w].join();
+			double secs = secondsSince(start);
+
+			BufStats stats = bufMgr.statsSnapshot();
+			std::cout << "  timeout ms:" << timeouts[t]
+				<< "  queries/s:" << (std::uint64_t) (numThreads * queriesPerThread / secs)
+				<< "  failed:" << failed.load()
+				<< "  waits:" << stats.framewaits
+				<< "  timeouts:" << stats.framewaittimeouts
+				<< "  wait p50 us:" << stats.frameWaitLatency.percentileMicros(0.5)
+				<< "  p99 us:" << stats.frameWaitLatency.percentileMicros(0.99) << std::endl;
+			bufMgr.flushFile(&file);
+		}
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// policies: hit ratio of each replacement policy over page reference traces
+// -----------------------------------------------------------------------------
+
+/**
+ * Reads a trace written by BufMgr::setTraceStream: one "filename pageNo" per line.
+ */
+std::vector<PageRef> loadTrace(const std::string& path)
+{
+	std::vector<PageRef> trace;
+	std::map<std::string, std::uint32_t> fileIds;
+	std::ifstream in(path.c_str());
+	std::string fileName;
+	PageId pageNo;
+
+	while (in >> fileName >> pageNo)
+	{
+		std::map<std::string, std::uint32_t>::iterator it = fileIds.find(fileName);
+		if (it == fileIds.end())
+			it = fileIds.insert(std::make_pair(fileName, (std::uint32_t) fileIds.size())).first;
+		PageRef ref = {it->second, pageNo};
+		trace.push_back(ref);
+	}
+	return trace;
+}
+
+/**
+ * Index lookups against a 3-level B+ tree (hot root and inner pages, skewed
+ * leaves) interleaved with sequential scans of a heap file several times
+ * larger than the pool: the mix that flushes CLOCK.
+ */
+std::vector<PageRef> syntheticTrace()
+{
+	const std::uint32_t indexFile = 0, heapFile = 1;
+	const PageId numInner = 32, numLeaves = 4096, numHeapPages = 8192;
+	std::vector<PageRef> trace;
+	Rng rng(42);
+
+	for (int round = 0; round < 20; round++)
+	{
+		for (int probe = 0; probe < 20000; probe++)
+		{
+			// square the uniform draw to skew leaves towards the low keys
+			std::uint64_t r = rng.next(numLeaves);
+			PageId leaf = (PageId) (r * r / numLeaves);
+			PageRef root = {indexFile, 1};
+			PageRef inner = {indexFile, 2 + leaf * numInner / numLeaves};
+			PageRef leafRef = {indexFile, 2 + numInner + leaf};
+			trace.push_back(root);
+			trace.push_back(inner);
+			trace.push_back(leafRef);
+		}
+		for (PageId pageNo = 1; pageNo <= numHeapPages; pageNo++)
+		{
+			PageRef ref = {heapFile, pageNo};
+			trace.push_back(ref);
+		}
+	}
+	return trace;
+}
+
+void benchPolicies(const std::vector<std::string>& inputs)
+{
+	const ReplacementPolicyType policies[] = {CLOCK_POLICY, LRUK_POLICY, ARC_POLICY};
+	const char* policyNames[] = {"CLOCK", "LRU-K", "ARC"};
+	const std::uint32_t poolSizes[] = {64, 256, 1024, 4096};
+
+	std::vector<std::pair<std::string, std::vector<PageRef> > > traces;
+	for (std::size_t i = 0; i < inputs.size(); i++)
+		traces.push_back(std::make_pair(inputs[i], loadTrace(inputs[i])));
+	if (traces.empty())
+		traces.push_back(std::make_pair(std::string("synthetic btree+scan"), syntheticTrace()));
+
+	for (std::size_t t = 0; t < traces.size(); t++)
+	{
+		const std::vector<PageRef>& trace = traces[t].second;
+		std::cout << "  trace: " << traces[t].first << "  references:" << trace.size() << std::endl;
+		if (trace.empty())
+			continue;
+
+		for (std::size_t s = 0; s < sizeof(poolSizes) / sizeof(poolSizes[0]); s++)
+		{
+			std::cout << "    frames:" << std::setw(5) << poolSizes[s];
+			for (std::size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++)
+			{
+				std::uint64_t hits = ReplacementPolicy::simulate(policies[p], poolSizes[s], trace);
+				std::cout << "  " << policyNames[p] << ":" << std::fixed << std::setprecision(3)
+					<< (double) hits / trace.size();
+			}
+			std::cout << std::endl;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// pagesizes: random lookups in files of each page size, with the same memory
+// -----------------------------------------------------------------------------
+
+void benchPageSizes(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.pagesizes";
+	const std::size_t fileBytes = 256 << 20;
+	const std::size_t poolBytes = 32 << 20;
+	const std::size_t pageSizes[] = {Page::SIZE, 2 * Page::SIZE, 4 * Page::SIZE, Page::MAX_SIZE};
+	const int numOps = 100000;
+
+	for (std::size_t s = 0; s < sizeof(pageSizes) / sizeof(pageSizes[0]); s++)
+	{
+		const PageId numPages = (PageId) (fileBytes / pageSizes[s]);
+		createBlobFile(name, numPages, pageSizes[s]);
+		pageCacheMB(name, true);
+		BlobFile file = BlobFile::open(name, true);
+		BufMgr bufMgr(std::vector<PageSizeClass>(1, PageSizeClass(pageSizes[s], (std::uint32_t) (poolBytes / pageSizes[s]))));
+
+		// each lookup lands on a random byte of the file, as a probe of a node
+		// one level above the leaves would
+		Rng rng(19);
+		Page* page;
+		Clock::time_point start = Clock::now();
+		for (int op = 0; op < numOps; op++)
+		{
+			PageId pageNo = 1 + (PageId) (rng.next(fileBytes / 64) * 64 / pageSizes[s]);
+			bufMgr.readPage(&file, pageNo, page);
+			bufMgr.unPinPage(&file, pageNo, false);
+		}
+		double secs = secondsSince(start);
+
+		BufStats stats = bufMgr.statsSnapshot();
+		std::cout << "  page KB:" << pageSizes[s] / 1024
+			<< "  int keys per leaf:" << (pageSizes[s] - sizeof(PageId)) / (sizeof(int) + sizeof(RecordId))
+			<< "  ops/s:" << (std::uint64_t) (numOps / secs)
+			<< "  disk reads:" << stats.diskreads
+			<< "  MB read:" << stats.diskreads * pageSizes[s] / (1 << 20) << std::endl;
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// mmap: index lookups and range scans through the pool against a read-only mapping
+// -----------------------------------------------------------------------------
+
+/**
+ * Sum of the record ids returned to benchMmap, kept so that the scans are not optimized away
+ */
+volatile std::uint64_t mmapChecksum;
+
+void benchMmap(const std::vector<std::string>& /* inputs */)
+{
+	const std::string relationName = "bench.mmap";
+	const int numKeys = 200000;
+	const int numLookups = 100000;
+	const int scanKeys = 5000;
+	const int numScans = 200;
+	const std::uint32_t poolSizes[] = {4096, 32, 32};
+	const char* modes[] = {"buffered, index in pool", "buffered, 32 frames", "mapped"};
+	createRelation(relationName, numKeys);
+
+	// build the index once; each mode below reopens it
+	std::string indexName;
+	{
+		BufMgr bufMgr(poolSizes[0]);
+		BTreeIndex index(relationName, indexName, &bufMgr, offsetof(BenchRecord, i), INTEGER);
+	}
+
+	for (int m = 0; m < 3; m++)
+	{
+		BufMgr bufMgr(poolSizes[m]);
+		BTreeIndex index(relationName, indexName, &bufMgr, offsetof(BenchRecord, i), INTEGER, m == 2);
+		std::uint64_t checksum = 0;
+		RecordId rid;
+
+		// a full scan brings the index into the page cache, and into the pool where it fits
+		int low = 0;
+		int high = numKeys;
+		index.startScan(&low, GTE, &high, LT);
+		try
+		{
+			while (true)
+			{
+				index.scanNext(rid);
+				checksum += rid.page_number;
+			}
+		}
+		catch (const IndexScanCompletedException&)
+		{
+		}
+		index.endScan();
+		const std::uint64_t warmReads = bufMgr.getBufStats().diskreads;
+
+		// a lookup descends from the root to one key, a scan walks a run of leaves
+		Rng rng(20);
+		Clock::time_point start = Clock::now();
+		for (int op = 0; op < numLookups; op++)
+		{
+			int key = (int) rng.next(numKeys);
+			index.startScan(&key, GTE, &key, LTE);
+			index.scanNext(rid);
+			checksum += rid.slot_number;
+			index.endScan();
+		}
+		double lookupSecs = secondsSince(start);
+
+		start = Clock::now();
+		for (int op = 0; op < numScans; op++)
+		{
+			low = (int) rng.next(numKeys - scanKeys);
+			high = low + scanKeys;
+			index.startScan(&low, GTE, &high, LT);
+			for (int k = 0; k < scanKeys; k++)
+			{
+				index.scanNext(rid);
+				checksum += rid.slot_number;
+			}
+			index.endScan();
+		}
+		double scanSecs = secondsSince(start);
+		mmapChecksum = checksum;
+
+		std::cout << "  " << std::left << std::setw(24) << modes[m] << std::right
+			<< "  lookup ns:" << (std::uint64_t) (lookupSecs * 1e9 / numLookups)
+			<< "  scan ns/key:" << (std::uint64_t) (scanSecs * 1e9 / ((std::uint64_t) numScans * scanKeys))
+			<< "  disk reads:" << bufMgr.getBufStats().diskreads - warmReads
+			<< "  RSS MB:" << residentMB() << std::endl;
+	}
+
+	File::remove(indexName);
+	File::remove(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// preadiops: random page reads with positional I/O against a shared fstream
+// -----------------------------------------------------------------------------
+
+/**
+ * Page reads as File made them before it moved to positional I/O, kept here as
+ * the baseline: a seek and a read on one std::fstream shared by every thread,
+ * under a latch.
+ */
+class StreamPageReader
+{
+ public:
+	StreamPageReader(const std::string& name)
+		: stream(name.c_str(), std::fstream::in | std::fstream::out | std::fstream::binary)
+	{
+	}
+
+	void readPage(const PageId pageNo, Page& page)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		stream.seekg(sizeof(FileHeader) + (std::streamoff) (pageNo - 1) * Page::SIZE, std::ios::beg);
+		stream.read(reinterpret_cast<char*>(&page), Page::SIZE);
+	}
+
+ private:
+	std::fstream stream;
+	std::mutex latch;
+};
+
+/**
+ * Runs numThreads threads reading random pages through read and returns the
+ * pages read per second.
+ */
+template<class ReadPage>
+double iopsRun(ReadPage read, const PageId numPages, const unsigned numThreads, const int opsPerThread)
+{
+	std::vector<std::thread> workers;
+	Clock::time_point start = Clock::now();
+	for (unsigned t = 0; t < numThreads; t++)
+	{
+		workers.push_back(std::thread([=]() {
+			Rng rng(t + 1);
+			Page page;
+			for (int i = 0; i < opsPerThread; i++)
+				read(1 + rng.next(numPages), page);
+		}));
+	}
+	for (unsigned t = 0; t < numThreads; t++)
+		workers[t].join();
+
+	return numThreads * opsPerThread / secondsSince(start);
+}
+
+void benchPreadIops(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.preadiops";
+	const PageId numPages = 8192;
+	const int numOps = 400000;
+	createBlobFile(name, numPages);
+
+	{
+		// the file is read from the page cache, so the cost measured is that of
+		// the calls and copies rather than of the device
+		BlobFile file = BlobFile::open(name);
+		StreamPageReader stream(name);
+		for (unsigned n : threadCounts())
+		{
+			double streamIops = iopsRun([&](const PageId pageNo, Page& page) { stream.readPage(pageNo, page); },
+			                            numPages, n, numOps / n);
+			double preadIops = iopsRun([&](const PageId pageNo, Page& page) {
+			                             file.readPages(pageNo, std::vector<Page*>(1, &page)); },
+			                           numPages, n, numOps / n);
+			std::cout << "  threads:" << n
+				<< "  fstream IOPS:" << (std::uint64_t) streamIops
+				<< "  pread IOPS:" << (std::uint64_t) preadIops << std::endl;
+		}
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// header: page allocation and reads with the file header written through or cached
+// -----------------------------------------------------------------------------
+
+/**
+ * Read and write system calls made by this process so far, from /proc/self/io.
+ */
+std::pair<std::uint64_t, std::uint64_t> ioSyscalls()
+{
+	std::ifstream io("/proc/self/io");
+	std::string key;
+	std::uint64_t value, reads = 0, writes = 0;
+	while (io >> key >> value)
+	{
+		if (key == "syscr:")
+			reads = value;
+		else if (key == "syscw:")
+			writes = value;
+	}
+	return std::make_pair(reads, writes);
+}
+
+void benchHeader(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.header";
+	const PageId numPages = 50000;
+	const int numReads = 200000;
+	const std::uint32_t intervals[] = {1, 64, 0};
+
+	for (std::size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++)
+	{
+		removeIfExists(name);
+		PageFile file = PageFile::create(name);
+		file.setHeaderWriteInterval(intervals[i]);
+
+		std::pair<std::uint64_t, std::uint64_t> before = ioSyscalls();
+		Clock::time_point start = Clock::now();
+		for (PageId p = 0; p < numPages; p++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+		}
+		double allocSecs = secondsSince(start);
+		std::pair<std::uint64_t, std::uint64_t> afterAlloc = ioSyscalls();
+
+		Rng rng(22);
+		start = Clock::now();
+		for (int op = 0; op < numReads; op++)
+			file.readPage(1 + rng.next(numPages));
+		double readSecs = secondsSince(start);
+		std::pair<std::uint64_t, std::uint64_t> afterRead = ioSyscalls();
+
+		std::cout << "  header write interval:" << std::setw(3) << intervals[i]
+			<< "  allocs/s:" << (std::uint64_t) (numPages / allocSecs)
+			<< "  writes/alloc:" << std::fixed << std::setprecision(2)
+			<< (double) (afterAlloc.second - before.second) / numPages
+			<< "  reads/s:" << std::defaultfloat << (std::uint64_t) (numReads / readSecs)
+			<< "  syscalls/read:" << std::fixed << std::setprecision(2)
+			<< (double) (afterRead.first - afterAlloc.first) / numReads << std::defaultfloat << std::endl;
+	}
+
+	File::remove(name);
+}
+
+/**
+ * Loads records into a heap file, 10M unless a count is given, and reports the
+ * load rate of every tenth of them.  A rate falling as the file grows means
+ * allocating a page costs more the more pages there are.
+ */
+void benchLoad(const std::vector<std::string>& inputs)
+{
+	const std::string name = "bench.load";
+	const int numRecords = inputs.empty() ? 10000000 : std::atoi(inputs[0].c_str());
+	const int slice = std::max(1, numRecords / 10);
+	removeIfExists(name);
+
+	{
+		PageFile file = PageFile::create(name);
+		BenchRecord record;
+		std::memset(&record, ' ', sizeof(record));
+		PageId pageNo;
+		Page page = file.allocatePage(pageNo);
+		Clock::time_point start = Clock::now();
+		Clock::time_point sliceStart = start;
+		for (int i = 0; i < numRecords; i++)
+		{
+			record.i = i;
+			record.d = i;
+			std::string data(reinterpret_cast<char*>(&record), sizeof(record));
+			try
+			{
+				page.insertRecord(data);
+			}
+			catch(const InsufficientSpaceException&)
+			{
+				file.writePage(pageNo, page);
+				page = file.allocatePage(pageNo);
+				page.insertRecord(data);
+			}
+			if ((i + 1) % slice == 0)
+			{
+				std::cout << "  records:" << std::setw(9) << i + 1 << "  pages:" << std::setw(7) << pageNo
+					<< "  records/s:" << (std::uint64_t) (slice / secondsSince(sliceStart)) << std::endl;
+				sliceStart = Clock::now();
+			}
+		}
+		file.writePage(pageNo, page);
+		file.sync();
+		std::cout << "  total records/s:" << (std::uint64_t) (numRecords / secondsSince(start)) << std::endl;
+	}
+
+	File::remove(name);
+}
+
+/**
+ * Loads records into a heap file by catching InsufficientSpaceException and
+ * allocating a page, as createRelation does, or through
+ * PageFile::insertRecord or insertRecords.  Then deletes every other record
+ * and inserts as many again, reporting how many pages the file grew by.
+ */
+void benchFreeSpace(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.fsm";
+	const int numRecords = 1000000;
+	const char* modes[] = {"exception loop", "insertRecord", "insertRecords"};
+
+	BenchRecord record;
+	std::memset(&record, ' ', sizeof(record));
+	std::vector<std::string> records(numRecords);
+	for (int i = 0; i < numRecords; i++)
+	{
+		record.i = i;
+		record.d = i;
+		records[i] = std::string(reinterpret_cast<char*>(&record), sizeof(record));
+	}
+
+	for (int mode = 0; mode < 3; mode++)
+	{
+		removeIfExists(name);
+		PageFile file = PageFile::create(name);
+		std::vector<RecordId> ids;
+		PageId pageNo;
+		Page page;
+
+		// the exception loop only ever fills the page it allocated last
+		Clock::time_point start = Clock::now();
+		for (int round = 0; round < 2; round++)
+		{
+			if (mode == 0)
+			{
+				page = file.allocatePage(pageNo);
+				for (std::size_t i = round; i < records.size(); i += round + 1)
+				{
+					try
+					{
+						ids.push_back(page.insertRecord(records[i]));
+					}
+					catch(const InsufficientSpaceException&)
+					{
+						file.writePage(pageNo, page);
+						page = file.allocatePage(pageNo);
+						ids.push_back(page.insertRecord(records[i]));
+					}
+				}
+				file.writePage(pageNo, page);
+			}
+			else if (mode == 1)
+			{
+				for (std::size_t i = round; i < records.size(); i += round + 1)
+					ids.push_back(file.insertRecord(records[i]));
+			}
+			else
+			{
+				std::vector<std::string> batch;
+				for (std::size_t i = round; i < records.size(); i += round + 1)
+					batch.push_back(records[i]);
+				std::vector<RecordId> batchIds = file.insertRecords(batch);
+				ids.insert(ids.end(), batchIds.begin(), batchIds.end());
+			}
+
+			if (round == 0)
+			{
+				double loadSecs = secondsSince(start);
+				PageId loadPages = 0;
+				for (std::size_t i = 0; i < ids.size(); i++)
+					loadPages = std::max(loadPages, ids[i].page_number);
+				std::cout << "  " << std::setw(14) << modes[mode] << "  load records/s:" << std::setw(8)
+					<< (std::uint64_t) (numRecords / loadSecs) << "  pages:" << std::setw(6) << loadPages;
+
+				// delete every other record, a page at a time
+				for (std::size_t i = 0; i < ids.size(); )
+				{
+					Page victim = file.readPage(ids[i].page_number);
+					const PageId victimNo = ids[i].page_number;
+					for (; i < ids.size() && ids[i].page_number == victimNo; i += 2)
+						victim.deleteRecord(ids[i]);
+					file.writePage(victimNo, victim);
+				}
+				ids.clear();
+				start = Clock::now();
+			}
+		}
+		double reloadSecs = secondsSince(start);
+		PageId pages = 0;
+		for (std::size_t i = 0; i < ids.size(); i++)
+			pages = std::max(pages, ids[i].page_number);
+		std::cout << "  reinsert records/s:" << std::setw(8) << (std::uint64_t) (numRecords / 2 / reloadSecs)
+			<< "  pages after:" << std::setw(6) << pages << std::endl;
+	}
+
+	File::remove(name);
+}
+
+/**
+ * Deletes every page of heap files of growing size in random order.  The rate
+ * and the system calls per delete stay flat when deletePage does not walk the
+ * used list.
+ */
+void benchDelete(const std::vector<std::string>& /* inputs */)
+{
+	const std::string name = "bench.delete";
+	const PageId sizes[] = {5000, 20000, 80000};
+
+	for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		removeIfExists(name);
+		PageFile file = PageFile::create(name);
+		std::vector<PageId> order;
+		for (PageId p = 0; p < sizes[s]; p++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+			order.push_back(pageNo);
+		}
+		Rng rng(25);
+		for (std::size_t i = order.size() - 1; i > 0; i--)
+			std::swap(order[i], order[rng.next((std::uint32_t) i + 1)]);
+
+		std::pair<std::uint64_t, std::uint64_t> before = ioSyscalls();
+		Clock::time_point start = Clock::now();
+		for (std::size_t i = 0; i < order.size(); i++)
+			file.deletePage(order[i]);
+		double secs = secondsSince(start);
+		std::pair<std::uint64_t, std::uint64_t> after = ioSyscalls();
+
+		std::cout << "  pages:" << std::setw(6) << sizes[s]
+			<< "  deletes/s:" << std::setw(7) << (std::uint64_t) (sizes[s] / secs)
+			<< "  syscalls/delete:" << std::fixed << std::setprecision(2)
+			<< (double) (after.first + after.second - before.first - before.second) / sizes[s]
+			<< std::defaultfloat << "  used list empty:" << (file.begin() == file.end() ? "yes" : "no") << std::endl;
+	}
+
+	File::remove(name);
+}
+
+// -----------------------------------------------------------------------------
+// Driver
+// -----------------------------------------------------------------------------
+
+struct Benchmark
+{
+	const char* name;
+	void (*run)(const std::vector<std::string>& inputs);
+	const char* description;
+};
+
+const Benchmark benchmarks[] = {
+	{"scaling", benchScaling, "readPage/unPinPage throughput as threads are added"},
+	{"hashtable", benchHashTable, "page table lookups, open addressing against chained buckets"},
+	{"coldscan", benchColdScan, "FileScan throughput when every page misses the buffer pool"},
+	{"scanring", benchScanRing, "hot pages evicted by a large FileScan, with and without a frame ring"},
+	{"bgwriter", benchBgWriter, "dirty victims written by eviction itself, with and without the background writer"},
+	{"pagehandle", benchPageHandle, "cached readPage plus unpin, by page number against PageHandle"},
+	{"flushfile", benchFlushFile, "flushFile of a small file against the size of the buffer pool"},
+	{"coalesce", benchCoalesce, "write-back of a large file page by page against adjacent pages merged into runs"},
+	{"direct", benchDirect, "buffered against direct file I/O: throughput, RSS and the file's share of the page cache"},
+	{"resize", benchResize, "growing and shrinking the buffer pool while readers use it"},
+	{"warmstart", benchWarmStart, "first lookups after a restart, cold against reloading the saved hot set"},
+	{"victimcache", benchVictimCache, "random reads of a relation four times the pool, with and without the compressed victim cache"},
+	{"ssdcache", benchSsdCache, "random reads of a relation four times the pool, with and without a cache file in a local directory (argument)"},
+	{"numa", benchNuma, "local and remote page accesses with interleaved and file-affine NUMA placement"},
+	{"framewait", benchFrameWait, "bursts of pins on a pool too small for them, failing against waiting for a frame"},
+	{"pagesizes", benchPageSizes, "random lookups in 8 to 64 KB pages through a pool of the same size in bytes"},
+	{"mmap", benchMmap, "index lookups and range scans through the buffer pool against a read-only mapped BlobFile"},
+	{"preadiops", benchPreadIops, "random page reads from the page cache, a shared fstream against pread"},
+	{"header", benchHeader, "PageFile allocation and random reads with the file header written every change, every 64, or at close"},
+	{"load", benchLoad, "Loading 10M records (or as many as given) into a heap file, rate per tenth"},
+	{"fsm", benchFreeSpace, "Loading records with the exception loop, insertRecord or insertRecords, and reinserting after deletes"},
+	{"delete", benchDelete, "Deleting every page of heap files of 5000 to 80000 pages in random order"},
+	{"policies", benchPolicies, "trace-driven hit ratio of the CLOCK, LRU-K and ARC replacement policies"},
+};
+
+int main(int argc, char **argv)
+{
+	const int numBenchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+	std::vector<std::string> names, inputs;
+
+	for (int a = 1; a < argc; a++)
+	{
+		bool isName = false;
+		for (int i = 0; i < numBenchmarks; i++)
+			isName = isName || std::strcmp(argv[a], benchmarks[i].name) == 0;
+		(isName ? names : inputs).push_back(argv[a]);
+	}
+
+	for (int i = 0; i < numBenchmarks; i++)
+	{
+		bool selected = names.empty();
+		for (std::size_t n = 0; n < names.size(); n++)
+			selected = selected || names[n] == benchmarks[i].name;
+		if (!selected)
+			continue;
+
+		std::cout << "=== " << benchmarks[i].name << ": " << benchmarks[i].description << std::endl;
+		benchmarks[i].run(inputs);
+		std::cout << std::endl;
+	}
+
+	return 0;
+}
@@ -34,7 +34,9 @@ namespace badgerdb
 			std::string & outIndexName,
 			BufMgr *bufMgrIn,
 			const int attrByteOffset,
-			const Datatype attrType)
+			const Datatype attrType,
+			const bool mapped,
+			const std::size_t indexPageSize)
 	{
 		//set basic fields
 		this->bufMgr = bufMgrIn;
@@ -42,68 +44,69 @@ namespace badgerdb
 		this->attributeType = attrType;
 		this->attrByteOffset = attrByteOffset;
 
-		// set occupancy
-		if (attrType == INTEGER) {
-			this->leafOccupancy = INTARRAYLEAFSIZE;
-			this->nodeOccupancy = INTARRAYNONLEAFSIZE;
-		}
-		else if (attrType == DOUBLE) {
-			this->leafOccupancy = DOUBLEARRAYLEAFSIZE;
-			this->nodeOccupancy = DOUBLEARRAYNONLEAFSIZE;
-		}
-		else if (attrType == STRING) {
-			this->leafOccupancy = STRINGARRAYLEAFSIZE;
-			this->nodeOccupancy = STRINGARRAYNONLEAFSIZE; 
-		}
-
 		// find the index file name
 		std::ostringstream idxStr;
 		idxStr << relationName << '.' << attrByteOffset;
 		outIndexName = idxStr.str();
 
-		Page* metaPage; // header page
-		Page* rootPage; // root page
 		IndexMetaInfo* metaInfo;
 
 		//open file
 		if (File::exists(outIndexName)) {
-			file = new BlobFile(outIndexName, false);
+			if (mapped) {
+				file = new BlobFile(BlobFile::openMapped(outIndexName));
+			}
+			else {
+				file = new BlobFile(outIndexName, false);
+			}
+			// set occupancy for the file's own page size
+			if (attrType == INTEGER) {
+				layoutNodes<int>(NULL);
+			}
+			else if (attrType == DOUBLE) {
+				layoutNodes<double>(NULL);
+			}
+			else {
+				layoutNodes<char*>(NULL);
+			}
 			headerPageNum = file->getFirstPageNo();
-			bufMgr->readPage(file, headerPageNum, metaPage);
-			metaInfo = (IndexMetaInfo*)metaPage;
-			rootPageNum = metaInfo->rootPageNo;
-			onlyRoot = (metaInfo->rootPageNo == 2);
-			bufMgr->unPinPage(file, headerPageNum, false);
+			ConstPageHandle metaPage = bufMgr->readConstPage(file, headerPageNum);
+			const IndexMetaInfo* openedInfo = (const IndexMetaInfo*)metaPage.page();
+			rootPageNum = openedInfo->rootPageNo;
+			onlyRoot = (openedInfo->rootPageNo == 2);
 
 		}
 		//create new file
 		else {
-			file = new BlobFile(outIndexName, true);
+			file = new BlobFile(outIndexName, true, false, indexPageSize);
 			onlyRoot = true;
-			bufMgr->allocPage(file, headerPageNum, metaPage);
-			bufMgr->allocPage(file, rootPageNum, rootPage);
+			PageHandle metaPage = bufMgr->allocPage(file, headerPageNum);
+			PageHandle rootPage = bufMgr->allocPage(file, rootPageNum);
+			clearNode(rootPage.page());
 
 			//set metaPage
-			metaInfo = (IndexMetaInfo*)metaPage;
+			metaInfo = (IndexMetaInfo*)metaPage.page();
 			metaInfo->attrByteOffset = attrByteOffset;
 			metaInfo->attrType = attributeType;
 			metaInfo->rootPageNo = rootPageNum;
 			strcpy(metaInfo->relationName, relationName.c_str());
-			//Initialize right sibling
+			//set occupancy and initialize right sibling
 			if(attrType == INTEGER) {
-				((LeafNodeInt*)rootPage)->rightSibPageNo = 0;
-
+				layoutNodes<int>(rootPage.page());
 			}
 			else if(attrType == DOUBLE) {
-				((LeafNodeDouble*)rootPage)->rightSibPageNo = 0;
+				layoutNodes<double>(rootPage.page());
 			}
 			else {
-				((LeafNodeString*)rootPage)->rightSibPageNo = 0;
+				layoutNodes<char*>(rootPage.page());
 			}
 			//unpin
-			bufMgr->unPinPage(file, headerPageNum, true);
-			bufMgr->unPinPage(file, rootPageNum, true);
-			FileScan* scr = new FileScan(relationName, bufMgr);
+			metaPage.markDirty();
+			metaPage.release();
+			rootPage.markDirty();
+			rootPage.release();
+			// scan the relation through a small ring so the index pages stay cached
+			FileScan* scr = new FileScan(relationName, bufMgr, BufAccessStrategy::DEFAULT_RING_SIZE);
 			while(1) {
 				RecordId outRid;
 
@@ -123,6 +126,11 @@ namespace badgerdb
 			bufMgr->flushFile(file);
 			delete scr;
 
+			// the index is complete: reopen it read-only
+			if (mapped) {
+				delete file;
+				file = new BlobFile(BlobFile::openMapped(outIndexName));
+			}
 		}
 	}
 
@@ -134,6 +142,8 @@ namespace badgerdb
 
 	BTreeIndex::~BTreeIndex()
 	{
+		// a scan left open still pins its leaf
+		this->currentPageData.release();
 		this->bufMgr->flushFile(this->file);
 		this->scanExecuting = false;
 		delete this->file;
@@ -149,137 +159,67 @@ namespace badgerdb
 		if (this->attributeType == INTEGER) {
 			RIDKeyPair<int> newPair;
 			newPair.set(rid, *((int*)(key)));
-			//only root node in the tree
-			if (onlyRoot){
-
-
-				Page* leafPage;
-				LeafNodeInt* leafNode;
-				//find the node
-				bufMgr->readPage(file, this->rootPageNum, leafPage);
-				PageId rootNo = rootPageNum;
-				leafNode = (LeafNodeInt*) leafPage;
-
-
-				if (leafNode->ridArray[leafOccupancy-1].page_number == 0 ) {
-					insertLeaf<struct LeafNodeInt,RIDKeyPair<int>> (leafNode,newPair);
-				}
-				else {
-					// splite leaf node
-					PageKeyPair<int> splitPage;
-					splitLeaf<struct LeafNodeInt,PageKeyPair<int>,RIDKeyPair<int>>(leafNode, newPair, splitPage);
-
-					// create a new root since the old one is splitted
-					createNewRoot<struct LeafNodeInt, struct NonLeafNodeInt,PageKeyPair<int>,RIDKeyPair<int>>(rootPageNum, splitPage, 1);
-
-				}
-				bufMgr->unPinPage(this->file, rootNo, true);
-
-
-			}
-			//not only one node in tree
-			else {	
-				Page* rootPage;
-				PageKeyPair<int>newPagePair;
-				newPagePair.set(0,newPair.key);
-				//find the correct node
-				start<int, struct LeafNodeInt,struct NonLeafNodeInt,PageKeyPair<int>,RIDKeyPair<int>>(this->rootPageNum, newPagePair, newPair);
-				PageId rootNo = rootPageNum;
-				bufMgr->readPage(file, rootPageNum, rootPage);
-
-				// if split happens
-				if (newPagePair.pageNo != 0) {
-					createNewRoot<struct LeafNodeInt,struct NonLeafNodeInt,PageKeyPair<int>,RIDKeyPair<int>>(rootPageNum, newPagePair, 0);
-				}
-				bufMgr->unPinPage(this->file, rootNo, true);
-			}
+			insertPair<int>(newPair);
 		}
 		// other attribute types
 		else if (this->attributeType == DOUBLE) {
 			RIDKeyPair<double> newPair;
 			newPair.set(rid, *((double*)(key)));
-			if (onlyRoot) {
-				Page* leafPage;
-				LeafNodeDouble* leafNode;
-
-				bufMgr->readPage(file, this->rootPageNum, leafPage);
-				PageId rootNo = rootPageNum;
-				leafNode = (LeafNodeDouble*) leafPage;
-
-				// If rootLeaf is not full
-				if (leafNode->ridArray[leafOccupancy-1].page_number == 0 ) {
-					insertLeaf<LeafNodeDouble,RIDKeyPair<double>> (leafNode,newPair);
-				}
-				else {
-					// splite leaf node
-					PageKeyPair<double> splitPage;
-					splitLeaf<LeafNodeDouble,PageKeyPair<double>,RIDKeyPair<double>>(leafNode, newPair, splitPage);
-
-					// create a new root
-					createNewRoot<LeafNodeDouble,NonLeafNodeDouble,PageKeyPair<double>,RIDKeyPair<double>>(rootPageNum, splitPage, 1);
-
-				}
-				bufMgr->unPinPage(this->file, rootNo, true);
-			}
-			else {
-				Page* rootPage;
-				PageKeyPair<double>newPagePair;
-				newPagePair.set(0,newPair.key);
-				start<double, struct LeafNodeDouble,struct NonLeafNodeDouble,PageKeyPair<double>,RIDKeyPair<double>>(this->rootPageNum, newPagePair, newPair);
-
-				PageId rootNo = rootPageNum;
-				bufMgr->readPage(file, rootPageNum, rootPage);
-
-				if (newPagePair.pageNo!= 0) {
-					createNewRoot<struct LeafNodeDouble,struct NonLeafNodeDouble,PageKeyPair<double>,RIDKeyPair<double>>(rootPageNum, newPagePair, 0);
-
-				}
-				bufMgr->unPinPage(this->file, rootNo, true);
-			}
+			insertPair<double>(newPair);
 		}
 		else {
 			RIDKeyPair<char*> newPair;
 			char* s = (char*)malloc(STRINGSIZE);
 			snprintf(s, STRINGSIZE,"%s",(char*)key);
 			newPair.set(rid, s);
-			if(onlyRoot){
-				Page* leafPage;
-				LeafNodeString* leafNode;
+			insertPair<char*>(newPair);
+		}
+	}
 
-				bufMgr->readPage(file, this->rootPageNum, leafPage);
-				PageId rootNo = rootPageNum;
-				leafNode = (LeafNodeString*) leafPage;
+	// -----------------------------------------------------------------------------
+	// BTreeIndex::insertPair
+	// -----------------------------------------------------------------------------
 
-				// If rootLeaf is not full
-				if (leafNode->ridArray[leafOccupancy-1].page_number == 0 ) {
-					insertLeaf<LeafNodeString,RIDKeyPair<char*>> (leafNode,newPair);
-				}
-				else {
-					// splite leaf node
-					PageKeyPair<char*> splitPage;
-					splitLeaf<LeafNodeString,PageKeyPair<char*>,RIDKeyPair<char*>>(leafNode, newPair, splitPage);
+	template<class T, std::size_t PAGE_SIZE> void BTreeIndex::insertPairOf(RIDKeyPair<T> newPair)
+	{
+		typedef typename IndexNodes<T, PAGE_SIZE>::Leaf Leaf;
+		typedef typename IndexNodes<T, PAGE_SIZE>::NonLeaf NonLeaf;
 
-					// create a new root
-					createNewRoot<LeafNodeString,NonLeafNodeString,PageKeyPair<char*>,RIDKeyPair<char*>>(rootPageNum, splitPage, 1);
+		//only root node in the tree
+		if (onlyRoot) {
+			Leaf* leafNode;
+			//find the node
+			PageHandle leafPage = bufMgr->readPage(file, this->rootPageNum);
+			leafNode = (Leaf*) leafPage.page();
 
-				}
-				bufMgr->unPinPage(this->file, rootNo, true);
+			// If rootLeaf is not full
+			if (leafNode->ridArray[leafOccupancy-1].page_number == 0 ) {
+				insertLeaf<Leaf,RIDKeyPair<T>> (leafNode,newPair);
 			}
-			else{
-				Page* rootPage;
-				PageKeyPair<char*>newPagePair;
-				newPagePair.set(0,newPair.key);
-				PageId rootNo = this->rootPageNum;
-				start<char*, struct LeafNodeString,struct NonLeafNodeString,PageKeyPair<char*>,RIDKeyPair<char*>>(rootPageNum, newPagePair, newPair);
+			else {
+				// splite leaf node
+				PageKeyPair<T> splitPage;
+				splitLeaf<Leaf,PageKeyPair<T>,RIDKeyPair<T>>(leafNode, newPair, splitPage);
 
-				bufMgr->readPage(file, rootPageNum, rootPage);
+				// create a new root since the old one is splitted
+				createNewRoot<Leaf,NonLeaf,PageKeyPair<T>,RIDKeyPair<T>>(rootPageNum, splitPage, 1);
 
-				if (newPagePair.pageNo!= 0) {
-					createNewRoot<struct LeafNodeString,struct NonLeafNodeString,PageKeyPair<char*>,RIDKeyPair<char*>>(rootPageNum, newPagePair, 0);
+			}
+			leafPage.markDirty();
+		}
+		//not only one node in tree
+		else {
+			PageKeyPair<T> newPagePair;
+			newPagePair.set(0,newPair.key);
+			//find the correct node
+			start<T,Leaf,NonLeaf,PageKeyPair<T>,RIDKeyPair<T>>(this->rootPageNum, newPagePair, newPair);
+			PageHandle rootPage = bufMgr->readPage(file, rootPageNum);
 
-				}
-				bufMgr->unPinPage(this->file, rootNo, true);
+			// if split happens
+			if (newPagePair.pageNo != 0) {
+				createNewRoot<Leaf,NonLeaf,PageKeyPair<T>,RIDKeyPair<T>>(rootPageNum, newPagePair, 0);
 			}
+			rootPage.markDirty();
 		}
 	}
 
@@ -312,7 +252,7 @@ namespace badgerdb
 
 			lowValInt = *((int*)lowValParm);
 			highValInt = *((int*)highValParm);
-			search<int,struct LeafNodeInt,struct NonLeafNodeInt, class PageKeyPair<int>,class RIDKeyPair<int>>(lowValInt);
+			searchFor<int>(lowValInt);
 		}
 		else if(attributeType == DOUBLE){ 
 			if((*(double*)lowValParm) > (*(double*)highValParm)){
@@ -327,7 +267,7 @@ namespace badgerdb
 
 			lowValDouble = *((double*)lowValParm);
 			highValDouble = *((double*)highValParm);
-			search<double,struct LeafNodeDouble,struct NonLeafNodeDouble, class PageKeyPair<double>,class RIDKeyPair<double>>(lowValDouble);
+			searchFor<double>(lowValDouble);
 		}
 		else{   
 			if(strncmp(lowValString.c_str(),highValString.c_str(),STRINGSIZE)>0){
@@ -344,24 +284,35 @@ namespace badgerdb
 			highValString = std::string((char*)highValParm, STRINGSIZE);
 			char* lowVal = (char*)malloc(STRINGSIZE);
 			snprintf(lowVal, STRINGSIZE, "%s",lowValString.c_str());
-			search<char*,struct LeafNodeString,struct NonLeafNodeString, class PageKeyPair<char*>,class RIDKeyPair<char*>>(lowVal);
+			searchFor<char*>(lowVal);
 		}
 
 	}
 
+	// -----------------------------------------------------------------------------
+	// BTreeIndex::searchFor
+	// -----------------------------------------------------------------------------
+
+	template<class T, std::size_t PAGE_SIZE> void BTreeIndex::searchForOf(T lowVal)
+	{
+		typedef typename IndexNodes<T, PAGE_SIZE>::Leaf Leaf;
+		typedef typename IndexNodes<T, PAGE_SIZE>::NonLeaf NonLeaf;
+		search<T,Leaf,NonLeaf,PageKeyPair<T>,RIDKeyPair<T>>(lowVal);
+	}
+
 	// -----------------------------------------------------------------------------
 	// BTreeIndex::search
 	// -----------------------------------------------------------------------------
 	template<class T,class LT,class NT,class PP,class RP> void BTreeIndex::search(T lowVal) 
 	{
-		Page* currPage;
+		ConstPageHandle currPage;
 		PageId currNo;
-		NT* currNode;
+		const NT* currNode;
 
 		//case 1, if the root is leaf -- scan current page which is the only page in tree
 		if (onlyRoot){
 			this->currentPageNum = this->rootPageNum;		
-			bufMgr->readPage(file, currentPageNum, currentPageData);	
+			currentPageData = bufMgr->readConstPage(file, currentPageNum);	
 			nextEntry = leafPos<T,LT>(rootPageNum,lowVal);
 			if (nextEntry == -1) {
 				throw IndexScanCompletedException();
@@ -371,17 +322,15 @@ namespace badgerdb
 
 		//case 2, if root is not leaf, search to find the right position
 		currNo = this->rootPageNum;
-		bufMgr->readPage(file,currNo,currPage);
-		bufMgr->unPinPage(this->file,currNo,false);
-		currNode = (NT*) currPage;
+		currPage = bufMgr->readConstPage(file,currNo);
+		currNode = (const NT*) currPage.page();
 
 
 		while (currNode->level != 1) {
 			int pos = nonLeafPos<T,NT>(currNo,lowVal);
 			currNo = currNode->pageNoArray[pos];
-			bufMgr->readPage(file,currNo,currPage);
-			currNode = (NT*)currPage;
-			bufMgr->unPinPage(this->file,currNo,false);
+			currPage = bufMgr->readConstPage(file,currNo);
+			currNode = (const NT*)currPage.page();
 		}
 
 		int pos = nonLeafPos<T,NT>(currNo,lowVal);
@@ -395,8 +344,8 @@ namespace badgerdb
 			throw IndexScanCompletedException();
 		}
 
-		bufMgr->readPage(file,currentPageNum,currentPageData);
-		bufMgr->unPinPage(file, currentPageNum, false);
+		// the leaf stays pinned until the scan moves off it
+		currentPageData = bufMgr->readConstPage(file,currentPageNum);
 
 	}
 
@@ -412,67 +361,31 @@ namespace badgerdb
 		throw IndexScanCompletedException();
 	}
 	if(attributeType == INTEGER) {
-		LeafNodeInt* curr = (LeafNodeInt*) currentPageData;
-		if(highOp == LTE && curr->keyArray[nextEntry] > highValInt) {
-			throw IndexScanCompletedException();
-		}
-		if(highOp == LT && curr->keyArray[nextEntry] >= highValInt) {
-			throw IndexScanCompletedException();
-		}
-		outRid = curr->ridArray[nextEntry];
-		if(nextEntry == leafOccupancy-1 ||  curr->ridArray[nextEntry+1].page_number == 0) {
-			if(curr->rightSibPageNo == 0) {
-
-				currentPageNum = 0;
-			}
-			else{
-				currentPageNum = curr->rightSibPageNo;
-				bufMgr->readPage(file,currentPageNum, currentPageData);
-				nextEntry = 0;
-
-				bufMgr->unPinPage(file,currentPageNum,false);
-			}
-		}
-		else{
-			nextEntry++;
-		}
+		scanLeaf<int>(outRid, highValInt);
 	}
 	else if(attributeType == DOUBLE){
-		LeafNodeDouble* curr = (LeafNodeDouble*) currentPageData;
-		if(highOp == LTE && curr->keyArray[nextEntry] > highValDouble) {
-			throw IndexScanCompletedException();
-		}
-		if(highOp == LT && curr->keyArray[nextEntry] >= highValDouble) {
-			throw IndexScanCompletedException();
-		}
-		outRid = curr->ridArray[nextEntry];
-		if(nextEntry == leafOccupancy-1 ||  curr->ridArray[nextEntry+1].page_number == 0) {
-			if(curr->rightSibPageNo == 0) {
-
-				currentPageNum = 0;
-			}
-			else{
-				currentPageNum = curr->rightSibPageNo;
-				bufMgr->readPage(file,currentPageNum, currentPageData);
-				nextEntry = 0;
-				bufMgr->unPinPage(file,currentPageNum,false);
-
-			}
-		}
-		else{
-			nextEntry++;
-		}
-
-
+		scanLeaf<double>(outRid, highValDouble);
 	}
 	else{
-		LeafNodeString* curr = (LeafNodeString*) currentPageData;
 		char* s = (char*)malloc(STRINGSIZE);
 		snprintf(s,STRINGSIZE, "%s",highValString.c_str());
-		if(highOp == LTE && strcmp(curr->keyArray[nextEntry],s)>0) {
+		scanLeaf<char*>(outRid, s);
+	}
+	}
+
+	// -----------------------------------------------------------------------------
+	// BTreeIndex::scanLeaf
+	// -----------------------------------------------------------------------------
+
+	template<class T, std::size_t PAGE_SIZE> void BTreeIndex::scanLeafOf(RecordId& outRid, T highVal)
+	{
+		typedef typename IndexNodes<T, PAGE_SIZE>::Leaf Leaf;
+
+		const Leaf* curr = (const Leaf*) currentPageData.page();
+		if(highOp == LTE && compare<T>((T) curr->keyArray[nextEntry], highVal) > 0) {
 			throw IndexScanCompletedException();
 		}
-		if(highOp == LT && strcmp(curr->keyArray[nextEntry],s)>=0) {
+		if(highOp == LT && compare<T>((T) curr->keyArray[nextEntry], highVal) >= 0) {
 			throw IndexScanCompletedException();
 		}
 		outRid = curr->ridArray[nextEntry];
@@ -480,13 +393,16 @@ namespace badgerdb
 			if(curr->rightSibPageNo == 0) {
 
 				currentPageNum = 0;
+				currentPageData.release();
 			}
 			else{
 				currentPageNum = curr->rightSibPageNo;
-				bufMgr->readPage(file,currentPageNum, currentPageData);
+				currentPageData = bufMgr->readConstPage(file,currentPageNum);
 				nextEntry = 0;
-				bufMgr->unPinPage(file,currentPageNum,false);
-
+				//start reading the leaf after it while this one is scanned
+				if(((const Leaf*) currentPageData.page())->rightSibPageNo != 0) {
+					bufMgr->prefetch(file, ((const Leaf*) currentPageData.page())->rightSibPageNo, 1);
+				}
 			}
 		}
 		else{
@@ -494,9 +410,6 @@ namespace badgerdb
 		}
 	}
 
-
-	}
-
 	// -----------------------------------------------------------------------------
 	// BTreeIndex::endScan
 	// -----------------------------------------------------------------------------
@@ -507,20 +420,8 @@ namespace badgerdb
 		if (!scanExecuting) {
 			throw ScanNotInitializedException();
 		}
-		// try the best to unpin all the pages and ignore exceptions
-		try{
-			if(this->currentPageNum !=0){
-				bufMgr->unPinPage(this->file, this->currentPageNum, false);
-			}
-		}
-		catch(PageNotPinnedException e){
-		}
-
-		try{
-			bufMgr->unPinPage(this->file,this->rootPageNum,true);
-		}
-		catch(PageNotPinnedException e){
-		}
+		// unpin the leaf the scan stopped on
+		currentPageData.release();
 
 
 		scanExecuting = false;
@@ -554,23 +455,20 @@ namespace badgerdb
 
 	template<class T, class LT> int BTreeIndex::leafPos(PageId currNo, T lowVal){
 		int pos = 0;
-		Page* currPage;
 		T curr;
-		bufMgr->readPage(file,currNo,currPage);
-		LT* currNode = (LT*) currPage;
+		ConstPageHandle currPage = bufMgr->readConstPage(file,currNo);
+		const LT* currNode = (const LT*) currPage.page();
 
 		while (pos < leafOccupancy && currNode->ridArray[pos].page_number != 0) {
-			curr = currNode->keyArray[pos];
+			curr = (T) currNode->keyArray[pos];
 			if(lowOp == GT){
 				if (attributeType == STRING) {
 					if (compare(curr, lowVal) > 0) {
-						bufMgr->unPinPage(this->file,currNo,false);
 						return pos;
 					}
 				}
 				else {
 					if (compare<T>(curr, lowVal) > 0) {
-						bufMgr->unPinPage(this->file,currNo,false);
 						return pos;
 					}
 				}
@@ -578,20 +476,17 @@ namespace badgerdb
 			else if(lowOp == GTE){
 				if (attributeType == STRING) {
 					if (compare(curr, lowVal) >= 0) {
-						bufMgr->unPinPage(this->file,currNo,false);
 						return pos;
 					}
 				}
 				else {
 					if (compare<T>(curr, lowVal) >= 0) {
-						bufMgr->unPinPage(this->file,currNo,false);
 						return pos;
 					}
 				}
 			}
 			pos++;	
 		}
-		bufMgr->unPinPage(this->file,currNo,false);
 		if(pos==leafOccupancy || currNode->ridArray[pos].page_number == 0) {
 			pos--;
 		}
@@ -606,29 +501,25 @@ namespace badgerdb
 	//----------------------------------------------------------------------------
 	template<class T,class NT> int BTreeIndex::nonLeafPos(PageId currNo, T lowVal){
 		int pos = 0;
-		Page* currPage;
-		bufMgr->readPage(file,currNo,currPage);
-		NT* currNode = (NT*) currPage;
+		ConstPageHandle currPage = bufMgr->readConstPage(file,currNo);
+		const NT* currNode = (const NT*) currPage.page();
 		T curr;
 
 		while (pos < nodeOccupancy && currNode->pageNoArray[pos] != 0) {
-			curr = currNode->keyArray[pos];
+			curr = (T) currNode->keyArray[pos];
 			if (attributeType == STRING) {
 				if(compare(curr, lowVal) > 0) {
-					bufMgr->unPinPage(this->file,currNo,false);
 					return pos;
 				}
 			}
 			else {
 				if(compare<T>(curr, lowVal) > 0) {
-					bufMgr->unPinPage(this->file,currNo,false);
 					return pos;
 				}
 			}
 			pos++;
 		}
 
-		bufMgr->unPinPage(this->file,currNo,false);
 		if(currNode->pageNoArray[pos] == 0) {
 			pos--;
 		}
@@ -761,11 +652,12 @@ namespace badgerdb
 	// ----------------------------------------------------------------------------
 	template<class LT,class PP,class RP> void BTreeIndex::splitLeaf(LT* leafNode, RP RIDPair, PP& newPair) {
 		PageId newPageNo;
-		Page* newPage;
 		LT* newLeafNode;
 		int half = leafOccupancy/2+1;
-		bufMgr->allocPage(this->file, newPageNo, newPage); 
-		newLeafNode = (LT*)newPage; 
+		PageHandle newPage = bufMgr->allocPage(this->file, newPageNo); 
+		newPage.markDirty();
+		clearNode(newPage.page());
+		newLeafNode = (LT*)newPage.page(); 
 
 		for (int i = half; i < leafOccupancy; i++) {
 			newLeafNode->ridArray[i-half] = leafNode->ridArray[i];
@@ -789,8 +681,6 @@ namespace badgerdb
 			insertLeaf<LT,RP>(newLeafNode,RIDPair);
 		}
 
-		bufMgr->unPinPage(file, newPageNo, true);
-
 	}
 
 
@@ -799,11 +689,12 @@ namespace badgerdb
 	// ----------------------------------------------------------------------------
 	template<class NT,class PP> void BTreeIndex::splitNonLeaf(NT* nonLeafNode, PP returnP, PP& newPKPair) {
 		PageId newPageNo;
-		Page* newPage;
 		NT* newNonLeafNode;
 		int mid = nodeOccupancy/2+1;
-		bufMgr->allocPage(file, newPageNo, newPage);
-		newNonLeafNode = (NT*)newPage;
+		PageHandle newPage = bufMgr->allocPage(file, newPageNo);
+		newPage.markDirty();
+		clearNode(newPage.page());
+		newNonLeafNode = (NT*)newPage.page();
 
 		// new node has same level with spliteed node
 		newNonLeafNode->level = nonLeafNode->level; 
@@ -831,8 +722,6 @@ namespace badgerdb
 			insertNonLeaf <NT,PP> (newNonLeafNode, returnP);
 		}
 
-		bufMgr->unPinPage(file, newPageNo, true);
-
 	} 
 
 
@@ -840,14 +729,14 @@ namespace badgerdb
 	// BTreeIndex::createNewRoot
 	// ----------------------------------------------------------------------------
 	template<class LT,class NT,class PP,class RP> void BTreeIndex::createNewRoot(PageId oldNo, PP newPair, int level){
-		Page* newRootPage;
 		PageId newRootPageNo;
-		Page* headerPage;
 		NT* newRootNode;
 		IndexMetaInfo * meta;
 
-		bufMgr->allocPage(file, newRootPageNo, newRootPage); 
-		newRootNode = (NT*)newRootPage;
+		PageHandle newRootPage = bufMgr->allocPage(file, newRootPageNo); 
+		newRootPage.markDirty();
+		clearNode(newRootPage.page());
+		newRootNode = (NT*)newRootPage.page();
 		newRootNode->pageNoArray[0] = oldNo;
 		newRootNode->pageNoArray[1] = newPair.pageNo;
 		onlyRoot = false;
@@ -862,11 +751,11 @@ namespace badgerdb
 		
 		rootPageNum = newRootPageNo;
 		
-		bufMgr->unPinPage(file, newRootPageNo, true);
-		bufMgr->readPage(file, headerPageNum, headerPage);
-		meta = (IndexMetaInfo*)headerPage;
+		newRootPage.release();
+		PageHandle headerPage = bufMgr->readPage(file, headerPageNum);
+		headerPage.markDirty();
+		meta = (IndexMetaInfo*)headerPage.page();
 		meta->rootPageNo = this->rootPageNum;
-		bufMgr->unPinPage(file, headerPageNum, true);
 
 	}
 
@@ -877,17 +766,15 @@ namespace badgerdb
 	{
 		
 		PageId childPageNo;
-		Page* childPage;
 		
-		Page* currPage;
 		NT* currNode;
 		PP curr;
 		PP newPKPair;
 		PP returnPPair;
 
 
-		bufMgr->readPage(file, currPageNo, currPage);
-		currNode = (NT*) currPage;
+		PageHandle currPage = bufMgr->readPage(file, currPageNo);
+		currNode = (NT*) currPage.page();
 
 		int pos = 0;
 		for(;pos<leafOccupancy;pos++) {
@@ -905,8 +792,8 @@ namespace badgerdb
 		// check level, if currNode is at level 1 just insert entry into leaf node
 		if (currNode->level == 1) {
 			// check if leaf node is full, if it is need to split leaf node
-			bufMgr->readPage(file, childPageNo, childPage);
-			LT* childLeafNode = (LT*) childPage;
+			PageHandle childPage = bufMgr->readPage(file, childPageNo);
+			LT* childLeafNode = (LT*) childPage.page();
 
 			if ((childLeafNode->ridArray[leafOccupancy-1]).page_number == 0) {
 				insertLeaf<LT,RP>(childLeafNode, newRPair);
@@ -922,18 +809,14 @@ namespace badgerdb
 					newPPair = newPKPair;
 				}
 			}
-			bufMgr->unPinPage(file,childPageNo,true); 
-			bufMgr->unPinPage(file,currPageNo,true);
+			childPage.markDirty();
+			currPage.markDirty();
 			return;
 		}
 		PP newChildPPair;
-		// if currNode is at level 0
-		bufMgr->unPinPage(file,currPageNo,false); 
+		// if currNode is at level 0; it stays pinned while the child is updated
 		start<T, LT, NT, PP, RP> (childPageNo, newChildPPair, newRPair);
 
-		Page* newReadCurr;
-		bufMgr->readPage(file,currPageNo,newReadCurr);
-
 		if (newChildPPair.pageNo != 0) {
 			returnPPair.set(newChildPPair.pageNo, newChildPPair.key);
 
@@ -947,8 +830,84 @@ namespace badgerdb
 				newPPair = newPKPair;
 			}
 		}
-		bufMgr->unPinPage(file, currPageNo, (newChildPPair.pageNo !=0) ); 
+		if (newChildPPair.pageNo != 0) {
+			currPage.markDirty();
+		}
+
+	}
+
+	// -----------------------------------------------------------------------------
+	// BTreeIndex::clearNode
+	// -----------------------------------------------------------------------------
+
+	void BTreeIndex::clearNode(Page* node)
+	{
+		// a new page larger than Page::SIZE holds a page header in each unit,
+		// which would read as used slots
+		memset(node, 0, file->pageSize());
+	}
+
+	// -----------------------------------------------------------------------------
+	// BTreeIndex::layoutNodes
+	// -----------------------------------------------------------------------------
+
+	template<class T, std::size_t PAGE_SIZE> void BTreeIndex::layoutNodesOf(Page* newRoot)
+	{
+		typedef typename IndexNodes<T, PAGE_SIZE>::Leaf Leaf;
+		typedef typename IndexNodes<T, PAGE_SIZE>::NonLeaf NonLeaf;
+
+		leafOccupancy = Leaf::OCCUPANCY;
+		nodeOccupancy = NonLeaf::OCCUPANCY;
+		if (newRoot != NULL) {
+			((Leaf*) newRoot)->rightSibPageNo = 0;
+		}
+	}
+
+	// -----------------------------------------------------------------------------
+	// Page size dispatch
+	// -----------------------------------------------------------------------------
+
+	// the index page sizes are the size classes of Page::sizeClassOf
+	static_assert(Page::MAX_SIZE == 8 * Page::SIZE, "each index page size needs a case below");
+
+	template<class T> void BTreeIndex::layoutNodes(Page* newRoot)
+	{
+		switch (file->pageSize()) {
+			case Page::SIZE: layoutNodesOf<T, Page::SIZE>(newRoot); break;
+			case 2 * Page::SIZE: layoutNodesOf<T, 2 * Page::SIZE>(newRoot); break;
+			case 4 * Page::SIZE: layoutNodesOf<T, 4 * Page::SIZE>(newRoot); break;
+			default: layoutNodesOf<T, 8 * Page::SIZE>(newRoot); break;
+		}
+	}
+
+	template<class T> void BTreeIndex::insertPair(RIDKeyPair<T> newPair)
+	{
+		switch (file->pageSize()) {
+			case Page::SIZE: insertPairOf<T, Page::SIZE>(newPair); break;
+			case 2 * Page::SIZE: insertPairOf<T, 2 * Page::SIZE>(newPair); break;
+			case 4 * Page::SIZE: insertPairOf<T, 4 * Page::SIZE>(newPair); break;
+			default: insertPairOf<T, 8 * Page::SIZE>(newPair); break;
+		}
+	}
+
+	template<class T> void BTreeIndex::searchFor(T lowVal)
+	{
+		switch (file->pageSize()) {
+			case Page::SIZE: searchForOf<T, Page::SIZE>(lowVal); break;
+			case 2 * Page::SIZE: searchForOf<T, 2 * Page::SIZE>(lowVal); break;
+			case 4 * Page::SIZE: searchForOf<T, 4 * Page::SIZE>(lowVal); break;
+			default: searchForOf<T, 8 * Page::SIZE>(lowVal); break;
+		}
+	}
 
+	template<class T> void BTreeIndex::scanLeaf(RecordId& outRid, T highVal)
+	{
+		switch (file->pageSize()) {
+			case Page::SIZE: scanLeafOf<T, Page::SIZE>(outRid, highVal); break;
+			case 2 * Page::SIZE: scanLeafOf<T, 2 * Page::SIZE>(outRid, highVal); break;
+			case 4 * Page::SIZE: scanLeafOf<T, 4 * Page::SIZE>(outRid, highVal); break;
+			default: scanLeafOf<T, 8 * Page::SIZE>(outRid, highVal); break;
+		}
 	}
 
 } // end namespace badgerdb
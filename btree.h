@@ -49,40 +49,13 @@ namespace badgerdb
 	const  int STRINGSIZE = 10;
 
 	/**
-	 * @brief Number of key slots in B+Tree leaf for INTEGER key.
+	 * @brief Default size of the pages of an index file, and so of its nodes.  An index
+	 * may be built on any power of two multiple of Page::SIZE up to Page::MAX_SIZE
+	 * instead; larger nodes give a wider fan-out and a shallower tree, but need a BufMgr
+	 * with frames of that size.  The size is recorded in the index file, which is opened
+	 * with its own.
 	 */
-	//                                                  sibling ptr             key               rid
-	const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
-
-	/**
-	 * @brief Number of key slots in B+Tree leaf for DOUBLE key.
-	 */
-	//                                                     sibling ptr               key               rid
-	const  int DOUBLEARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( double ) + sizeof( RecordId ) );
-
-	/**
-	 * @brief Number of key slots in B+Tree leaf for STRING key.
-	 */
-	//                                                    sibling ptr           key                      rid
-	const  int STRINGARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( 10 * sizeof(char) + sizeof( RecordId ) );
-
-	/**
-	 * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
-	 */
-	//                                                     level     extra pageNo                  key       pageNo
-	const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
-
-	/**
-	 * @brief Number of key slots in B+Tree leaf for DOUBLE key.
-	 */
-	//                                                        level        extra pageNo                 key            pageNo   -1 due to structure padding
-	const  int DOUBLEARRAYNONLEAFSIZE = (( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( double ) + sizeof( PageId ) )) - 1;
-
-	/**
-	 * @brief Number of key slots in B+Tree leaf for STRING key.
-	 */
-	//                                                        level        extra pageNo             key                   pageNo
-	const  int STRINGARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( 10 * sizeof(char) + sizeof( PageId ) );
+	const  std::size_t INDEX_PAGE_SIZE = Page::SIZE;
 
 	/**
 	 * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
@@ -170,9 +143,17 @@ namespace badgerdb
 	   */
 
 	/**
-	 * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+	 * @brief Structure for all non-leaf nodes when the key is of INTEGER type, in pages of
+	 * PAGE_SIZE bytes.
 	 */
+	template<std::size_t PAGE_SIZE>
 	struct NonLeafNodeInt{
+		/**
+		 * Number of key slots.
+		 */
+		//                                          level     extra pageNo                  key       pageNo
+		static const int OCCUPANCY = ( PAGE_SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+
 		/**
 		 * Level of the node in the tree.
 		 */
@@ -181,18 +162,26 @@ namespace badgerdb
 		/**
 		 * Stores keys.
 		 */
-		int keyArray[ INTARRAYNONLEAFSIZE ];
+		int keyArray[ OCCUPANCY ];
 
 		/**
 		 * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
 		 */
-		PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
+		PageId pageNoArray[ OCCUPANCY + 1 ];
 	};
 
 	/**
-	 * @brief Structure for all non-leaf nodes when the key is of DOUBLE type.
+	 * @brief Structure for all non-leaf nodes when the key is of DOUBLE type, in pages of
+	 * PAGE_SIZE bytes.
 	 */
+	template<std::size_t PAGE_SIZE>
 	struct NonLeafNodeDouble{
+		/**
+		 * Number of key slots.
+		 */
+		//                                             level        extra pageNo                 key            pageNo   -1 due to structure padding
+		static const int OCCUPANCY = (( PAGE_SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( double ) + sizeof( PageId ) )) - 1;
+
 		/**
 		 * Level of the node in the tree.
 		 */
@@ -201,18 +190,26 @@ namespace badgerdb
 		/**
 		 * Stores keys.
 		 */
-		double keyArray[ DOUBLEARRAYNONLEAFSIZE ];
+		double keyArray[ OCCUPANCY ];
 
 		/**
 		 * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
 		 */
-		PageId pageNoArray[ DOUBLEARRAYNONLEAFSIZE + 1 ];
+		PageId pageNoArray[ OCCUPANCY + 1 ];
 	};
 
 	/**
-	 * @brief Structure for all non-leaf nodes when the key is of STRING type.
+	 * @brief Structure for all non-leaf nodes when the key is of STRING type, in pages of
+	 * PAGE_SIZE bytes.
 	 */
+	template<std::size_t PAGE_SIZE>
 	struct NonLeafNodeString{
+		/**
+		 * Number of key slots.
+		 */
+		//                                             level        extra pageNo             key                   pageNo
+		static const int OCCUPANCY = ( PAGE_SIZE - sizeof( int ) - sizeof( PageId ) ) / ( 10 * sizeof(char) + sizeof( PageId ) );
+
 		/**
 		 * Level of the node in the tree.
 		 */
@@ -221,29 +218,37 @@ namespace badgerdb
 		/**
 		 * Stores keys.
 		 */
-		char keyArray[ STRINGARRAYNONLEAFSIZE ][ STRINGSIZE ];
+		char keyArray[ OCCUPANCY ][ STRINGSIZE ];
 		// not allowed
-		//std::string keyArray[ STRINGARRAYNONLEAFSIZE ];
+		//std::string keyArray[ OCCUPANCY ];
 
 		/**
 		 * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
 		 */
-		PageId pageNoArray[ STRINGARRAYNONLEAFSIZE + 1 ];
+		PageId pageNoArray[ OCCUPANCY + 1 ];
 	};
 
 	/**
-	 * @brief Structure for all leaf nodes when the key is of INTEGER type.
+	 * @brief Structure for all leaf nodes when the key is of INTEGER type, in pages of
+	 * PAGE_SIZE bytes.
 	 */
+	template<std::size_t PAGE_SIZE>
 	struct LeafNodeInt{
+		/**
+		 * Number of key slots.
+		 */
+		//                                              sibling ptr             key               rid
+		static const int OCCUPANCY = ( PAGE_SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+
 		/**
 		 * Stores keys.
 		 */
-		int keyArray[ INTARRAYLEAFSIZE ];
+		int keyArray[ OCCUPANCY ];
 
 		/**
 		 * Stores RecordIds.
 		 */
-		RecordId ridArray[ INTARRAYLEAFSIZE ];
+		RecordId ridArray[ OCCUPANCY ];
 
 		/**
 		 * Page number of the leaf on the right side.
@@ -253,18 +258,26 @@ namespace badgerdb
 	};
 
 	/**
-	 * @brief Structure for all leaf nodes when the key is of DOUBLE type.
+	 * @brief Structure for all leaf nodes when the key is of DOUBLE type, in pages of
+	 * PAGE_SIZE bytes.
 	 */
+	template<std::size_t PAGE_SIZE>
 	struct LeafNodeDouble{
+		/**
+		 * Number of key slots.
+		 */
+		//                                              sibling ptr               key               rid
+		static const int OCCUPANCY = ( PAGE_SIZE - sizeof( PageId ) ) / ( sizeof( double ) + sizeof( RecordId ) );
+
 		/**
 		 * Stores keys.
 		 */
-		double keyArray[ DOUBLEARRAYLEAFSIZE ];
+		double keyArray[ OCCUPANCY ];
 
 		/**
 		 * Stores RecordIds.
 		 */
-		RecordId ridArray[ DOUBLEARRAYLEAFSIZE ];
+		RecordId ridArray[ OCCUPANCY ];
 
 		/**
 		 * Page number of the leaf on the right side.
@@ -274,20 +287,28 @@ namespace badgerdb
 	};
 
 	/**
-	 * @brief Structure for all leaf nodes when the key is of STRING type.
+	 * @brief Structure for all leaf nodes when the key is of STRING type, in pages of
+	 * PAGE_SIZE bytes.
 	 */
+	template<std::size_t PAGE_SIZE>
 	struct LeafNodeString{
+		/**
+		 * Number of key slots.
+		 */
+		//                                              sibling ptr           key                      rid
+		static const int OCCUPANCY = ( PAGE_SIZE - sizeof( PageId ) ) / ( 10 * sizeof(char) + sizeof( RecordId ) );
+
 		/**
 		 * Stores keys.
 		 */
-		char keyArray[ STRINGARRAYLEAFSIZE ][ STRINGSIZE ];
+		char keyArray[ OCCUPANCY ][ STRINGSIZE ];
 		// not allowed
-		//std::string keyArray[ STRINGARRAYNONLEAFSIZE ];
+		//std::string keyArray[ OCCUPANCY ];
 
 		/**
 		 * Stores RecordIds.
 		 */
-		RecordId ridArray[ STRINGARRAYLEAFSIZE ];
+		RecordId ridArray[ OCCUPANCY ];
 
 		/**
 		 * Page number of the leaf on the right side.
@@ -296,6 +317,63 @@ namespace badgerdb
 		PageId rightSibPageNo;
 	};
 
+	template<std::size_t PAGE_SIZE> const int NonLeafNodeInt<PAGE_SIZE>::OCCUPANCY;
+	template<std::size_t PAGE_SIZE> const int NonLeafNodeDouble<PAGE_SIZE>::OCCUPANCY;
+	template<std::size_t PAGE_SIZE> const int NonLeafNodeString<PAGE_SIZE>::OCCUPANCY;
+	template<std::size_t PAGE_SIZE> const int LeafNodeInt<PAGE_SIZE>::OCCUPANCY;
+	template<std::size_t PAGE_SIZE> const int LeafNodeDouble<PAGE_SIZE>::OCCUPANCY;
+	template<std::size_t PAGE_SIZE> const int LeafNodeString<PAGE_SIZE>::OCCUPANCY;
+
+	/**
+	 * @brief Leaf and non-leaf node structures for keys of type T in pages of PAGE_SIZE bytes.
+	 */
+	template<class T, std::size_t PAGE_SIZE> struct IndexNodes;
+
+	template<std::size_t PAGE_SIZE> struct IndexNodes<int, PAGE_SIZE> {
+		typedef LeafNodeInt<PAGE_SIZE> Leaf;
+		typedef NonLeafNodeInt<PAGE_SIZE> NonLeaf;
+	};
+
+	template<std::size_t PAGE_SIZE> struct IndexNodes<double, PAGE_SIZE> {
+		typedef LeafNodeDouble<PAGE_SIZE> Leaf;
+		typedef NonLeafNodeDouble<PAGE_SIZE> NonLeaf;
+	};
+
+	template<std::size_t PAGE_SIZE> struct IndexNodes<char*, PAGE_SIZE> {
+		typedef LeafNodeString<PAGE_SIZE> Leaf;
+		typedef NonLeafNodeString<PAGE_SIZE> NonLeaf;
+	};
+
+	/**
+	 * @brief Number of key slots in B+Tree leaf for INTEGER key, in nodes of INDEX_PAGE_SIZE.
+	 */
+	const  int INTARRAYLEAFSIZE = LeafNodeInt<INDEX_PAGE_SIZE>::OCCUPANCY;
+
+	/**
+	 * @brief Number of key slots in B+Tree leaf for DOUBLE key, in nodes of INDEX_PAGE_SIZE.
+	 */
+	const  int DOUBLEARRAYLEAFSIZE = LeafNodeDouble<INDEX_PAGE_SIZE>::OCCUPANCY;
+
+	/**
+	 * @brief Number of key slots in B+Tree leaf for STRING key, in nodes of INDEX_PAGE_SIZE.
+	 */
+	const  int STRINGARRAYLEAFSIZE = LeafNodeString<INDEX_PAGE_SIZE>::OCCUPANCY;
+
+	/**
+	 * @brief Number of key slots in B+Tree non-leaf for INTEGER key, in nodes of INDEX_PAGE_SIZE.
+	 */
+	const  int INTARRAYNONLEAFSIZE = NonLeafNodeInt<INDEX_PAGE_SIZE>::OCCUPANCY;
+
+	/**
+	 * @brief Number of key slots in B+Tree non-leaf for DOUBLE key, in nodes of INDEX_PAGE_SIZE.
+	 */
+	const  int DOUBLEARRAYNONLEAFSIZE = NonLeafNodeDouble<INDEX_PAGE_SIZE>::OCCUPANCY;
+
+	/**
+	 * @brief Number of key slots in B+Tree non-leaf for STRING key, in nodes of INDEX_PAGE_SIZE.
+	 */
+	const  int STRINGARRAYNONLEAFSIZE = NonLeafNodeString<INDEX_PAGE_SIZE>::OCCUPANCY;
+
 	/**
 	 * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
 	 * relation. This index supports only one scan at a time.
@@ -335,12 +413,12 @@ namespace badgerdb
 			int     attrByteOffset;
 
 			/**
-			 * Number of keys in leaf node, depending upon the type of key.
+			 * Number of keys in leaf node, depending upon the type of key and the page size of the index file.
 			 */
 			int     leafOccupancy;
 
 			/**
-			 * Number of keys in non-leaf node, depending upon the type of key.
+			 * Number of keys in non-leaf node, depending upon the type of key and the page size of the index file.
 			 */
 			int     nodeOccupancy;
 
@@ -363,9 +441,9 @@ namespace badgerdb
 			PageId  currentPageNum;
 
 			/**
-			 * Current Page being scanned.
+			 * Current Page being scanned, pinned until the scan moves off it.
 			 */
-			Page    *currentPageData;
+			ConstPageHandle currentPageData;
 
 			/**
 			 * Low INTEGER value for scan.
@@ -509,6 +587,41 @@ namespace badgerdb
 			*/
 			template<class T> int compare(T a, T b);
 
+			/*
+			* zero a newly allocated node, so that all its slots read as empty
+			*/
+			void clearNode(Page* node);
+
+			/*
+			* Each of the following runs for keys of type T through the node structures for
+			* the index file's page size.  The first form looks the size up, the second
+			* takes it.
+			*/
+
+			/*
+			* set leafOccupancy and nodeOccupancy, and make newRoot, unless NULL, an empty leaf
+			*/
+			template<class T> void layoutNodes(Page* newRoot);
+			template<class T, std::size_t PAGE_SIZE> void layoutNodesOf(Page* newRoot);
+
+			/*
+			* insertEntry's helper
+			*/
+			template<class T> void insertPair(RIDKeyPair<T> newPair);
+			template<class T, std::size_t PAGE_SIZE> void insertPairOf(RIDKeyPair<T> newPair);
+
+			/*
+			* startScan's helper: find the first entry of the scan
+			*/
+			template<class T> void searchFor(T lowVal);
+			template<class T, std::size_t PAGE_SIZE> void searchForOf(T lowVal);
+
+			/*
+			* scanNext's helper: return the current entry, if not above highVal, and move past it
+			*/
+			template<class T> void scanLeaf(RecordId& outRid, T highVal);
+			template<class T, std::size_t PAGE_SIZE> void scanLeafOf(RecordId& outRid, T highVal);
+
 
 			///////////////////////////// END OF OUR FUNCTION AND FIELD ///////////////////////////////////////////////////
 
@@ -524,10 +637,15 @@ namespace badgerdb
 			 * @param bufMgrIn            Buffer Manager Instance
 			 * @param attrByteOffset      Offset of attribute, over which index is to be built, in the record
 			 * @param attrType            Datatype of attribute over which index is built
+			 * @param mapped              Whether to open the index file with BlobFile::openMapped, once built, so that
+			 *                            lookups and scans read its pages where they lie; entries cannot then be inserted
+			 * @param indexPageSize       Size of the pages of a new index file, rounded up by Page::sizeClassOf; an
+			 *                            existing file keeps its own.  bufMgrIn needs frames of that size.
 			 * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
 			 */
 			BTreeIndex(const std::string & relationName, std::string & outIndexName,
-					BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType);
+					BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType,
+					const bool mapped = false, const std::size_t indexPageSize = INDEX_PAGE_SIZE);
 
 
 			/**
@@ -547,6 +665,7 @@ namespace badgerdb
 			 * Make sure to unpin pages as soon as you can.
 			 * @param key     Key to insert, pointer to integer/double/char string
 			 * @param rid     Record ID of a record whose entry is getting inserted into the index.
+			 * @throws  InvalidPageException  If the index was opened mapped
 			 **/
 			const void insertEntry(const void* key, const RecordId rid);
 
@@ -7,6 +7,8 @@
 
 #include <memory>
 #include <iostream>
+#include <cstdlib>
+#include <new>
 #include "buffer.h"
 #include "bufHashTbl.h"
 #include "exceptions/hash_already_present_exception.h"
@@ -15,100 +17,97 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+BufHashTbl::BufHashTbl(const std::uint32_t maxEntries)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
-}
-
-BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
-{
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
-  for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+  // keep the load factor at or below one half so probe sequences stay short
+  HTSIZE = 4;
+  while (HTSIZE < 2 * maxEntries)
+    HTSIZE *= 2;
+  mask = HTSIZE - 1;
+
+  // allocate the slot array, aligned so that no slot straddles a cache line
+  void* mem = NULL;
+  if (posix_memalign(&mem, 64, HTSIZE * sizeof(hashBucket)) != 0)
+    throw std::bad_alloc();
+  ht = static_cast<hashBucket*>(mem);
+  for (std::uint32_t i = 0; i < HTSIZE; i++)
+    ht[i].file = NULL;
 }
 
 BufHashTbl::~BufHashTbl()
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
-    }
-  }
-  delete [] ht;
+  free(ht);
 }
 
 void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
+  std::uint32_t index = hash(file, pageNo);
 
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
+  for (std::uint32_t probes = 0; probes < HTSIZE; probes++)
+  {
+    hashBucket* tmpBuc = &ht[index];
+    if (tmpBuc->file == NULL)
+    {
+      tmpBuc->file = (File*) file;
+      tmpBuc->pageNo = pageNo;
+      tmpBuc->frameNo = frameNo;
+      return;
+    }
     if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
   		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
+    index = (index + 1) & mask;
   }
 
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
-  	throw HashTableException();
-
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  throw HashTableException();
 }
 
 void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+  if (!find(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
+
+bool BufHashTbl::find(const File* file, const PageId pageNo, FrameId &frameNo) const
+{
+  std::uint32_t index = hash(file, pageNo);
+  while (ht[index].file != NULL)
+  {
+    if (ht[index].file == file && ht[index].pageNo == pageNo)
     {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
+      frameNo = ht[index].frameNo; // return frameNo by reference
+      return true;
     }
-    tmpBuc = tmpBuc->next;
+    index = (index + 1) & mask;
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  return false;
 }
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
-
-  while (tmpBuc)
-	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
-
-      delete tmpBuc;
-      return;
-    }
-		else
-		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
+  std::uint32_t index = hash(file, pageNo);
+  while (ht[index].file != NULL && !(ht[index].file == file && ht[index].pageNo == pageNo))
+    index = (index + 1) & mask;
+
+  if (ht[index].file == NULL)
+    throw HashNotFoundException(file->filename(), pageNo);
+
+  // Backward-shift deletion: move later entries of the cluster into the hole
+  // whenever the hole lies between their home slot and their current slot, so
+  // that every remaining entry stays reachable from its home slot.
+  std::uint32_t hole = index;
+  std::uint32_t next = (hole + 1) & mask;
+  while (ht[next].file != NULL)
+  {
+    std::uint32_t home = hash(ht[next].file, ht[next].pageNo);
+    if (((next - home) & mask) >= ((next - hole) & mask))
+    {
+      ht[hole] = ht[next];
+      hole = next;
     }
+    next = (next + 1) & mask;
   }
-
-  throw HashNotFoundException(file->filename(), pageNo);
+  ht[hole].file = NULL;
 }
 
 }
@@ -7,12 +7,16 @@
 
 #pragma once
 
+#include <cstdint>
 #include "file.h"
 
 namespace badgerdb {
 
 /**
 * @brief Declarations for buffer pool hash table
+*
+* One slot of the open-addressing table; a slot whose file is NULL is empty.
+* Four slots share a cache line.
 */
 struct hashBucket {
 	/**
@@ -29,45 +33,76 @@ struct hashBucket {
 	 * frame number of page in the buffer pool
 	 */
 	FrameId frameNo;
-
-	/**
-	 * Next node in the hash table
-	 */
-	hashBucket*   next;
 };
 
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
+* The table uses open addressing with linear probing over a flat, cache-line
+* aligned array of slots which is allocated once, at construction, for the
+* maximum number of pages the table will ever hold.  Inserts and removes
+* therefore never allocate, and removes shift later entries of the probe
+* sequence back instead of leaving tombstones.
+*
 * @warning This class is not threadsafe.
 */
 class BufHashTbl
 {
  private:
 	/**
-	 *	Size of Hash Table
+	 *	Number of slots in the table, a power of two
+	 */
+  std::uint32_t HTSIZE;
+
+	/**
+	 *	HTSIZE - 1, used to reduce hash values to slot indices
 	 */
-  int HTSIZE;
+  std::uint32_t mask;
+
 	/**
 	 * Actual Hash table object
 	 */
-  hashBucket**  ht;
+  hashBucket*  ht;
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * returns slot index between 0 and HTSIZE-1 computed using file and pageNo
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  std::uint32_t hash(const File* file, const PageId pageNo) const
+  {
+    return (std::uint32_t) hash64(file, pageNo) & mask;
+  }
 
  public:
 	/**
+	 * Returns a well mixed 64 bit hash of (file, pageNo).  The table uses the low
+	 * bits, so callers spreading pages over several tables should use the high ones.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Hash value.
+	 */
+  static std::uint64_t hash64(const File* file, const PageId pageNo)
+  {
+    std::uint64_t key = (std::uint64_t) (std::uintptr_t) file ^ ((std::uint64_t) pageNo * 0x9E3779B97F4A7C15ULL);
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ULL;
+    key ^= key >> 33;
+    return key;
+  }
+
+	/**
    * Constructor of BufHashTbl class
+   *
+   * @param maxEntries  Largest number of entries the table will hold
 	 */
-	BufHashTbl(const int htSize);  // constructor
+	BufHashTbl(const std::uint32_t maxEntries);  // constructor
 
 	/**
    * Destructor of BufHashTbl class
@@ -81,7 +116,7 @@ class BufHashTbl
 	 * @param pageNo 	Page number in the file
 	 * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as running of memory
+   * @throws  HashTableException if the table already holds the maximum number of entries
 	 */
   void insert(const File* file, const PageId pageNo, const FrameId frameNo);
 
@@ -96,6 +131,18 @@ class BufHashTbl
 	 */
   void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
 
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool (ie. in
+   * the hash table) without throwing when it is not.  This is the variant
+   * for paths where a miss is expected, such as BufMgr::readPage.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, set only if the entry is found
+	 * @return  			True if the page entry is in the hash table.
+	 */
+  bool find(const File* file, const PageId pageNo, FrameId &frameNo) const;
+
 	/**
    * Delete entry (file,pageNo) from hash table.
 	 *
@@ -0,0 +1,454 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <memory>
+#include "bufPolicy.h"
+#include "bufHashTbl.h"
+#include "exceptions/buffer_exceeded_exception.h"
+
+namespace badgerdb {
+
+//----------------------------------------
+// ReplacementPolicy
+//----------------------------------------
+
+ReplacementPolicy* ReplacementPolicy::create(const ReplacementPolicyType type, BufDesc* descs,
+                                             const FrameId firstFrame, const std::uint32_t numFrames)
+{
+  switch (type)
+  {
+    case LRUK_POLICY:
+      return new LruKPolicy(descs, firstFrame, numFrames);
+    case ARC_POLICY:
+      return new ArcPolicy(descs, firstFrame, numFrames);
+    case CLOCK_POLICY:
+    default:
+      return new ClockPolicy(descs, firstFrame, numFrames);
+  }
+}
+
+std::uint64_t ReplacementPolicy::simulate(const ReplacementPolicyType type, const std::uint32_t numFrames,
+                                          const std::vector<PageRef>& trace)
+{
+  // Files only serve as hash keys here, so any distinct addresses will do.
+  std::uint32_t numFiles = 0;
+  for (std::size_t i = 0; i < trace.size(); i++)
+    numFiles = std::max(numFiles, trace[i].fileId + 1);
+  std::vector<char> fileTokens(numFiles);
+
+  std::unique_ptr<BufDesc[]> descs(new BufDesc[numFrames]);
+  for (FrameId i = 0; i < numFrames; i++)
+    descs[i].frameNo = i;
+
+  BufHashTbl table(numFrames);
+  std::unique_ptr<ReplacementPolicy> policy(create(type, descs.get(), 0, numFrames));
+  BufStats stats;
+  std::uint64_t hits = 0;
+
+  for (std::size_t i = 0; i < trace.size(); i++)
+  {
+    File* file = reinterpret_cast<File*>(&fileTokens[trace[i].fileId]);
+    FrameId frame;
+
+    if (table.find(file, trace[i].pageNo, frame))
+    {
+      hits++;
+      descs[frame].refbit = true;
+      policy->accessed(frame);
+      continue;
+    }
+
+    if (!policy->pickVictim(frame, stats))
+      throw BufferExceededException();
+
+    if (descs[frame].valid)
+    {
+      policy->evicted(frame);
+      table.remove(descs[frame].file, descs[frame].pageNo);
+    }
+    descs[frame].Set(file, trace[i].pageNo);
+    descs[frame].pinCnt = 0;
+    table.insert(file, trace[i].pageNo, frame);
+    policy->loaded(frame);
+  }
+
+  return hits;
+}
+
+//----------------------------------------
+// ClockPolicy
+//----------------------------------------
+
+ClockPolicy::ClockPolicy(BufDesc* descs, const FrameId firstFrame, const std::uint32_t numFrames)
+  : ReplacementPolicy(descs, firstFrame, numFrames),
+    clockHand(firstFrame + numFrames - 1)
+{
+}
+
+bool ClockPolicy::pickVictim(FrameId& frame, BufStats& stats)
+{
+  std::uint32_t numScanned = 0;
+
+  while (numScanned < 2*numFrames)	//Need to scn twice
+  {
+    // advance the clock
+    advanceClock();
+    numScanned++;
+    stats.sweepsteps++;
+
+    // frame is pinned or being read or written by another thread
+    if (! evictable(clockHand))
+    {
+      continue;
+    }
+
+    // if invalid, use frame; if not referenced and not pinned, use it
+    if (! isValid(clockHand) || ! isReferenced(clockHand))
+    {
+      frame = clockHand;
+      return true;
+    }
+
+    // has been referenced, clear the bit
+    clearReferenced(clockHand);
+  }
+
+  return false;
+}
+
+void ClockPolicy::upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count) const
+{
+  // the hand takes unreferenced frames on its first sweep, the others on its second
+  for (int sweep = 0; sweep < 2; sweep++)
+  {
+    for (std::uint32_t i = 1; i <= numFrames && frames.size() < count; i++)
+    {
+      const FrameId frame = firstFrame + (clockHand - firstFrame + i) % numFrames;
+      if (isValid(frame) && evictable(frame) && isReferenced(frame) == (sweep == 1))
+        frames.push_back(frame);
+    }
+  }
+}
+
+void ClockPolicy::resized(const std::uint32_t numFramesIn)
+{
+  numFrames = numFramesIn;
+  // a hand left on a frame that was cut off moves back to the last frame
+  if (clockHand >= firstFrame + numFrames)
+    clockHand = firstFrame + numFrames - 1;
+}
+
+//----------------------------------------
+// LruKPolicy
+//----------------------------------------
+
+LruKPolicy::LruKPolicy(BufDesc* descs, const FrameId firstFrame, const std::uint32_t numFrames,
+                       const std::uint32_t k)
+  : ReplacementPolicy(descs, firstFrame, numFrames),
+    K(k), now(0), history((std::size_t) numFrames * k, 0)
+{
+  for (FrameId frame = firstFrame; frame < firstFrame + numFrames; frame++)
+    order.insert(keyOf(frame));
+}
+
+LruKPolicy::HistoryKey LruKPolicy::keyOf(const FrameId frame) const
+{
+  const std::uint64_t* refs = &history[(std::size_t) (frame - firstFrame) * K];
+  return HistoryKey(std::make_pair(refs[K - 1], refs[0]), frame);
+}
+
+void LruKPolicy::touch(const FrameId frame, const bool reset)
+{
+  std::uint64_t* refs = &history[(std::size_t) (frame - firstFrame) * K];
+  order.erase(keyOf(frame));
+
+  if (reset)
+  {
+    std::fill(refs, refs + K, 0);
+  }
+  else
+  {
+    std::copy_backward(refs, refs + K - 1, refs + K);
+    refs[0] = ++now;
+  }
+
+  order.insert(keyOf(frame));
+}
+
+void LruKPolicy::loaded(const FrameId frame)
+{
+  touch(frame, true);
+  touch(frame, false);
+}
+
+void LruKPolicy::accessed(const FrameId frame)
+{
+  touch(frame, false);
+}
+
+void LruKPolicy::evicted(const FrameId frame)
+{
+  touch(frame, true);
+}
+
+void LruKPolicy::removed(const FrameId frame)
+{
+  touch(frame, true);
+}
+
+bool LruKPolicy::pickVictim(FrameId& frame, BufStats& stats)
+{
+  for (std::set<HistoryKey>::const_iterator it = order.begin(); it != order.end(); ++it)
+  {
+    stats.sweepsteps++;
+    if (evictable(it->second))
+    {
+      frame = it->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LruKPolicy::upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count) const
+{
+  for (std::set<HistoryKey>::const_iterator it = order.begin(); it != order.end() && frames.size() < count; ++it)
+  {
+    if (isValid(it->second) && evictable(it->second))
+      frames.push_back(it->second);
+  }
+}
+
+void LruKPolicy::resized(const std::uint32_t numFramesIn)
+{
+  for (FrameId frame = firstFrame + numFramesIn; frame < firstFrame + numFrames; frame++)
+    order.erase(keyOf(frame));
+  history.resize((std::size_t) numFramesIn * K, 0);
+  for (FrameId frame = firstFrame + numFrames; frame < firstFrame + numFramesIn; frame++)
+    order.insert(keyOf(frame));
+  numFrames = numFramesIn;
+}
+
+//----------------------------------------
+// ArcPolicy
+//----------------------------------------
+
+ArcPolicy::ArcPolicy(BufDesc* descs, const FrameId firstFrame, const std::uint32_t numFrames)
+  : ReplacementPolicy(descs, firstFrame, numFrames),
+    where(numFrames, NONE), position(numFrames), p(0), inFreeFrames(numFrames, false)
+{
+  // hand out the lowest frames first
+  for (FrameId frame = firstFrame + numFrames; frame > firstFrame; frame--)
+    makeFree(frame - 1);
+}
+
+void ArcPolicy::makeFree(const FrameId frame)
+{
+  where[frame - firstFrame] = NONE;
+  if (!inFreeFrames[frame - firstFrame])
+  {
+    inFreeFrames[frame - firstFrame] = true;
+    freeFrames.push_back(frame);
+  }
+}
+
+void ArcPolicy::unlink(const FrameId frame)
+{
+  const FrameId i = frame - firstFrame;
+  if (where[i] == T1)
+    t1.erase(position[i]);
+  else if (where[i] == T2)
+    t2.erase(position[i]);
+  where[i] = NONE;
+}
+
+void ArcPolicy::loaded(const FrameId frame)
+{
+  const FrameId i = frame - firstFrame;
+  const PageKey key(fileOf(frame), pageNoOf(frame));
+  unlink(frame);
+
+  GhostMap::iterator ghost;
+  if ((ghost = ghost1.find(key)) != ghost1.end())
+  {
+    // would have been a hit had T1 been larger
+    std::uint32_t delta = std::max<std::uint32_t>(1, b2.size() / b1.size());
+    p = std::min(numFrames, p + delta);
+    b1.erase(ghost->second);
+    ghost1.erase(ghost);
+    t2.push_front(frame);
+    where[i] = T2;
+  }
+  else if ((ghost = ghost2.find(key)) != ghost2.end())
+  {
+    // would have been a hit had T2 been larger
+    std::uint32_t delta = std::max<std::uint32_t>(1, b1.size() / b2.size());
+    p = (p > delta) ? p - delta : 0;
+    b2.erase(ghost->second);
+    ghost2.erase(ghost);
+    t2.push_front(frame);
+    where[i] = T2;
+  }
+  else
+  {
+    t1.push_front(frame);
+    where[i] = T1;
+  }
+  position[i] = (where[i] == T1) ? t1.begin() : t2.begin();
+}
+
+void ArcPolicy::accessed(const FrameId frame)
+{
+  const FrameId i = frame - firstFrame;
+  if (where[i] == T1)
+  {
+    t2.splice(t2.begin(), t1, position[i]);
+    where[i] = T2;
+  }
+  else if (where[i] == T2)
+  {
+    t2.splice(t2.begin(), t2, position[i]);
+  }
+}
+
+void ArcPolicy::evicted(const FrameId frame)
+{
+  const PageKey key(fileOf(frame), pageNoOf(frame));
+  const ListId list = where[frame - firstFrame];
+  unlink(frame);
+  makeFree(frame);
+
+  // a stale ghost of the same page may remain if its File object was reused
+  GhostMap::iterator ghost;
+  if ((ghost = ghost1.find(key)) != ghost1.end())
+  {
+    b1.erase(ghost->second);
+    ghost1.erase(ghost);
+  }
+  if ((ghost = ghost2.find(key)) != ghost2.end())
+  {
+    b2.erase(ghost->second);
+    ghost2.erase(ghost);
+  }
+
+  if (list == T1)
+  {
+    b1.push_front(key);
+    ghost1[key] = b1.begin();
+  }
+  else if (list == T2)
+  {
+    b2.push_front(key);
+    ghost2[key] = b2.begin();
+  }
+
+  trimGhosts();
+}
+
+void ArcPolicy::trimGhosts()
+{
+  // keep |T1| + |B1| <= c and the whole directory within 2c
+  while (!b1.empty() && t1.size() + b1.size() > numFrames)
+  {
+    ghost1.erase(b1.back());
+    b1.pop_back();
+  }
+  while (!b2.empty() && t1.size() + t2.size() + b1.size() + b2.size() > 2 * (std::size_t) numFrames)
+  {
+    ghost2.erase(b2.back());
+    b2.pop_back();
+  }
+}
+
+void ArcPolicy::removed(const FrameId frame)
+{
+  unlink(frame);
+  makeFree(frame);
+}
+
+bool ArcPolicy::pickFrom(std::list<FrameId>& list, FrameId& frame, BufStats& stats)
+{
+  for (std::list<FrameId>::reverse_iterator it = list.rbegin(); it != list.rend(); ++it)
+  {
+    stats.sweepsteps++;
+    if (evictable(*it))
+    {
+      frame = *it;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ArcPolicy::pickVictim(FrameId& frame, BufStats& stats)
+{
+  // unused frames first, dropping entries for frames loaded since they were freed;
+  // an unused frame still busy with I/O stays listed for a later call
+  for (std::size_t i = freeFrames.size(); i > 0; i--)
+  {
+    const FrameId candidate = freeFrames[i - 1];
+    stats.sweepsteps++;
+    if (where[candidate - firstFrame] != NONE)
+    {
+      freeFrames.erase(freeFrames.begin() + (i - 1));
+      inFreeFrames[candidate - firstFrame] = false;
+    }
+    else if (evictable(candidate))
+    {
+      frame = candidate;
+      return true;
+    }
+  }
+
+  // evict from T1 while it is above its target size, otherwise from T2
+  if (!t1.empty() && (t1.size() > p || t2.empty()))
+    return pickFrom(t1, frame, stats) || pickFrom(t2, frame, stats);
+  return pickFrom(t2, frame, stats) || pickFrom(t1, frame, stats);
+}
+
+void ArcPolicy::upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count) const
+{
+  const bool t1First = !t1.empty() && (t1.size() > p || t2.empty());
+  const std::list<FrameId>* lists[2] = {t1First ? &t1 : &t2, t1First ? &t2 : &t1};
+
+  for (int l = 0; l < 2; l++)
+  {
+    for (std::list<FrameId>::const_reverse_iterator it = lists[l]->rbegin();
+         it != lists[l]->rend() && frames.size() < count; ++it)
+    {
+      if (isValid(*it) && evictable(*it))
+        frames.push_back(*it);
+    }
+  }
+}
+
+void ArcPolicy::resized(const std::uint32_t numFramesIn)
+{
+  const std::uint32_t oldFrames = numFrames;
+
+  // frames cut off are on neither list by now, but may still be listed as free
+  std::vector<FrameId> kept;
+  for (std::size_t i = 0; i < freeFrames.size(); i++)
+  {
+    if (freeFrames[i] < firstFrame + numFramesIn)
+      kept.push_back(freeFrames[i]);
+  }
+  freeFrames.swap(kept);
+
+  numFrames = numFramesIn;
+  where.resize(numFrames, NONE);
+  position.resize(numFrames);
+  inFreeFrames.resize(numFrames, false);
+  for (FrameId frame = firstFrame + numFrames; frame > firstFrame + oldFrames; frame--)
+    makeFree(frame - 1);
+
+  p = std::min(p, numFrames);
+  trimGhosts();
+}
+
+}
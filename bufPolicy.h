@@ -0,0 +1,213 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <list>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+* @brief Two-sweep CLOCK: the policy BufMgr has always used
+*
+* The hand skips over frames whose reference bit is set, clearing it as it goes,
+* and stops at the first unpinned frame whose bit is already clear.  Two full
+* sweeps without finding one means every frame is pinned.
+*/
+class ClockPolicy : public ReplacementPolicy
+{
+ public:
+  ClockPolicy(BufDesc* descs, const FrameId firstFrame, const std::uint32_t numFrames);
+
+  const char* name() const { return "CLOCK"; }
+
+  void loaded(const FrameId /* frame */) {}
+
+  void accessed(const FrameId /* frame */) {}
+
+  void evicted(const FrameId /* frame */) {}
+
+  void removed(const FrameId /* frame */) {}
+
+  bool pickVictim(FrameId& frame, BufStats& stats);
+
+  void upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count) const;
+
+  void resized(const std::uint32_t numFramesIn);
+
+ private:
+	/**
+   * Current position of clockhand within the managed frames
+	 */
+  FrameId clockHand;
+
+	/**
+   * Advance clock to next managed frame
+	 */
+  void advanceClock()
+  {
+		clockHand = firstFrame + (clockHand - firstFrame + 1) % numFrames;
+  }
+};
+
+
+/**
+* @brief LRU-K: evict the frame whose K-th most recent reference is oldest
+*
+* Frames referenced fewer than K times since they were loaded have an infinite
+* backward K-distance and go first, least recently used first, so pages touched
+* once by a sequential scan are evicted before pages that are re-referenced.
+* Invalid frames sort ahead of everything else.
+*/
+class LruKPolicy : public ReplacementPolicy
+{
+ public:
+  LruKPolicy(BufDesc* descs, const FrameId firstFrame, const std::uint32_t numFrames, const std::uint32_t k = 2);
+
+  const char* name() const { return "LRU-K"; }
+
+  void loaded(const FrameId frame);
+
+  void accessed(const FrameId frame);
+
+  void evicted(const FrameId frame);
+
+  void removed(const FrameId frame);
+
+  bool pickVictim(FrameId& frame, BufStats& stats);
+
+  void upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count) const;
+
+  void resized(const std::uint32_t numFramesIn);
+
+ private:
+	/**
+   * (K-th most recent reference or 0, most recent reference) and frame; the
+   * smallest key is the best victim
+	 */
+  typedef std::pair<std::pair<std::uint64_t, std::uint64_t>, FrameId> HistoryKey;
+
+	/**
+   * Number of references tracked per frame
+	 */
+  std::uint32_t K;
+
+	/**
+   * Logical time, advanced on every reference
+	 */
+  std::uint64_t now;
+
+	/**
+   * K reference times per managed frame, most recent first, 0 if unused
+	 */
+  std::vector<std::uint64_t> history;
+
+	/**
+   * Every managed frame ordered by its HistoryKey
+	 */
+  std::set<HistoryKey> order;
+
+	/**
+   * Records a reference to the frame, or forgets its history if reset is set.
+	 */
+  void touch(const FrameId frame, const bool reset);
+
+  HistoryKey keyOf(const FrameId frame) const;
+};
+
+
+/**
+* @brief ARC (Megiddo and Modha): adaptive balance of recency and frequency
+*
+* Resident pages are kept on T1 (seen once recently) and T2 (seen at least twice).
+* Recently evicted pages are remembered on the ghost lists B1 and B2, and a hit
+* on a ghost moves the target size p of T1 towards the list that would have
+* kept the page.  Pinned frames are skipped when choosing a victim.
+*/
+class ArcPolicy : public ReplacementPolicy
+{
+ public:
+  ArcPolicy(BufDesc* descs, const FrameId firstFrame, const std::uint32_t numFrames);
+
+  const char* name() const { return "ARC"; }
+
+  void loaded(const FrameId frame);
+
+  void accessed(const FrameId frame);
+
+  void evicted(const FrameId frame);
+
+  void removed(const FrameId frame);
+
+  bool pickVictim(FrameId& frame, BufStats& stats);
+
+  void upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count) const;
+
+  void resized(const std::uint32_t numFramesIn);
+
+ private:
+  enum ListId { NONE, T1, T2 };
+
+  typedef std::pair<const File*, PageId> PageKey;
+
+  struct PageKeyHash
+  {
+    std::size_t operator()(const PageKey& key) const
+    {
+      return (std::size_t) BufHashTbl::hash64(key.first, key.second);
+    }
+  };
+
+  typedef std::unordered_map<PageKey, std::list<PageKey>::iterator, PageKeyHash> GhostMap;
+
+	/**
+   * Resident frames, most recently used at the front
+	 */
+  std::list<FrameId> t1, t2;
+
+	/**
+   * List each managed frame is on, and its position there
+	 */
+  std::vector<ListId> where;
+  std::vector<std::list<FrameId>::iterator> position;
+
+	/**
+   * Ghost lists of evicted pages, most recent at the front, with their indices
+	 */
+  std::list<PageKey> b1, b2;
+  GhostMap ghost1, ghost2;
+
+	/**
+   * Target size of t1
+	 */
+  std::uint32_t p;
+
+	/**
+   * Frames on neither list; entries whose frame has since been loaded are
+   * dropped lazily
+	 */
+  std::vector<FrameId> freeFrames;
+  std::vector<bool> inFreeFrames;
+
+  void unlink(const FrameId frame);
+
+  void makeFree(const FrameId frame);
+
+	/**
+   * Drops the oldest ghosts until the directory is within its bounds again.
+	 */
+  void trimGhosts();
+
+  bool pickFrom(std::list<FrameId>& list, FrameId& frame, BufStats& stats);
+};
+
+}
@@ -5,246 +5,1917 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
 #include <memory>
 #include <iostream>
+#include <limits>
+#include <new>
+#include <string>
+#include <thread>
+#include <sys/mman.h>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
 
 namespace badgerdb { 
 
+//----------------------------------------
+// Buffer pool statistics
+//----------------------------------------
+
+/**
+ * Counters of BufStats, with the names and descriptions exportStats gives them
+ */
+static const struct
+{
+  BufCounter BufStats::*field;
+  const char* name;
+  const char* help;
+} bufStatsCounters[] = {
+  {&BufStats::accesses, "accesses", "readPage requests"},
+  {&BufStats::hits, "hits", "readPage requests served from the pool"},
+  {&BufStats::misses, "misses", "readPage requests that read the page from disk"},
+  {&BufStats::diskreads, "disk_reads", "pages read from disk, including allocations and read-ahead"},
+  {&BufStats::diskwrites, "disk_writes", "pages written back to disk"},
+  {&BufStats::evictions, "evictions", "pages dropped to make room for another page"},
+  {&BufStats::dirtyevictions, "dirty_evictions", "pages written back because they were chosen for eviction"},
+  {&BufStats::bgwrites, "bg_writes", "pages written back by the background writer"},
+  {&BufStats::pinwaits, "pin_waits", "waits for another thread's I/O on a frame"},
+  {&BufStats::sweeps, "sweeps", "victim searches of the replacement policy"},
+  {&BufStats::sweepsteps, "sweep_steps", "frames examined by victim searches"},
+  {&BufStats::prefetches, "prefetches", "pages read ahead"},
+  {&BufStats::prefetchhits, "prefetch_hits", "read-ahead pages later requested"},
+  {&BufStats::prefetchwaits, "prefetch_waits", "read-ahead hits that waited for the read"},
+  {&BufStats::prefetchunused, "prefetch_unused", "read-ahead pages dropped unused"},
+  {&BufStats::victimhits, "victim_hits", "misses served from the compressed victim cache"},
+  {&BufStats::victimstores, "victim_stores", "evicted pages stored in the victim cache"},
+  {&BufStats::victimrejects, "victim_rejects", "evicted pages that did not compress well enough to store"},
+  {&BufStats::victimdrops, "victim_drops", "pages dropped from the victim cache to stay within budget"},
+  {&BufStats::victimbytesin, "victim_bytes_in", "bytes of pages stored in the victim cache, uncompressed"},
+  {&BufStats::victimbytesout, "victim_bytes_out", "bytes of pages stored in the victim cache, compressed"},
+  {&BufStats::ssdhits, "ssd_hits", "misses served from the SSD cache"},
+  {&BufStats::ssdstores, "ssd_stores", "evicted pages written to the SSD cache"},
+  {&BufStats::localaccesses, "local_accesses", "readPage requests from the NUMA node of the page's partition"},
+  {&BufStats::remoteaccesses, "remote_accesses", "readPage requests from another NUMA node"},
+  {&BufStats::framewaits, "frame_waits", "waits for a frame to be unpinned when every frame was pinned"},
+  {&BufStats::framewaittimeouts, "frame_wait_timeouts", "frame waits that gave up with BufferExceededException"},
+  {&BufStats::coalescedwrites, "coalesced_writes", "write calls saved by merging adjacent pages"},
+  {&BufStats::coalescedbytes, "coalesced_bytes", "bytes written in runs of several pages"},
+};
+
+static std::uint64_t nanosSince(const std::chrono::steady_clock::time_point& start)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+const std::uint32_t LatencyHistogram::NUM_BUCKETS;
+
+void LatencyHistogram::record(const std::uint64_t nanos)
+{
+  const std::uint64_t micros = nanos / 1000;
+  std::uint32_t i = 0;
+  while (i < NUM_BUCKETS - 1 && micros >= ((std::uint64_t) 1 << i))
+    i++;
+  buckets[i]++;
+  count++;
+  totalNanos += nanos;
+}
+
+void LatencyHistogram::add(const LatencyHistogram& other)
+{
+  for (std::uint32_t i = 0; i < NUM_BUCKETS; i++)
+    buckets[i] += other.buckets[i];
+  count += other.count;
+  totalNanos += other.totalNanos;
+}
+
+std::uint64_t LatencyHistogram::percentileMicros(const double fraction) const
+{
+  std::uint64_t samples = 0;
+  for (std::uint32_t i = 0; i < NUM_BUCKETS; i++)
+    samples += buckets[i];
+  if (samples == 0)
+    return 0;
+
+  const std::uint64_t wanted = std::max<std::uint64_t>(1, (std::uint64_t) (fraction * samples + 0.5));
+  std::uint64_t seen = 0;
+  for (std::uint32_t i = 0; i < NUM_BUCKETS; i++)
+  {
+    seen += buckets[i];
+    if (seen >= wanted)
+      return bucketLimitMicros(i);
+  }
+  return bucketLimitMicros(NUM_BUCKETS - 1);
+}
+
+void BufStats::add(const BufStats& other)
+{
+  for (std::size_t c = 0; c < sizeof(bufStatsCounters) / sizeof(bufStatsCounters[0]); c++)
+    this->*bufStatsCounters[c].field += other.*bufStatsCounters[c].field;
+  readLatency.add(other.readLatency);
+  writeLatency.add(other.writeLatency);
+  frameWaitLatency.add(other.frameWaitLatency);
+}
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
-	bufDescTable = new BufDesc[bufs];
+const std::uint32_t BufAccessStrategy::DEFAULT_RING_SIZE;
+const std::size_t BufMgr::HUGE_PAGE_SIZE;
+const std::uint32_t BufMgr::POOL_GROWTH_FACTOR;
+const std::uint32_t BufMgr::SHRINK_PIN_WAIT_MS;
+const std::uint32_t BufMgr::PREFETCH_THREADS;
+const std::uint32_t BufMgr::MAX_WRITE_RUN;
+const std::uint32_t BufMgr::MAX_READ_RUN;
+
+BufMgr::BufMgr(std::uint32_t bufs, std::uint32_t parts, ReplacementPolicyType policy, NumaPlacement numaPlacement)
+	: BufMgr(std::vector<PageSizeClass>(1, PageSizeClass(Page::SIZE, bufs)), parts, policy, numaPlacement) {
+}
+
+BufMgr::BufMgr(const std::vector<PageSizeClass>& classes, std::uint32_t parts, ReplacementPolicyType policy,
+               NumaPlacement numaPlacement)
+	: numBufs(0), placement(numaPlacement), traceStream(NULL), hotSetStream(NULL), ssdCache(NULL), frameWaitMs(0), bgWriterStop(false), prefetchStop(false) {
+  // one class per page size, smallest first
+  std::map<std::size_t, std::uint32_t> sizeFrames;
+  std::map<std::size_t, std::uint32_t> sizeMaxFrames;
+  for (std::size_t c = 0; c < classes.size(); c++)
+  {
+    sizeFrames[Page::sizeClassOf(classes[c].pageSize)] += classes[c].numFrames;
+    sizeMaxFrames[Page::sizeClassOf(classes[c].pageSize)] += classes[c].maxFrames;
+  }
+  if (sizeFrames.empty())
+    sizeFrames[Page::sizeClassOf(Page::SIZE)] = 0;
+
+  // every node gets the same number of partitions of each class, if every class
+  // is large enough to give each at least one
+  const NumaTopology& topology = NumaTopology::system();
+  numNodes = topology.numNodes();
+  std::map<std::size_t, std::uint32_t>::const_iterator it;
+  for (it = sizeFrames.begin(); it != sizeFrames.end(); ++it)
+  {
+    if (numNodes > it->second)
+      numNodes = 1;
+  }
+
+  std::vector<std::uint32_t> classFrames;
+  std::vector<std::uint32_t> classMaxFrames;
+  numPartitions = 0;
+  for (it = sizeFrames.begin(); it != sizeFrames.end(); ++it)
+  {
+    const std::uint32_t bufs = it->second;
+    std::uint32_t classParts = parts;
+    if (classParts == 0)
+    {
+      // one partition per hardware thread, but keep partitions large enough
+      // that a few pinned pages cannot exhaust one of them
+      classParts = std::thread::hardware_concurrency();
+      if (classParts > bufs / 64)
+        classParts = bufs / 64;
+    }
+    if (classParts > bufs)
+      classParts = bufs;
+    if (classParts == 0)
+      classParts = 1;
+    if (numNodes > 1)
+      classParts = std::max(numNodes, classParts / numNodes * numNodes);
+
+    pageSizes.push_back(it->first);
+    classFrames.push_back(bufs);
+    classMaxFrames.push_back((std::uint32_t) std::min<std::uint64_t>(
+      std::max<std::uint64_t>((std::uint64_t) bufs * POOL_GROWTH_FACTOR, sizeMaxFrames[it->first]),
+      std::numeric_limits<std::uint32_t>::max()));
+    classFirstPartition.push_back(numPartitions);
+    classPartitions.push_back(classParts);
+    numPartitions += classParts;
+    numBufs += bufs;
+  }
 
-  for (FrameId i = 0; i < bufs; i++) 
+  // reserve address space for every partition to grow into, in whole huge pages
+  const std::uint32_t framesPerHugePage = HUGE_PAGE_SIZE / sizeof(Page);
+  partitionCapacity = 0;
+  for (std::size_t c = 0; c < pageSizes.size(); c++)
   {
-  	bufDescTable[i].frameNo = i;
-  	bufDescTable[i].valid = false;
+    partitionCapacity = std::max(partitionCapacity, (std::uint32_t) (((std::uint64_t) classMaxFrames[c] + classPartitions[c] - 1) / classPartitions[c]));
   }
+  partitionCapacity = (partitionCapacity + framesPerHugePage - 1) / framesPerHugePage * framesPerHugePage;
 
-  bufPool = new Page[bufs];
+  // the pool is committed as partitions grow; the descriptors are left for the
+  // kernel to back on first touch
+  poolBytes = HUGE_PAGE_SIZE;
+  for (std::size_t c = 0; c < pageSizes.size(); c++)
+    poolBytes += (std::size_t) classPartitions[c] * partitionCapacity * pageSizes[c];
+  poolRegion = mmap(NULL, poolBytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (poolRegion == MAP_FAILED)
+    throw std::bad_alloc();
+  bufPool = reinterpret_cast<Page*>(((std::uintptr_t) poolRegion + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+  poolHugeTlb = true;
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+  descBytes = (std::size_t) numPartitions * partitionCapacity * sizeof(BufDesc);
+  void* descRegion = mmap(NULL, descBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (descRegion == MAP_FAILED)
+  {
+    munmap(poolRegion, poolBytes);
+    throw std::bad_alloc();
+  }
+  bufDescTable = static_cast<BufDesc*>(descRegion);
+
+  partitions = new BufPartition[numPartitions];
+  Page* pages = bufPool;
+  for (std::size_t c = 0; c < pageSizes.size(); c++)
+  {
+    for (std::uint32_t i = 0; i < classPartitions[c]; i++)
+    {
+      const std::uint32_t p = classFirstPartition[c] + i;
+      BufPartition& part = partitions[p];
+      const std::uint32_t numFrames = (std::uint32_t) (((std::uint64_t) classFrames[c] * (i + 1)) / classPartitions[c])
+                                    - (std::uint32_t) (((std::uint64_t) classFrames[c] * i) / classPartitions[c]);
+      part.firstFrame = p * partitionCapacity;
+      part.span = (std::uint32_t) (pageSizes[c] / Page::SIZE);
+      part.pages = pages;
+      pages += (std::size_t) partitionCapacity * part.span;
+      part.node = i % numNodes;
+      if (numNodes > 1)
+        topology.bindMemory(&bufDescTable[part.firstFrame], (std::size_t) partitionCapacity * sizeof(BufDesc), part.node);
+      commitFrames(part, numFrames);
+      part.numFrames = numFrames;
 
-  clockHand = bufs - 1;
+      part.hashTable = new BufHashTbl (part.numFrames);  // allocate the buffer hash table
+      part.policy = ReplacementPolicy::create(policy, bufDescTable, part.firstFrame, part.numFrames);
+    }
+  }
 }
 
 
 BufMgr::~BufMgr() {
-  //Flush out all unwritten pages
-  for (std::uint32_t i = 0; i < numBufs; i++) 
+  stopPrefetchers();
+  stopBgWriter();
+
+  if (hotSetStream != NULL)
+    saveHotSet(*hotSetStream);
+
+  //Flush out all unwritten pages, file by file in page order
+  std::vector<std::pair<std::pair<const File*, PageId>, FrameId> > dirtyFrames;
+  for (std::uint32_t p = 0; p < numPartitions; p++)
   {
-  	BufDesc* tmpbuf = &bufDescTable[i];
-  	if (tmpbuf->valid == true && tmpbuf->dirty == true)
-		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-  	}
+    std::unordered_map<const File*, std::vector<FrameId> >::const_iterator it;
+    for (it = partitions[p].fileFrames.begin(); it != partitions[p].fileFrames.end(); ++it)
+    {
+      for (std::size_t i = 0; i < it->second.size(); i++)
+      {
+        BufDesc* tmpbuf = &bufDescTable[it->second[i]];
+        if (tmpbuf->valid == true && tmpbuf->dirty == true)
+          dirtyFrames.push_back(std::make_pair(std::make_pair(it->first, tmpbuf->pageNo), it->second[i]));
+      }
+    }
   }
+  std::sort(dirtyFrames.begin(), dirtyFrames.end());
+  std::vector<FrameId> order(dirtyFrames.size());
+  for (std::size_t i = 0; i < dirtyFrames.size(); i++)
+    order[i] = dirtyFrames[i].second;
+  for (std::size_t i = 0; i < order.size(); )
+    i += writeRun(order, i);
 
-  delete [] bufDescTable;
-  delete [] bufPool;
+  delete ssdCache;
+  delete [] partitions;
+  munmap(bufDescTable, descBytes);
+  munmap(poolRegion, poolBytes);
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+void BufMgr::commitFrames(BufPartition& part, const std::uint32_t numFrames)
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+  const std::uint32_t framesPerHugePage = HUGE_PAGE_SIZE / (sizeof(Page) * part.span);
+  const std::uint32_t committed = (part.numFrames + framesPerHugePage - 1) / framesPerHugePage * framesPerHugePage;
+  const std::uint32_t wanted = (numFrames + framesPerHugePage - 1) / framesPerHugePage * framesPerHugePage;
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+  if (wanted > committed)
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    void* start = part.pages + (std::size_t) committed * part.span;
+    const std::size_t bytes = (std::size_t) (wanted - committed) * part.span * sizeof(Page);
+    void* region = MAP_FAILED;
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+#ifdef MAP_HUGETLB
+    // huge pages set aside by the administrator, if there are enough of them
+    region = mmap(start, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+#endif
+    if (region == MAP_FAILED)
     {
-      break;
+      poolHugeTlb = false;
+      region = mmap(start, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+      if (region == MAP_FAILED)
+        throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+      // otherwise let the kernel back the frames with transparent huge pages
+      madvise(region, bytes, MADV_HUGEPAGE);
+#endif
+    }
+
+    // fresh mappings forget any placement; have the frames placed on the
+    // partition's node when first touched
+    if (numNodes > 1)
+      NumaTopology::system().bindMemory(region, bytes, part.node);
+  }
+
+  for (FrameId i = part.firstFrame + part.numFrames; i < part.firstFrame + numFrames; i++)
+  {
+    new (&bufDescTable[i]) BufDesc();
+    bufDescTable[i].frameNo = i;
+    bufDescTable[i].page = part.pages + (std::size_t) (i - part.firstFrame) * part.span;
+    for (std::uint32_t unit = 0; unit < part.span; unit++)
+      new (bufDescTable[i].page + unit) Page();
+  }
+}
+
+void BufMgr::releaseFrames(BufPartition& part, const std::uint32_t oldFrames)
+{
+  const std::uint32_t framesPerHugePage = HUGE_PAGE_SIZE / (sizeof(Page) * part.span);
+  const std::uint32_t kept = (part.numFrames + framesPerHugePage - 1) / framesPerHugePage * framesPerHugePage;
+  const std::uint32_t committed = (oldFrames + framesPerHugePage - 1) / framesPerHugePage * framesPerHugePage;
+
+  // mapping fresh address space over the frames frees their memory
+  if (committed > kept)
+    mmap(part.pages + (std::size_t) kept * part.span, (std::size_t) (committed - kept) * part.span * sizeof(Page), PROT_NONE,
+         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+}
+
+BufPartition& BufMgr::partitionOf(const File* file, const PageId pageNo)
+{
+  std::uint32_t first = 0;
+  std::uint32_t count = numPartitions;
+  if (pageSizes.size() > 1 || file->pageSize() != pageSizes[0])
+  {
+    const std::uint32_t c = classOf(file);
+    first = classFirstPartition[c];
+    count = classPartitions[c];
+  }
+  if (count == 1)
+    return partitions[first];
+
+  // the page tables index by the low bits of the hash, so pick the partition
+  // with the high ones to keep the two choices independent
+  const std::uint64_t hash = BufHashTbl::hash64(file, pageNo) >> 32;
+  if (placement == NUMA_FILE_AFFINE && numNodes > 1)
+    return partitions[first + nodeOfFile(file) + numNodes * (hash % (count / numNodes))];
+  return partitions[first + hash % count];
+}
+
+std::uint32_t BufMgr::classOf(const File* file) const
+{
+  for (std::uint32_t c = 0; c < pageSizes.size(); c++)
+  {
+    if (pageSizes[c] >= file->pageSize())
+      return c;
+  }
+  throw BufferExceededException();
+}
+
+void BufMgr::readFrame(File* file, const PageId pageNo, const FrameId frameNo)
+{
+  Page* page = bufDescTable[frameNo].page;
+  if (file->pageSpan() == 1)
+  {
+    *page = file->readPage(pageNo);
+    return;
+  }
+
+  std::vector<Page*> units(file->pageSpan());
+  for (std::size_t i = 0; i < units.size(); i++)
+    units[i] = page + i;
+  file->readPages(pageNo, units);
+}
+
+void BufMgr::writeFrame(File* file, const PageId pageNo, const FrameId frameNo)
+{
+  const Page* page = bufDescTable[frameNo].page;
+  if (file->pageSpan() == 1)
+  {
+    file->writePage(pageNo, *page);
+    return;
+  }
+
+  std::vector<const Page*> units(file->pageSpan());
+  for (std::size_t i = 0; i < units.size(); i++)
+    units[i] = page + i;
+  file->writePages(pageNo, units);
+}
+
+bool BufMgr::allocBuf(BufPartition& part, std::unique_lock<std::mutex>& lock, FrameId & frame,
+                      BufAccessStrategy* strategy, std::pair<const File*, PageId>* victim,
+                      std::uint32_t* spillSlot, const bool mayWait)
+{
+  std::vector<FrameId>* ring = NULL;
+  std::uint32_t* cursor = NULL;
+  bool fromRing = false;
+
+  if (strategy != NULL && strategy->ringSize > 0)
+  {
+    if (strategy->rings.size() != numPartitions)
+    {
+      strategy->rings.assign(numPartitions, std::vector<FrameId>());
+      strategy->cursors.assign(numPartitions, 0);
+    }
+    ring = &strategy->rings[&part - partitions];
+    cursor = &strategy->cursors[&part - partitions];
+
+    // recycle the ring's oldest frame unless somebody else is using its page
+    if (*cursor < ring->size())
+    {
+      frame = (*ring)[*cursor];
+      const BufDesc& desc = bufDescTable[frame];
+      fromRing = frame < part.firstFrame + part.numFrames  // not given up by resize
+                 && !desc.ioInProgress && desc.pinCnt == 0 && !(desc.valid && desc.refbit);
     }
+  }
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+  // otherwise ask the partition's replacement policy for a frame to reuse
+  if (!fromRing)
+  {
+    part.stats.sweeps++;
+    if (!part.policy->pickVictim(frame, part.stats))
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
+      // frames still being read ahead or written back become free without an
+      // unpin, so only give up if none is
+      for (FrameId i = part.firstFrame; i < part.firstFrame + part.numFrames; i++)
+      {
+        if (bufDescTable[i].ioInProgress && bufDescTable[i].pinCnt == 0)
+        {
+          part.stats.pinwaits++;
+          part.ioDone.wait(lock);
+          return false;
+        }
+      }
+
+      // every frame is pinned: wait for an unpin, if allowed to
+      const std::uint32_t timeoutMs = frameWaitMs;
+      if (!mayWait || timeoutMs == 0)
+        throw BufferExceededException();
+
+      part.stats.framewaits++;
+      part.frameWaiters++;
+      const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      const std::cv_status status = part.ioDone.wait_until(lock, start + std::chrono::milliseconds(timeoutMs));
+      part.frameWaiters--;
+      part.stats.frameWaitLatency.record(nanosSince(start));
+      if (status == std::cv_status::timeout)
       {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
+        part.stats.framewaittimeouts++;
+        throw BufferExceededException();
       }
+      return false;
     }
-    else
+  }
+
+  BufDesc& desc = bufDescTable[frame];
+
+  // flush any existing changes to disk if necessary.  The old page stays in the
+  // hash table, flagged ioInProgress, until the write has completed so that no
+  // other thread can read a stale copy of it back from disk meanwhile.
+  if (desc.dirty)
+  {
+    part.stats.diskwrites++;
+    part.stats.dirtyevictions++;
+    fileStatsOf(part, desc.file).diskwrites++;
+    desc.dirty = false;
+    desc.ioInProgress = true;
+    if (ssdCache != NULL)
+      ssdCache->invalidate(desc.file->filename(), desc.pageNo);
+    lock.unlock();
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try
+    {
+      writeFrame(desc.file, desc.pageNo, frame);
+    }
+    catch (...)
+    {
+      lock.lock();
+      desc.dirty = true;
+      desc.ioInProgress = false;
+      part.ioDone.notify_all();
+      throw;
+    }
+
+    const std::uint64_t nanos = nanosSince(start);
+
+    lock.lock();
+    part.stats.writeLatency.record(nanos);
+    desc.ioInProgress = false;
+    part.ioDone.notify_all();
+    return false;
+  }
+
+  // reserve the page a place in the victim cache and the SSD cache, unless it
+  // was only brought in by a scan or a read-ahead nobody used, or is larger
+  // than the Page::SIZE slots of either cache
+  const bool keep = desc.valid && !desc.prefetched && !fromRing && part.span == 1;
+  if (victim != NULL)
+  {
+    victim->first = NULL;
+    if (part.victimCache != NULL && keep)
     {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      part.victimCache->reserve(desc.file, desc.pageNo);
+      *victim = std::make_pair(desc.file, desc.pageNo);
     }
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  if (spillSlot != NULL)
   {
-    throw BufferExceededException();
+    *spillSlot = SsdCache::NO_SLOT;
+    if (ssdCache != NULL && keep)
+      *spillSlot = ssdCache->reserve(desc.file->filename(), desc.pageNo);
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+
+  // remove previous entry from hash table
+  if (desc.valid)
   {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    if (desc.prefetched)
+      part.stats.prefetchunused++;
+    part.stats.evictions++;
+    part.policy->evicted(frame);
+    unmapFrame(part, frame);
   }
 
 	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  desc.Clear();
+  part.recentAllocs++;
 
-  // return new frame number
-  frame = clockHand;
+  // the frame takes the place of the recycled one in the ring
+  if (ring != NULL)
+  {
+    const std::uint32_t slots = std::max<std::uint32_t>(1, (strategy->ringSize + numPartitions - 1) / numPartitions);
+    if (*cursor < ring->size())
+      (*ring)[*cursor] = frame;
+    else
+      ring->push_back(frame);
+    *cursor = (*cursor + 1) % slots;
+  }
+
+  return true;
 } // end allocBuf
 
 	
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+BufPartition& BufMgr::partitionOfFrame(const FrameId frameNo)
 {
-  // check to see if it is already in the buffer pool
-  // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
-  FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  return partitions[frameNo / partitionCapacity];
+}
+
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page, BufAccessStrategy* strategy)
+{
+  // a mapped file is read-only, so its pages are only handed out as const
+  if (file->mapped())
+    throw InvalidPageException(pageNo, file->filename());
+  page = bufDescTable[pinPage(file, pageNo, strategy)].page;
+}
+
+void BufMgr::readPage(File* file, const PageId pageNo, const Page*& page, BufAccessStrategy* strategy)
+{
+  // pages of a mapped file are used where they lie, with nothing to pin
+  const Page* mapped = file->mappedPage(pageNo);
+  if (mapped != NULL)
+  {
+    tracePage(file, pageNo);
+    page = mapped;
+    return;
+  }
+  page = bufDescTable[pinPage(file, pageNo, strategy)].page;
+}
+
+PageHandle BufMgr::readPage(File* file, const PageId pageNo, BufAccessStrategy* strategy)
+{
+  if (file->mapped())
+    throw InvalidPageException(pageNo, file->filename());
+  const FrameId frameNo = pinPage(file, pageNo, strategy);
+  return PageHandle(this, file, pageNo, frameNo, bufDescTable[frameNo].page);
+}
+
+ConstPageHandle BufMgr::readConstPage(File* file, const PageId pageNo, BufAccessStrategy* strategy)
+{
+  const Page* mapped = file->mappedPage(pageNo);
+  if (mapped != NULL)
+  {
+    tracePage(file, pageNo);
+    return ConstPageHandle(mapped);
+  }
+  const FrameId frameNo = pinPage(file, pageNo, strategy);
+  return ConstPageHandle(PageHandle(this, file, pageNo, frameNo, bufDescTable[frameNo].page));
+}
+
+FrameId BufMgr::pinPage(File* file, const PageId pageNo, BufAccessStrategy* strategy)
+{
+  tracePage(file, pageNo);
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
+  BufPartition& part = partitionOf(file, pageNo);
+  const bool remote = numNodes > 1 && NumaTopology::system().currentNode() != part.node;
+  std::unique_lock<std::mutex> lock(part.latch);
+  FrameId frameNo = 0;
+  bool waited = false;
+  if (numNodes > 1)
+  {
+    if (remote)
+      part.stats.remoteaccesses++;
+    else
+      part.stats.localaccesses++;
   }
-  catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
+  std::pair<const File*, PageId> victim(NULL, 0);
+  std::uint32_t spillSlot = SsdCache::NO_SLOT;
+
+  while (true)
   {
-    // alloc a new frame
-    allocBuf(frameNo);
+    // check to see if it is already in the buffer pool
+    if (part.hashTable->find(file, pageNo, frameNo))
+    {
+      // another thread is still moving the page to or from disk; wait for it
+      // and look again since the frame may have been given to another page
+      if (bufDescTable[frameNo].ioInProgress)
+      {
+        waited = true;
+        part.stats.pinwaits++;
+        part.ioDone.wait(lock);
+        continue;
+      }
+
+      // set the referenced bit, unless this is the first use of a page a ring
+      // scan read ahead for itself
+      BufDesc& desc = bufDescTable[frameNo];
+      if (desc.prefetched)
+      {
+        part.stats.prefetchhits++;
+        if (waited)
+          part.stats.prefetchwaits++;
+        desc.prefetched = false;
+        if (strategy == NULL || strategy->ringSize == 0)
+          desc.refbit = true;
+      }
+      else
+        desc.refbit = true;
+      bufDescTable[frameNo].pinCnt++;
+      part.policy->accessed(frameNo);
+      part.stats.accesses++;
+      part.stats.hits++;
+      fileStatsOf(part, file).hits++;
+      return frameNo;
+    }
+
+    // not in the buffer pool, must allocate a new frame, looking the page up
+    // again if the latch was released
+    if (allocBuf(part, lock, frameNo, strategy, &victim, &spillSlot))
+      break;
+  }
+
+  // set up the entry properly and insert it in the hash table before releasing
+  // the latch, so that concurrent readers of the same page wait for this read
+  std::vector<char> compressed;
+  const bool fromVictimCache = part.victimCache != NULL && part.victimCache->take(file, pageNo, compressed);
+  BufDesc& desc = bufDescTable[frameNo];
+  desc.Set(file, pageNo);
+  desc.ioInProgress = true;
+  if (strategy != NULL && strategy->ringSize > 0)
+    desc.refbit = false;
+  mapFrame(part, frameNo);
+  part.policy->loaded(frameNo);
+  part.stats.accesses++;
+  part.stats.misses++;
+  fileStatsOf(part, file).misses++;
+  if (fromVictimCache)
+    part.stats.victimhits++;
+  lock.unlock();
+
+  // compress the page evicted from the frame, and spill it to the SSD cache,
+  // before it is overwritten
+  std::vector<char> evicted;
+  Page& page = *bufDescTable[frameNo].page;
+  const bool evictedFits = victim.first != NULL && VictimCache::compress(page, evicted);
+  const bool spilled = spillSlot != SsdCache::NO_SLOT && ssdCache->store(spillSlot, page);
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+  // read the page into the new frame, from the victim cache if it was there,
+  // else from the SSD cache if it is there
+  bool fromSsdCache = false;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  try
+  {
+    if (!fromVictimCache || !VictimCache::decompress(compressed, page))
+    {
+      fromSsdCache = ssdCache != NULL && part.span == 1 && ssdCache->read(file->filename(), pageNo, page);
+      if (!fromSsdCache)
+        readFrame(file, pageNo, frameNo);
+    }
+  }
+  catch (...)
+  {
+    lock.lock();
+    if (victim.first != NULL)
+      stashVictim(part, victim, evicted, evictedFits);
+    if (spilled)
+      part.stats.ssdstores++;
+    unmapFrame(part, frameNo);
+    desc.Clear();
+    part.policy->removed(frameNo);
+    part.ioDone.notify_all();
+    throw;
+  }
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+  const std::uint64_t nanos = nanosSince(start);
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+  lock.lock();
+  if (victim.first != NULL)
+    stashVictim(part, victim, evicted, evictedFits);
+  if (spilled)
+    part.stats.ssdstores++;
+  if (fromSsdCache)
+    part.stats.ssdhits++;
+  else if (!fromVictimCache)
+  {
+    part.stats.diskreads++;
+    fileStatsOf(part, file).diskreads++;
+    part.stats.readLatency.record(nanos);
   }
+  desc.ioInProgress = false;
+  part.ioDone.notify_all();
+  return frameNo;
 }
 
 
-void BufMgr::unPinPage(File* file, const PageId pageNo, 
-			     const bool dirty) 
+void BufMgr::prefetch(File* file, const PageId first, const std::uint32_t count, BufAccessStrategy* strategy)
 {
-  // lookup in hashtable
-  FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
-
-  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+  PrefetchJob job;
+  job.file = file;
 
-  // make sure the page is actually pinned
-  if (bufDescTable[frameNo].pinCnt == 0)
+  for (PageId pageNo = first; pageNo < first + count; pageNo++)
   {
-  	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+    if (file->mappedPage(pageNo) != NULL)
+      continue;
+    BufPartition& part = partitionOf(file, pageNo);
+    std::unique_lock<std::mutex> lock(part.latch);
+    FrameId frameNo = 0;
+
+    try
+    {
+      if (!claimForReadAhead(part, lock, file, pageNo, strategy, frameNo))
+        continue;
+    }
+    catch (const BufferExceededException&)
+    {
+      // every frame is pinned; read-ahead is only a hint
+      break;
+    }
+    job.pages.push_back(std::make_pair(pageNo, frameNo));
   }
-  else bufDescTable[frameNo].pinCnt--;
+
+  queueReadAhead(job);
 }
 
-void BufMgr::flushFile(const File* file) 
+bool BufMgr::claimForReadAhead(BufPartition& part, std::unique_lock<std::mutex>& lock, File* file,
+                               const PageId pageNo, BufAccessStrategy* strategy, FrameId& frameNo)
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
-	{
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->valid == true && tmpbuf->file == file)
-		{
-	    if (tmpbuf->pinCnt > 0)
-  			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+  // a page in the victim cache is decompressed faster than it could be read ahead
+  if (part.victimCache != NULL && part.victimCache->contains(file, pageNo))
+    return false;
 
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
+  // and one in the SSD cache is read from there on demand
+  if (ssdCache != NULL && ssdCache->contains(file->filename(), pageNo))
+    return false;
 
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
-  	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+  // read-ahead is only a hint, not worth waiting for a pinned-out pool
+  bool cached;
+  while (!(cached = part.hashTable->find(file, pageNo, frameNo)) &&
+         !allocBuf(part, lock, frameNo, strategy, NULL, NULL, false))
+  {
   }
+  if (cached)
+    return false;
+
+  // claim the frame unpinned, flagged ioInProgress until a read-ahead thread
+  // has filled it
+  BufDesc& desc = bufDescTable[frameNo];
+  desc.Set(file, pageNo);
+  desc.pinCnt = 0;
+  desc.refbit = false;
+  desc.ioInProgress = true;
+  desc.prefetched = true;
+  mapFrame(part, frameNo);
+  part.policy->loaded(frameNo);
+  part.stats.diskreads++;
+  part.stats.prefetches++;
+  fileStatsOf(part, file).diskreads++;
+  return true;
 }
 
-void BufMgr::disposePage(File* file, const PageId pageNo) 
+void BufMgr::queueReadAhead(const PrefetchJob& job)
 {
-	//Deallocate from file altogether
-  //See if it is in the buffer pool
-  FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  if (job.pages.empty())
+    return;
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+  {
+    std::lock_guard<std::mutex> guard(prefetchLatch);
+    if (prefetchers.empty())
+    {
+      for (std::uint32_t i = 0; i < PREFETCH_THREADS; i++)
+        prefetchers.push_back(std::thread(&BufMgr::prefetchLoop, this));
+    }
+    prefetchQueue.push_back(job);
+  }
+  prefetchWake.notify_one();
+}
 
-	hashTable->remove(file, pageNo);
+void BufMgr::readPages(File* file, const PageId first, const std::uint32_t count, std::vector<Page*>& pages,
+                       BufAccessStrategy* strategy)
+{
+  prefetch(file, first, count, strategy);
 
-  // deallocate it in the file	
-  file->deletePage(pageNo);
+  pages.assign(count, NULL);
+  for (std::uint32_t i = 0; i < count; i++)
+  {
+    try
+    {
+      readPage(file, first + i, pages[i], strategy);
+    }
+    catch (...)
+    {
+      // give back the pages pinned so far
+      for (std::uint32_t j = 0; j < i; j++)
+        unPinPage(file, first + j, false);
+      pages.clear();
+      throw;
+    }
+  }
 }
 
+void BufMgr::prefetchLoop()
+{
+  std::unique_lock<std::mutex> lock(prefetchLatch);
+
+  while (true)
+  {
+    while (prefetchQueue.empty() && !prefetchStop)
+      prefetchWake.wait(lock);
+    if (prefetchQueue.empty())
+      return;
+
+    PrefetchJob job = prefetchQueue.front();
+    prefetchQueue.pop_front();
+    lock.unlock();
 
-void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+    // read runs of adjacent pages with one call each
+    for (std::size_t i = 0; i < job.pages.size(); )
+    {
+      std::size_t count = 1;
+      while (i + count < job.pages.size() && count < MAX_READ_RUN &&
+             job.pages[i + count].first == job.pages[i].first + count)
+        count++;
+      readAhead(job, i, count);
+      i += count;
+    }
+
+    lock.lock();
+  }
+}
+
+void BufMgr::readAhead(const PrefetchJob& job, const std::size_t first, const std::size_t count)
 {
-  FrameId frameNo;
+  bool read = true;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  try
+  {
+    if (count == 1)
+      readFrame(job.file, job.pages[first].first, job.pages[first].second);
+    else
+    {
+      const std::uint32_t span = job.file->pageSpan();
+      std::vector<Page*> pages(count * span);
+      for (std::size_t i = 0; i < pages.size(); i++)
+        pages[i] = bufDescTable[job.pages[first + i / span].second].page + i % span;
+      job.file->readPages(job.pages[first].first, pages);
+    }
+  }
+  catch (...)
+  {
+    read = false;
+  }
+
+  if (!read && count > 1)
+  {
+    for (std::size_t i = first; i < first + count; i++)
+      readAhead(job, i, 1);
+    return;
+  }
+  const std::uint64_t nanos = nanosSince(start);
 
-  // alloc a new frame
-  allocBuf(frameNo);
+  for (std::size_t i = first; i < first + count; i++)
+  {
+    const PageId pageNo = job.pages[i].first;
+    const FrameId frameNo = job.pages[i].second;
+    BufPartition& part = partitionOf(job.file, pageNo);
+    std::lock_guard<std::mutex> guard(part.latch);
+    BufDesc& desc = bufDescTable[frameNo];
 
-  // allocate a new page in the file
-	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-  page = &bufPool[frameNo];
+    if (i == first && read)
+      part.stats.readLatency.record(nanos);
+    if (read)
+      desc.ioInProgress = false;
+    else
+    {
+      // drop the page; a readPage of it will try again and report the error
+      unmapFrame(part, frameNo);
+      desc.Clear();
+      part.policy->removed(frameNo);
+      part.stats.prefetchunused++;
+    }
+    part.ioDone.notify_all();
+  }
+}
 
-  // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+void BufMgr::stopPrefetchers()
+{
+  {
+    std::lock_guard<std::mutex> guard(prefetchLatch);
+    prefetchStop = true;
+  }
+  prefetchWake.notify_all();
 
-  // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+  for (std::size_t i = 0; i < prefetchers.size(); i++)
+    prefetchers[i].join();
+  prefetchers.clear();
 }
 
-void BufMgr::printSelf(void) 
+void BufMgr::unPinPage(File* file, const PageId pageNo, 
+			     const bool dirty) 
 {
-  BufDesc* tmpbuf;
-	int validFrames = 0;
-  
-  for (std::uint32_t i = 0; i < numBufs; i++)
-	{
-  	tmpbuf = &(bufDescTable[i]);
-		std::cout << "FrameNo:" << i << " ";
-		tmpbuf->Print();
+  if (file->mappedPage(pageNo) != NULL)
+  {
+    // nothing was pinned, and the page cannot have been written
+    if (dirty)
+      throw InvalidPageException(pageNo, file->filename());
+    return;
+  }
+
+  BufPartition& part = partitionOf(file, pageNo);
+  std::lock_guard<std::mutex> guard(part.latch);
 
-  	if (tmpbuf->valid == true)
-    	validFrames++;
+  // lookup in hashtable
+  FrameId frameNo = 0;
+  if (!part.hashTable->find(file, pageNo, frameNo))
+  {
+    throw HashNotFoundException(file->filename(), pageNo);
   }
 
-	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
+  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+
+  // make sure the page is actually pinned
+  if (bufDescTable[frameNo].pinCnt == 0)
+  {
+  	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+  }
+  else bufDescTable[frameNo].pinCnt--;
+
+  // resize, or a thread short of frames, may be waiting for the frame to be unpinned
+  if (bufDescTable[frameNo].pinCnt == 0 && (bufDescTable[frameNo].ioInProgress || part.frameWaiters > 0))
+    part.ioDone.notify_all();
+}
+
+void BufMgr::unPinFrame(const FrameId frameNo, const bool dirty)
+{
+  BufPartition& part = partitionOfFrame(frameNo);
+  std::lock_guard<std::mutex> guard(part.latch);
+  BufDesc& desc = bufDescTable[frameNo];
+
+  if (dirty == true) desc.dirty = dirty;
+
+  // make sure the page is actually pinned
+  if (desc.pinCnt == 0)
+  {
+  	throw PageNotPinnedException(desc.valid ? desc.file->filename() : std::string(), desc.pageNo, frameNo);
+  }
+  else desc.pinCnt--;
+
+  // resize, or a thread short of frames, may be waiting for the frame to be unpinned
+  if (desc.pinCnt == 0 && (desc.ioInProgress || part.frameWaiters > 0))
+    part.ioDone.notify_all();
+}
+
+void PageHandle::release()
+{
+  if (bufMgr == NULL)
+    return;
+
+  BufMgr* owner = bufMgr;
+  bufMgr = NULL;
+  page_ = NULL;
+  owner->unPinFrame(frameNo, dirty);
+}
+
+void BufMgr::flushFile(const File* file) 
+{
+  std::vector<std::pair<PageId, FrameId> > frames;
+
+  // claim the file's frames, partition by partition, as for a write-back so
+  // that nobody can pin or evict them until they are dropped
+  try
+  {
+    for (std::uint32_t p = 0; p < numPartitions; p++)
+    {
+      BufPartition& part = partitions[p];
+      std::unique_lock<std::mutex> lock(part.latch);
+      std::unordered_map<const File*, std::vector<FrameId> >::iterator it;
+
+      // let any read or write-back of one of the file's pages finish first
+      bool busy = true;
+      while (busy)
+      {
+        busy = false;
+        it = part.fileFrames.find(file);
+        for (std::size_t i = 0; it != part.fileFrames.end() && i < it->second.size() && !busy; i++)
+          busy = bufDescTable[it->second[i]].ioInProgress;
+        if (busy)
+          part.ioDone.wait(lock);
+      }
+      if (part.victimCache != NULL)
+        part.victimCache->removeFile(file);
+      if (p == 0 && ssdCache != NULL)
+        ssdCache->invalidateFile(file->filename());
+      if (it == part.fileFrames.end())
+        continue;
+
+      for (std::size_t i = 0; i < it->second.size(); i++)
+      {
+        BufDesc* tmpbuf = &(bufDescTable[it->second[i]]);
+        if (tmpbuf->valid == false)
+          throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+  	    if (tmpbuf->pinCnt > 0)
+    			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+      }
+
+      for (std::size_t i = 0; i < it->second.size(); i++)
+      {
+        bufDescTable[it->second[i]].ioInProgress = true;
+        frames.push_back(std::make_pair(bufDescTable[it->second[i]].pageNo, it->second[i]));
+      }
+    }
+  }
+  catch (...)
+  {
+    finishFlush(frames, 0);
+    throw;
+  }
+
+  // write the dirty pages in page order, adjacent ones together
+  std::sort(frames.begin(), frames.end());
+  std::vector<FrameId> order(frames.size());
+  for (std::size_t i = 0; i < frames.size(); i++)
+    order[i] = frames[i].second;
+  for (std::size_t i = 0; i < order.size(); )
+  {
+    if (bufDescTable[order[i]].dirty == false)
+    {
+      i++;
+      continue;
+    }
+    try
+    {
+      i += writeRun(order, i);
+    }
+    catch (...)
+    {
+      finishFlush(frames, i);
+      throw;
+    }
+  }
+
+  finishFlush(frames, frames.size());
+}
+
+void BufMgr::finishFlush(const std::vector<std::pair<PageId, FrameId> >& frames, const std::size_t upTo)
+{
+  for (std::size_t i = 0; i < frames.size(); i++)
+  {
+    const FrameId frameNo = frames[i].second;
+    BufPartition& part = partitionOfFrame(frameNo);
+    std::lock_guard<std::mutex> guard(part.latch);
+    BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+
+    if (i < upTo)
+    {
+      if (tmpbuf->dirty)
+      {
+        part.stats.diskwrites++;
+        fileStatsOf(part, tmpbuf->file).diskwrites++;
+      }
+      if (tmpbuf->prefetched)
+        part.stats.prefetchunused++;
+      unmapFrame(part, frameNo);
+      tmpbuf->Clear();
+      part.policy->removed(frameNo);
+    }
+    else
+      tmpbuf->ioInProgress = false;
+    part.ioDone.notify_all();
+  }
+}
+
+std::size_t BufMgr::writeRun(const std::vector<FrameId>& frames, const std::size_t first)
+{
+  const BufDesc* head = &(bufDescTable[frames[first]]);
+  std::size_t count = 1;
+  while (first + count < frames.size() && count < MAX_WRITE_RUN)
+  {
+    const BufDesc* next = &(bufDescTable[frames[first + count]]);
+    if (next->dirty == false || next->file != head->file || next->pageNo != head->pageNo + count)
+      break;
+    count++;
+  }
+
+  if (ssdCache != NULL)
+  {
+    for (std::size_t i = 0; i < count; i++)
+      ssdCache->invalidate(head->file->filename(), head->pageNo + (PageId) i);
+  }
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  if (count == 1)
+    writeFrame(head->file, head->pageNo, head->frameNo);
+  else
+  {
+    const std::uint32_t span = head->file->pageSpan();
+    std::vector<const Page*> pages(count * span);
+    for (std::size_t i = 0; i < pages.size(); i++)
+      pages[i] = bufDescTable[frames[first + i / span]].page + i % span;
+    head->file->writePages(head->pageNo, pages);
+  }
+  const std::uint64_t nanos = nanosSince(start);
+
+  BufPartition& part = partitionOfFrame(head->frameNo);
+  std::lock_guard<std::mutex> guard(part.latch);
+  part.stats.writeLatency.record(nanos);
+  if (count > 1)
+  {
+    part.stats.coalescedwrites += count - 1;
+    part.stats.coalescedbytes += count * head->file->pageSize();
+  }
+  return count;
+}
+
+void BufMgr::mapFrame(BufPartition& part, const FrameId frameNo)
+{
+  BufDesc& desc = bufDescTable[frameNo];
+  part.hashTable->insert(desc.file, desc.pageNo, frameNo);
+
+  std::vector<FrameId>& frames = part.fileFrames[desc.file];
+  desc.fileSlot = (std::uint32_t) frames.size();
+  frames.push_back(frameNo);
+
+  // a page is cached in the pool or in the victim cache, never in both
+  if (part.victimCache != NULL)
+    part.victimCache->remove(desc.file, desc.pageNo);
+}
+
+void BufMgr::unmapFrame(BufPartition& part, const FrameId frameNo)
+{
+  BufDesc& desc = bufDescTable[frameNo];
+  part.hashTable->remove(desc.file, desc.pageNo);
+
+  // move the file's last frame into the vacated slot
+  std::unordered_map<const File*, std::vector<FrameId> >::iterator it = part.fileFrames.find(desc.file);
+  std::vector<FrameId>& frames = it->second;
+  frames[desc.fileSlot] = frames.back();
+  bufDescTable[frames.back()].fileSlot = desc.fileSlot;
+  frames.pop_back();
+  if (frames.empty())
+    part.fileFrames.erase(it);
+}
+
+void BufMgr::stashVictim(BufPartition& part, const std::pair<const File*, PageId>& victim,
+                         const std::vector<char>& compressed, const bool fits)
+{
+  if (part.victimCache == NULL)
+    return;
+
+  std::uint32_t dropped = 0;
+  if (!fits)
+  {
+    part.victimCache->remove(victim.first, victim.second);
+    part.stats.victimrejects++;
+  }
+  else if (part.victimCache->insert(victim.first, victim.second, compressed, dropped))
+  {
+    part.stats.victimstores++;
+    part.stats.victimdrops += dropped;
+    part.stats.victimbytesin += Page::SIZE;
+    part.stats.victimbytesout += compressed.size();
+  }
+}
+
+FileBufStats& BufMgr::fileStatsOf(BufPartition& part, const File* file)
+{
+  if (part.lastFileStats == NULL || part.lastFileStats->filename != file->filename())
+  {
+    std::unordered_map<std::string, FileBufStats>::iterator it = part.fileStats.find(file->filename());
+    if (it == part.fileStats.end())
+    {
+      it = part.fileStats.insert(std::make_pair(file->filename(), FileBufStats())).first;
+      it->second.filename = file->filename();
+    }
+    part.lastFileStats = &it->second;
+  }
+  return *part.lastFileStats;
+}
+
+void BufMgr::disposePage(File* file, const PageId pageNo) 
+{
+  BufPartition& part = partitionOf(file, pageNo);
+  {
+    std::unique_lock<std::mutex> lock(part.latch);
+
+  	//Deallocate from file altogether
+    //See if it is in the buffer pool
+    FrameId frameNo = 0;
+    while (part.hashTable->find(file, pageNo, frameNo))
+    {
+      if (bufDescTable[frameNo].ioInProgress)
+      {
+        part.ioDone.wait(lock);
+        continue;
+      }
+
+    	// clear the page
+    	unmapFrame(part, frameNo);
+    	bufDescTable[frameNo].Clear();
+      part.policy->removed(frameNo);
+      if (part.frameWaiters > 0)
+        part.ioDone.notify_all();
+      break;
+    }
+    if (part.victimCache != NULL)
+      part.victimCache->remove(file, pageNo);
+  }
+  if (ssdCache != NULL)
+    ssdCache->invalidate(file->filename(), pageNo);
+
+  // deallocate it in the file	
+  file->deletePage(pageNo);
+}
+
+
+void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+{
+  page = bufDescTable[allocFrame(file, pageNo)].page;
+}
+
+PageHandle BufMgr::allocPage(File* file, PageId &pageNo)
+{
+  const FrameId frameNo = allocFrame(file, pageNo);
+  return PageHandle(this, file, pageNo, frameNo, bufDescTable[frameNo].page);
+}
+
+FrameId BufMgr::allocFrame(File* file, PageId &pageNo)
+{
+  // allocate a new page in the file; its number decides the partition
+  Page newPage = file->allocatePage(pageNo);
+  tracePage(file, pageNo);
+  if (ssdCache != NULL)
+    ssdCache->invalidate(file->filename(), pageNo);
+
+  BufPartition& part = partitionOf(file, pageNo);
+  std::unique_lock<std::mutex> lock(part.latch);
+  FrameId frameNo;
+
+  // alloc a new frame.  Nobody else can have the brand new page cached, so
+  // there is nothing to re-validate if the latch had to be released.
+  while (!allocBuf(part, lock, frameNo))
+  {
+  }
+
+  Page* page = bufDescTable[frameNo].page;
+  page[0] = newPage;
+  for (std::uint32_t unit = 1; unit < file->pageSpan(); unit++)
+    page[unit] = Page();
+
+  // set up the entry properly
+  bufDescTable[frameNo].Set(file, pageNo);
+
+  // insert in the hash table
+  mapFrame(part, frameNo);
+  part.policy->loaded(frameNo);
+  return frameNo;
+}
+
+void BufMgr::startBgWriter(const BgWriterConfig& config)
+{
+  stopBgWriter();
+
+  bgWriterConfig = config;
+  bgWriterStop = false;
+  bgWriter = std::thread(&BufMgr::bgWriterLoop, this);
+}
+
+void BufMgr::stopBgWriter()
+{
+  if (!bgWriter.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> guard(bgWriterLatch);
+    bgWriterStop = true;
+  }
+  bgWriterWake.notify_all();
+  bgWriter.join();
+}
+
+void BufMgr::bgWriterLoop()
+{
+  std::unique_lock<std::mutex> lock(bgWriterLatch);
+  std::uint32_t firstPartition = 0;
+
+  while (!bgWriterStop)
+  {
+    lock.unlock();
+
+    // share the round's budget out over the partitions; whatever one of them
+    // leaves unused goes to the ones after it
+    std::uint32_t budget = bgWriterConfig.maxPagesPerRound;
+    for (std::uint32_t i = 0; i < numPartitions && budget > 0; i++)
+    {
+      const std::uint32_t share = std::max<std::uint32_t>(1, budget / (numPartitions - i));
+      budget -= cleanPartition(partitions[(firstPartition + i) % numPartitions], share);
+    }
+    firstPartition = (firstPartition + 1) % numPartitions;
+
+    lock.lock();
+    bgWriterWake.wait_for(lock, std::chrono::milliseconds(bgWriterConfig.intervalMs));
+  }
+}
+
+std::uint32_t BufMgr::cleanPartition(BufPartition& part, const std::uint32_t budget)
+{
+  std::vector<FrameId> frames;
+  std::vector<FrameId> candidates;
+  std::unique_lock<std::mutex> lock(part.latch);
+
+  std::uint32_t numDirty = 0;
+  for (FrameId i = part.firstFrame; i < part.firstFrame + part.numFrames; i++)
+  {
+    if (bufDescTable[i].valid && bufDescTable[i].dirty)
+      numDirty++;
+  }
+  const std::uint32_t maxDirty = (std::uint32_t) (bgWriterConfig.dirtyRatio * part.numFrames);
+
+  // the frames the policy will hand out next, whatever the dirty ratio, then
+  // any others while the partition is above its dirty ratio
+  const std::uint32_t lookahead = std::max(bgWriterConfig.lookahead,
+                                           (std::uint32_t) (bgWriterConfig.lookaheadFactor * part.recentAllocs));
+  part.recentAllocs = 0;
+  part.policy->upcomingVictims(candidates, lookahead);
+  const std::size_t numUpcoming = candidates.size();
+  for (FrameId i = part.firstFrame; i < part.firstFrame + part.numFrames; i++)
+    candidates.push_back(i);
+
+  // claim the frames as for an eviction write-back, so that nobody uses or
+  // evicts them until they are on disk
+  for (std::size_t c = 0; c < candidates.size() && frames.size() < budget; c++)
+  {
+    if (c >= numUpcoming && numDirty - frames.size() <= maxDirty)
+      break;
+
+    BufDesc& desc = bufDescTable[candidates[c]];
+    if (desc.valid && desc.dirty && desc.pinCnt == 0 && !desc.ioInProgress)
+    {
+      desc.dirty = false;
+      desc.ioInProgress = true;
+      frames.push_back(candidates[c]);
+    }
+  }
+  if (frames.empty())
+    return 0;
+
+  lock.unlock();
+
+  std::vector<bool> written(frames.size(), false);
+  std::vector<std::uint64_t> nanos(frames.size(), 0);
+  for (std::size_t f = 0; f < frames.size(); f++)
+  {
+    BufDesc& desc = bufDescTable[frames[f]];
+    if (ssdCache != NULL)
+      ssdCache->invalidate(desc.file->filename(), desc.pageNo);
+    try
+    {
+      const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      writeFrame(desc.file, desc.pageNo, frames[f]);
+      nanos[f] = nanosSince(start);
+      written[f] = true;
+    }
+    catch (...)
+    {
+      // leave the page dirty; the eviction or flush that writes it next reports the error
+    }
+  }
+
+  lock.lock();
+  for (std::size_t f = 0; f < frames.size(); f++)
+  {
+    BufDesc& desc = bufDescTable[frames[f]];
+    desc.ioInProgress = false;
+    if (written[f])
+    {
+      part.stats.writeLatency.record(nanos[f]);
+      part.stats.diskwrites++;
+      part.stats.bgwrites++;
+      fileStatsOf(part, desc.file).diskwrites++;
+    }
+    else
+      desc.dirty = true;
+  }
+  part.ioDone.notify_all();
+
+  return (std::uint32_t) frames.size();
+}
+
+void BufMgr::saveHotSet(std::ostream& out)
+{
+  // (heat, (file, page)) and reference bit of every resident page
+  std::vector<std::pair<std::pair<double, std::pair<std::string, PageId> >, bool> > pages;
+
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    BufPartition& part = partitions[p];
+    std::lock_guard<std::mutex> guard(part.latch);
+
+    // pinned and busy frames are the hottest; the policy ranks the rest
+    std::vector<FrameId> order;
+    std::vector<FrameId> victims;
+    part.policy->upcomingVictims(victims, part.numFrames);
+    std::vector<bool> ranked(part.numFrames, false);
+    for (std::size_t v = 0; v < victims.size(); v++)
+      ranked[victims[v] - part.firstFrame] = true;
+    for (FrameId i = part.firstFrame; i < part.firstFrame + part.numFrames; i++)
+    {
+      if (bufDescTable[i].valid && !ranked[i - part.firstFrame])
+        order.push_back(i);
+    }
+    order.insert(order.end(), victims.rbegin(), victims.rend());
+
+    for (std::size_t k = 0; k < order.size(); k++)
+    {
+      const BufDesc& desc = bufDescTable[order[k]];
+      const double heat = 1.0 - (double) k / order.size();
+      pages.push_back(std::make_pair(std::make_pair(heat, std::make_pair(desc.file->filename(), desc.pageNo)),
+                                     desc.refbit));
+    }
+  }
+
+  // interleave the partitions by rank
+  std::stable_sort(pages.begin(), pages.end(),
+                   [](const std::pair<std::pair<double, std::pair<std::string, PageId> >, bool>& a,
+                      const std::pair<std::pair<double, std::pair<std::string, PageId> >, bool>& b)
+                   { return a.first.first > b.first.first; });
+
+  for (std::size_t i = 0; i < pages.size(); i++)
+    out << pages[i].first.second.first << " " << pages[i].first.second.second << " " << pages[i].second << "\n";
+  out.flush();
+}
+
+std::uint32_t BufMgr::loadHotSet(std::istream& in, const std::vector<File*>& files)
+{
+  std::unordered_map<std::string, File*> byName;
+  for (std::size_t f = 0; f < files.size(); f++)
+    byName[files[f]->filename()] = files[f];
+
+  std::vector<std::uint32_t> room(numPartitions);
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    std::lock_guard<std::mutex> guard(partitions[p].latch);
+    room[p] = partitions[p].numFrames;
+  }
+
+  // the pages to load, hottest first; the file name may contain spaces, so
+  // the line is split from the right
+  std::vector<std::pair<std::pair<File*, PageId>, bool> > entries;
+  std::string line;
+  while (std::getline(in, line))
+  {
+    const std::size_t refPos = line.rfind(' ');
+    if (refPos == std::string::npos || refPos == 0)
+      continue;
+    const std::size_t pagePos = line.rfind(' ', refPos - 1);
+    if (pagePos == std::string::npos)
+      continue;
+
+    std::unordered_map<std::string, File*>::const_iterator it = byName.find(line.substr(0, pagePos));
+    if (it == byName.end())
+      continue;
+    const PageId pageNo = (PageId) std::strtoul(line.c_str() + pagePos + 1, NULL, 10);
+    const bool refbit = line[refPos + 1] == '1';
+
+    std::uint32_t& left = room[&partitionOf(it->second, pageNo) - &partitions[0]];
+    if (left == 0)
+      continue;
+    left--;
+    entries.push_back(std::make_pair(std::make_pair(it->second, pageNo), refbit));
+  }
+
+  // claim coldest first, so that the hottest pages are the last the policies saw
+  std::vector<std::pair<std::pair<File*, PageId>, FrameId> > claimed;
+  for (std::size_t e = entries.size(); e-- > 0; )
+  {
+    File* file = entries[e].first.first;
+    const PageId pageNo = entries[e].first.second;
+    BufPartition& part = partitionOf(file, pageNo);
+    std::unique_lock<std::mutex> lock(part.latch);
+    FrameId frameNo = 0;
+
+    try
+    {
+      if (!claimForReadAhead(part, lock, file, pageNo, NULL, frameNo))
+        continue;
+    }
+    catch (const BufferExceededException&)
+    {
+      continue;
+    }
+    bufDescTable[frameNo].refbit = entries[e].second;
+    claimed.push_back(std::make_pair(std::make_pair(file, pageNo), frameNo));
+  }
+
+  // read each file in page order, in jobs the read-ahead threads can share
+  std::sort(claimed.begin(), claimed.end());
+  PrefetchJob job;
+  job.file = NULL;
+  for (std::size_t c = 0; c < claimed.size(); c++)
+  {
+    if (claimed[c].first.first != job.file || job.pages.size() == MAX_READ_RUN)
+    {
+      queueReadAhead(job);
+      job.file = claimed[c].first.first;
+      job.pages.clear();
+    }
+    job.pages.push_back(std::make_pair(claimed[c].first.second, claimed[c].second));
+  }
+  queueReadAhead(job);
+
+  return (std::uint32_t) claimed.size();
+}
+
+void BufMgr::printSelf(void) 
+{
+  BufDesc* tmpbuf;
+	int validFrames = 0;
+  
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    BufPartition& part = partitions[p];
+    std::lock_guard<std::mutex> guard(part.latch);
+
+    for (FrameId i = part.firstFrame; i < part.firstFrame + part.numFrames; i++)
+  	{
+    	tmpbuf = &(bufDescTable[i]);
+  		std::cout << "FrameNo:" << i << " ";
+  		tmpbuf->Print();
+
+    	if (tmpbuf->valid == true)
+      	validFrames++;
+    }
+  }
+
+	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
+}
+
+BufStats BufMgr::getBufStats()
+{
+  return statsSnapshot();
+}
+
+BufStats BufMgr::statsSnapshot()
+{
+  // the counters can be read without the partition latches
+  BufStats total;
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+    total.add(partitions[p].stats);
+  return total;
+}
+
+std::vector<FileBufStats> BufMgr::fileStatsSnapshot()
+{
+  std::map<std::string, FileBufStats> byName;
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    std::lock_guard<std::mutex> guard(partitions[p].latch);
+    for (std::unordered_map<std::string, FileBufStats>::const_iterator it = partitions[p].fileStats.begin();
+         it != partitions[p].fileStats.end(); ++it)
+    {
+      FileBufStats& entry = byName[it->second.filename];
+      entry.filename = it->second.filename;
+      entry.add(it->second);
+    }
+  }
+
+  std::vector<FileBufStats> files;
+  for (std::map<std::string, FileBufStats>::const_iterator it = byName.begin(); it != byName.end(); ++it)
+    files.push_back(it->second);
+  return files;
+}
+
+/**
+ * Writes a Prometheus label value, escaped.
+ */
+static void writeLabel(std::ostream& out, const std::string& value)
+{
+  for (std::size_t i = 0; i < value.size(); i++)
+  {
+    if (value[i] == '\\' || value[i] == '"')
+      out << '\\' << value[i];
+    else if (value[i] == '\n')
+      out << "\\n";
+    else
+      out << value[i];
+  }
+}
+
+static void writeHistogram(std::ostream& out, const char* name, const char* help, const LatencyHistogram& histogram)
+{
+  out << "# HELP badgerdb_buffer_" << name << " " << help << "\n";
+  out << "# TYPE badgerdb_buffer_" << name << " histogram\n";
+  std::uint64_t cumulative = 0;
+  for (std::uint32_t i = 0; i < LatencyHistogram::NUM_BUCKETS - 1; i++)
+  {
+    cumulative += histogram.buckets[i];
+    out << "badgerdb_buffer_" << name << "_bucket{le=\"" << LatencyHistogram::bucketLimitMicros(i) / 1e6
+        << "\"} " << cumulative << "\n";
+  }
+  cumulative += histogram.buckets[LatencyHistogram::NUM_BUCKETS - 1];
+  out << "badgerdb_buffer_" << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+  out << "badgerdb_buffer_" << name << "_sum " << histogram.totalNanos / 1e9 << "\n";
+  out << "badgerdb_buffer_" << name << "_count " << cumulative << "\n";
+}
+
+void BufMgr::exportStats(std::ostream& out)
+{
+  const BufStats stats = statsSnapshot();
+  const std::vector<FileBufStats> files = fileStatsSnapshot();
+
+  out << "# HELP badgerdb_buffer_frames Frames in the buffer pool\n";
+  out << "# TYPE badgerdb_buffer_frames gauge\n";
+  out << "badgerdb_buffer_frames " << numBufs.load() << "\n";
+  out << "# HELP badgerdb_buffer_victim_cache_bytes Memory used by the compressed victim cache\n";
+  out << "# TYPE badgerdb_buffer_victim_cache_bytes gauge\n";
+  out << "badgerdb_buffer_victim_cache_bytes " << victimCacheBytes() << "\n";
+  out << "# HELP badgerdb_buffer_ssd_cache_pages Pages held by the SSD cache\n";
+  out << "# TYPE badgerdb_buffer_ssd_cache_pages gauge\n";
+  out << "badgerdb_buffer_ssd_cache_pages " << ssdCachePages() << "\n";
+
+  for (std::size_t c = 0; c < sizeof(bufStatsCounters) / sizeof(bufStatsCounters[0]); c++)
+  {
+    const char* name = bufStatsCounters[c].name;
+    out << "# HELP badgerdb_buffer_" << name << "_total " << bufStatsCounters[c].help << "\n";
+    out << "# TYPE badgerdb_buffer_" << name << "_total counter\n";
+    out << "badgerdb_buffer_" << name << "_total " << (stats.*bufStatsCounters[c].field).get() << "\n";
+  }
+
+  const struct
+  {
+    BufCounter FileBufStats::*field;
+    const char* name;
+  } fileCounters[] = {
+    {&FileBufStats::hits, "hits"},
+    {&FileBufStats::misses, "misses"},
+    {&FileBufStats::diskreads, "disk_reads"},
+    {&FileBufStats::diskwrites, "disk_writes"},
+  };
+  for (std::size_t c = 0; c < sizeof(fileCounters) / sizeof(fileCounters[0]); c++)
+  {
+    out << "# TYPE badgerdb_buffer_file_" << fileCounters[c].name << "_total counter\n";
+    for (std::size_t f = 0; f < files.size(); f++)
+    {
+      out << "badgerdb_buffer_file_" << fileCounters[c].name << "_total{file=\"";
+      writeLabel(out, files[f].filename);
+      out << "\"} " << (files[f].*fileCounters[c].field).get() << "\n";
+    }
+  }
+
+  writeHistogram(out, "read_latency_seconds", "Duration of page reads, one sample per call", stats.readLatency);
+  writeHistogram(out, "write_latency_seconds", "Duration of page writes, one sample per call", stats.writeLatency);
+  writeHistogram(out, "frame_wait_seconds", "Time spent waiting for a frame to be unpinned, one sample per wait",
+                 stats.frameWaitLatency);
+  out.flush();
+}
+
+void BufMgr::clearBufStats()
+{
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    std::lock_guard<std::mutex> guard(partitions[p].latch);
+    partitions[p].stats.clear();
+    partitions[p].fileStats.clear();
+    partitions[p].lastFileStats = NULL;
+  }
+}
+
+void BufMgr::setVictimCacheSize(const std::size_t budgetBytes)
+{
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    BufPartition& part = partitions[p];
+    std::lock_guard<std::mutex> guard(part.latch);
+    const std::size_t share = budgetBytes / numPartitions;
+
+    if (budgetBytes == 0)
+    {
+      delete part.victimCache;
+      part.victimCache = NULL;
+    }
+    else if (part.victimCache == NULL)
+      part.victimCache = new VictimCache(share);
+    else
+      part.stats.victimdrops += part.victimCache->setBudget(share);
+  }
+}
+
+std::size_t BufMgr::victimCacheBytes()
+{
+  std::size_t bytes = 0;
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+  {
+    std::lock_guard<std::mutex> guard(partitions[p].latch);
+    if (partitions[p].victimCache != NULL)
+      bytes += partitions[p].victimCache->bytesUsed();
+  }
+  return bytes;
+}
+
+void BufMgr::setSsdCache(const std::string& directory, const std::size_t bytes)
+{
+  delete ssdCache;
+  ssdCache = NULL;
+
+  const std::size_t numSlots = std::min<std::size_t>(bytes / Page::SIZE, SsdCache::NO_SLOT - 1);
+  if (numSlots > 0)
+    ssdCache = new SsdCache(directory, (std::uint32_t) numSlots);
+}
+
+std::uint32_t BufMgr::ssdCachePages()
+{
+  return ssdCache != NULL ? ssdCache->size() : 0;
+}
+
+std::uint32_t BufMgr::resize(std::uint32_t numFrames, const std::size_t pageSize)
+{
+  std::lock_guard<std::mutex> guard(resizeLatch);
+  const std::vector<std::size_t>::const_iterator size =
+    std::find(pageSizes.begin(), pageSizes.end(), Page::sizeClassOf(pageSize));
+  if (size == pageSizes.end())
+    return 0;
+  const std::uint32_t first = classFirstPartition[size - pageSizes.begin()];
+  const std::uint32_t count = classPartitions[size - pageSizes.begin()];
+  numFrames = std::max(numFrames, count);
+  numFrames = (std::uint32_t) std::min<std::uint64_t>(numFrames, (std::uint64_t) count * partitionCapacity);
+
+  // only resize changes the size of a partition, so it may read it unlatched
+  std::uint32_t total = 0;
+  for (std::uint32_t i = 0; i < count; i++)
+  {
+    BufPartition& part = partitions[first + i];
+    const std::uint32_t target = (std::uint32_t) (((std::uint64_t) numFrames * (i + 1)) / count)
+                               - (std::uint32_t) (((std::uint64_t) numFrames * i) / count);
+    if (target > part.numFrames)
+      growPartition(part, target);
+    else if (target < part.numFrames)
+      shrinkPartition(part, target);
+    total += part.numFrames;
+  }
+
+  std::uint32_t frames = 0;
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+    frames += partitions[p].numFrames;
+  numBufs = frames;
+  return total;
+}
+
+void BufMgr::growPartition(BufPartition& part, const std::uint32_t numFrames)
+{
+  // nobody looks at the frames beyond the end of a partition, so they can be
+  // set up before taking the latch
+  commitFrames(part, numFrames);
+  std::unique_ptr<BufHashTbl> hashTable(new BufHashTbl(numFrames));
+
+  std::lock_guard<std::mutex> guard(part.latch);
+  std::unordered_map<const File*, std::vector<FrameId> >::const_iterator it;
+  for (it = part.fileFrames.begin(); it != part.fileFrames.end(); ++it)
+  {
+    for (std::size_t i = 0; i < it->second.size(); i++)
+      hashTable->insert(it->first, bufDescTable[it->second[i]].pageNo, it->second[i]);
+  }
+
+  // the old table is freed once the latch is released
+  BufHashTbl* oldTable = part.hashTable;
+  part.hashTable = hashTable.release();
+  hashTable.reset(oldTable);
+
+  part.numFrames = numFrames;
+  part.policy->resized(numFrames);
+  part.ioDone.notify_all();
+}
+
+std::uint32_t BufMgr::shrinkPartition(BufPartition& part, std::uint32_t numFrames)
+{
+  const std::uint32_t oldFrames = part.numFrames;
+  const FrameId end = part.firstFrame + oldFrames;
+  std::vector<std::pair<std::pair<const File*, PageId>, FrameId> > dirtyFrames;
+  std::unique_lock<std::mutex> lock(part.latch);
+
+  // let any read or write-back in the frames to be given up finish first
+  bool busy = true;
+  while (busy)
+  {
+    busy = false;
+    for (FrameId i = part.firstFrame + numFrames; i < end && !busy; i++)
+      busy = bufDescTable[i].ioInProgress;
+    if (busy)
+      part.ioDone.wait(lock);
+  }
+
+  // claim the frames as for a write-back, so that nobody pins, loads or evicts
+  // them from now on, and give the pages pinned in them a moment to be unpinned
+  for (FrameId i = part.firstFrame + numFrames; i < end; i++)
+    bufDescTable[i].ioInProgress = true;
+  const std::chrono::steady_clock::time_point deadline =
+    std::chrono::steady_clock::now() + std::chrono::milliseconds(SHRINK_PIN_WAIT_MS);
+  FrameId lastPinned = end;
+  do
+  {
+    lastPinned = end;
+    for (FrameId i = part.firstFrame + numFrames; i < end; i++)
+    {
+      if (bufDescTable[i].valid && bufDescTable[i].pinCnt > 0)
+        lastPinned = i;
+    }
+  } while (lastPinned != end && part.ioDone.wait_until(lock, deadline) == std::cv_status::no_timeout);
+
+  // pages still pinned cannot be dropped; keep every frame up to the last of them
+  if (lastPinned != end)
+  {
+    const std::uint32_t kept = lastPinned - part.firstFrame + 1;
+    for (FrameId i = part.firstFrame + numFrames; i < part.firstFrame + kept; i++)
+      bufDescTable[i].ioInProgress = false;
+    part.ioDone.notify_all();
+    numFrames = kept;
+    if (numFrames == oldFrames)
+      return oldFrames;
+  }
+
+  for (FrameId i = part.firstFrame + numFrames; i < end; i++)
+  {
+    BufDesc* tmpbuf = &(bufDescTable[i]);
+    if (tmpbuf->valid && tmpbuf->dirty)
+      dirtyFrames.push_back(std::make_pair(std::make_pair(tmpbuf->file, tmpbuf->pageNo), i));
+  }
+  lock.unlock();
+
+  // write the dirty pages in page order, adjacent ones together
+  std::sort(dirtyFrames.begin(), dirtyFrames.end());
+  std::vector<FrameId> order(dirtyFrames.size());
+  for (std::size_t i = 0; i < dirtyFrames.size(); i++)
+    order[i] = dirtyFrames[i].second;
+  try
+  {
+    for (std::size_t i = 0; i < order.size(); )
+      i += writeRun(order, i);
+  }
+  catch (...)
+  {
+    lock.lock();
+    for (FrameId i = part.firstFrame + numFrames; i < end; i++)
+      bufDescTable[i].ioInProgress = false;
+    part.ioDone.notify_all();
+    throw;
+  }
+
+  lock.lock();
+  for (FrameId i = part.firstFrame + numFrames; i < end; i++)
+  {
+    BufDesc* tmpbuf = &(bufDescTable[i]);
+    if (tmpbuf->valid)
+    {
+      if (tmpbuf->dirty)
+      {
+        part.stats.diskwrites++;
+        fileStatsOf(part, tmpbuf->file).diskwrites++;
+      }
+      if (tmpbuf->prefetched)
+        part.stats.prefetchunused++;
+      unmapFrame(part, i);
+    }
+    tmpbuf->Clear();
+    part.policy->removed(i);
+  }
+  part.numFrames = numFrames;
+  part.policy->resized(numFrames);
+  part.ioDone.notify_all();
+  lock.unlock();
+
+  releaseFrames(part, oldFrames);
+  return numFrames;
 }
 
 }
@@ -9,7 +9,18 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "victimCache.h"
+#include "ssdCache.h"
+#include "numaTopology.h"
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace badgerdb {
 
@@ -17,13 +28,24 @@ namespace badgerdb {
 * forward declaration of BufMgr class 
 */
 class BufMgr;
+class BufPartition;
+class ReplacementPolicy;
 
 /**
 * @brief Class for maintaining information about buffer pool frames
+*
+* A frame has no latch of its own.  Its fields are guarded by the latch of its
+* partition (see BufPartition), which is held only while they are read or
+* changed and never across disk I/O; while its page is read or written,
+* ioInProgress stands in for a frame latch.  A mutex per frame would add a
+* second lock to every pin without allowing more concurrency, since a pin also
+* looks the page up in the partition's page table and updates its replacement
+* state under the partition latch.
 */
 class BufDesc {
 
 	friend class BufMgr;
+	friend class ReplacementPolicy;
 
  private:
 	/**
@@ -61,6 +83,30 @@ class BufDesc {
 	 */
   bool refbit;
 
+	/**
+   * True while the page in this frame is being read from or written to disk
+   * with the partition latch released.  Other threads must neither use nor
+   * evict the frame until the flag clears; they wait on the ioDone condition
+   * of the frame's partition and then look the page up again.
+	 */
+  bool ioInProgress;
+
+	/**
+   * True if the page was read by BufMgr::prefetch and nobody has asked for it yet
+	 */
+  bool prefetched;
+
+	/**
+   * Position of the frame in its partition's list of frames of the file
+	 */
+  std::uint32_t fileSlot;
+
+	/**
+   * First of the Page::SIZE units the frame spans in bufPool.  Set when the
+   * frame is committed and never moved.
+	 */
+  Page* page;
+
 	/**
    * Initialize buffer frame for a new user
 	 */
@@ -72,6 +118,8 @@ class BufDesc {
     dirty = false;
     refbit = false;
 		valid = false;
+    ioInProgress = false;
+    prefetched = false;
   };
 
 	/**
@@ -89,6 +137,7 @@ class BufDesc {
     dirty = false;
     valid = true;
     refbit = true;
+    prefetched = false;
   }
 
   void Print()
@@ -117,32 +166,265 @@ class BufDesc {
 };
 
 
+/**
+* @brief 64-bit event counter which can be read while it is being updated
+*
+* A counter has one writer at a time, e.g. whoever holds the latch of its
+* partition, so an increment is a relaxed load and store rather than an atomic
+* add, as cheap as on a plain integer.  Readers need no latch and never see a
+* torn value.  Copying a counter reads its current value, so structures made of
+* counters can be copied as snapshots.
+*/
+class BufCounter
+{
+ public:
+  BufCounter() : value(0) {}
+
+  BufCounter(const BufCounter& other) : value(other.get()) {}
+
+  BufCounter& operator=(const BufCounter& other)
+  {
+    value.store(other.get(), std::memory_order_relaxed);
+    return *this;
+  }
+
+  BufCounter& operator=(const std::uint64_t newValue)
+  {
+    value.store(newValue, std::memory_order_relaxed);
+    return *this;
+  }
+
+  void operator++(int) { value.store(get() + 1, std::memory_order_relaxed); }
+
+  void operator+=(const std::uint64_t amount) { value.store(get() + amount, std::memory_order_relaxed); }
+
+  std::uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+  operator std::uint64_t() const { return get(); }
+
+ private:
+  std::atomic<std::uint64_t> value;
+};
+
+
+/**
+* @brief Histogram of I/O latencies in power-of-two microsecond buckets
+*
+* Bucket 0 counts calls that took less than a microsecond, bucket i > 0 those
+* that took from 2^(i-1) up to 2^i microseconds; the last bucket takes everything
+* longer.  One sample is recorded per read or write call, whatever its size.
+*/
+struct LatencyHistogram
+{
+  static const std::uint32_t NUM_BUCKETS = 32;
+
+	/**
+   * Number of calls per bucket
+	 */
+  BufCounter buckets[NUM_BUCKETS];
+
+	/**
+   * Number of calls and their total duration in nanoseconds
+	 */
+  BufCounter count;
+  BufCounter totalNanos;
+
+	/**
+	 * Records one call.
+	 *
+	 * @param nanos   	Duration of the call in nanoseconds
+	 */
+  void record(const std::uint64_t nanos);
+
+	/**
+	 * Adds the samples of another histogram to this one.
+	 */
+  void add(const LatencyHistogram& other);
+
+	/**
+	 * Upper bound in microseconds of the bucket holding the given fraction of the
+	 * samples, e.g. 0.99 for the 99th percentile; 0 if there are none.
+	 */
+  std::uint64_t percentileMicros(const double fraction) const;
+
+	/**
+	 * Upper bound in microseconds of bucket i
+	 */
+  static std::uint64_t bucketLimitMicros(const std::uint32_t i) { return (std::uint64_t) 1 << i; }
+
+  void clear()
+  {
+    for (std::uint32_t i = 0; i < NUM_BUCKETS; i++)
+      buckets[i] = 0;
+    count = 0;
+    totalNanos = 0;
+  }
+};
+
+
 /**
 * @brief Class to maintain statistics of buffer usage 
 */
 struct BufStats
 {
 	/**
-   * Total number of accesses to buffer pool
+   * Number of readPage requests: hits plus misses
+	 */
+  BufCounter accesses;
+
+	/**
+   * Number of readPage requests served from the pool, and of those that had to read the page
 	 */
-  int accesses;
+  BufCounter hits;
+  BufCounter misses;
 
 	/**
    * Number of pages read from disk (including allocs)
 	 */
-  int diskreads;
+  BufCounter diskreads;
 
 	/**
    * Number of pages written back to disk
 	 */
-  int diskwrites;
+  BufCounter diskwrites;
+
+	/**
+   * Number of valid pages dropped from the pool to make room for another one
+	 */
+  BufCounter evictions;
+
+	/**
+   * Number of those writes made by allocBuf because the victim it chose was dirty
+	 */
+  BufCounter dirtyevictions;
+
+	/**
+   * Number of those writes made by the background writer
+	 */
+  BufCounter bgwrites;
+
+	/**
+   * Number of times a thread blocked until another thread finished reading or
+   * writing a frame, because it wanted that page or every other frame was taken
+	 */
+  BufCounter pinwaits;
+
+	/**
+   * Number of times the replacement policy was asked for a victim, and the
+   * number of frames it looked at doing so
+	 */
+  BufCounter sweeps;
+  BufCounter sweepsteps;
+
+	/**
+   * Number of pages read ahead by prefetch (also counted in diskreads)
+	 */
+  BufCounter prefetches;
+
+	/**
+   * Number of prefetched pages later requested through readPage: read-ahead hits
+	 */
+  BufCounter prefetchhits;
+
+	/**
+   * Number of those hits which had to wait for the read-ahead to complete
+	 */
+  BufCounter prefetchwaits;
+
+	/**
+   * Number of prefetched pages dropped from the pool before anybody asked for them
+	 */
+  BufCounter prefetchunused;
+
+	/**
+   * Number of misses served by decompressing the page from the victim cache
+	 */
+  BufCounter victimhits;
+
+	/**
+   * Number of clean pages stored in the victim cache when evicted, and of those
+   * not stored because they did not compress well enough
+	 */
+  BufCounter victimstores;
+  BufCounter victimrejects;
+
+	/**
+   * Number of compressed pages dropped from the victim cache to keep it within budget
+	 */
+  BufCounter victimdrops;
+
+	/**
+   * Bytes of the pages stored in the victim cache before and after compression
+	 */
+  BufCounter victimbytesin;
+  BufCounter victimbytesout;
+
+	/**
+   * Number of misses served by reading the page from the SSD cache
+	 */
+  BufCounter ssdhits;
+
+	/**
+   * Number of clean pages written to the SSD cache when evicted
+	 */
+  BufCounter ssdstores;
+
+	/**
+   * Number of readPage requests made from a thread on the node holding the
+   * page's partition, and from other nodes; only counted on NUMA machines
+	 */
+  BufCounter localaccesses;
+  BufCounter remoteaccesses;
+
+	/**
+   * Number of times a frame was waited for because every frame was pinned, and
+   * of those waits that timed out with a BufferExceededException
+	 */
+  BufCounter framewaits;
+  BufCounter framewaittimeouts;
+
+	/**
+   * Number of write calls saved by writing runs of adjacent dirty pages with one call
+	 */
+  BufCounter coalescedwrites;
+
+	/**
+   * Number of bytes written back in runs of more than one page
+	 */
+  BufCounter coalescedbytes;
+
+	/**
+   * Latency of the file reads and writes made by the buffer manager
+	 */
+  LatencyHistogram readLatency;
+  LatencyHistogram writeLatency;
+
+	/**
+   * Time spent waiting for a frame to be unpinned, one sample per wait
+	 */
+  LatencyHistogram frameWaitLatency;
+
+	/**
+   * Adds the values of another set of statistics to these.
+	 */
+  void add(const BufStats& other);
 
 	/**
    * Clear all values 
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses = hits = misses = diskreads = diskwrites = 0;
+		evictions = dirtyevictions = bgwrites = pinwaits = sweeps = sweepsteps = 0;
+		prefetches = prefetchhits = prefetchwaits = prefetchunused = 0;
+		victimhits = victimstores = victimrejects = victimdrops = victimbytesin = victimbytesout = 0;
+		ssdhits = ssdstores = 0;
+		localaccesses = remoteaccesses = 0;
+		framewaits = framewaittimeouts = 0;
+		coalescedwrites = coalescedbytes = 0;
+		readLatency.clear();
+		writeLatency.clear();
+		frameWaitLatency.clear();
   }
       
 	/**
@@ -156,139 +438,1465 @@ struct BufStats
 
 
 /**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+* @brief Buffer pool usage of the pages of one file
 */
-class BufMgr 
+struct FileBufStats
 {
- private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Name of the file
 	 */
-  FrameId clockHand;
+  std::string filename;
 
 	/**
-   * Number of frames in the buffer pool
+   * readPage requests for the file's pages served from the pool, and those that read the page
 	 */
-  std::uint32_t numBufs;
-	
+  BufCounter hits;
+  BufCounter misses;
+
 	/**
-   * Hash table mapping (File, page) to frame
+   * Number of the file's pages read from and written back to disk
 	 */
-  BufHashTbl *hashTable;
+  BufCounter diskreads;
+  BufCounter diskwrites;
+
+  void add(const FileBufStats& other)
+  {
+    hits += other.hits;
+    misses += other.misses;
+    diskreads += other.diskreads;
+    diskwrites += other.diskwrites;
+  }
+};
+
+
+/**
+* @brief Page replacement policies a BufMgr can be constructed with
+*/
+enum ReplacementPolicyType
+{
+  CLOCK_POLICY = 0,   /* two-sweep CLOCK with one reference bit per frame */
+  LRUK_POLICY = 1,    /* LRU-2: evict the frame whose second most recent reference is oldest */
+  ARC_POLICY = 2      /* Adaptive Replacement Cache, balancing recency against frequency */
+};
+
+
+/**
+* @brief How a BufMgr spreads pages over the NUMA nodes of the machine
+*/
+enum NumaPlacement
+{
+  NUMA_INTERLEAVE = 0,    /* every page hashes to any partition, whichever its node */
+  NUMA_FILE_AFFINE = 1    /* the pages of a file hash to the partitions of one node */
+};
+
+
+/**
+* @brief Frames of one page size a BufMgr is built with
+*
+* Files are cached in the frames of the smallest class whose page size is at
+* least their own.  Page sizes are rounded up as File rounds them, to a power
+* of two multiple of Page::SIZE.  BufMgr::resize can grow a class to maxFrames
+* frames, or to BufMgr::POOL_GROWTH_FACTOR times its initial size if that is
+* more.
+*/
+struct PageSizeClass
+{
+  std::size_t pageSize;
+  std::uint32_t numFrames;
+  std::uint32_t maxFrames;
+
+  PageSizeClass(std::size_t size, std::uint32_t frames, std::uint32_t maxFramesIn = 0)
+    : pageSize(size), numFrames(frames), maxFrames(maxFramesIn) {}
+};
 
+
+/**
+* @brief One entry of a page reference trace, as replayed by ReplacementPolicy::simulate()
+*/
+struct PageRef
+{
 	/**
-   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+   * Small integer naming the file the page belongs to
 	 */
-  BufDesc *bufDescTable;
+  std::uint32_t fileId;
 
 	/**
-   * Maintains Buffer pool usage statistics 
+   * Page number within the file
 	 */
-  BufStats bufStats;
+  PageId pageNo;
+};
 
+
+/**
+* @brief Interface of the page replacement policy of one buffer pool partition
+*
+* A policy manages the frames [firstFrame, firstFrame + numFrames) and decides
+* which of them allocBuf reuses next.  BufMgr reports every hit, load, eviction and
+* removal of a page to it, always with the partition latch held, and the policy
+* reads the frames' BufDesc entries through the protected helpers below.
+*/
+class ReplacementPolicy
+{
+ public:
 	/**
-	 * Allocate a free frame.  
+	 * Creates a policy of the given type for a range of frames.
 	 *
-	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 * @param type   		Replacement policy to create
+	 * @param descs   	BufDesc table of the whole buffer pool
+	 * @param firstFrame First frame managed by the policy
+	 * @param numFrames Number of frames managed by the policy
+	 * @return  				The new policy, owned by the caller.
 	 */
-  void allocBuf(FrameId & frame);
+  static ReplacementPolicy* create(const ReplacementPolicyType type, BufDesc* descs,
+                                   const FrameId firstFrame, const std::uint32_t numFrames);
 
 	/**
-   * Advance clock to next frame in the buffer pool
+	 * Replays a page reference trace against a pool of numFrames frames managed by
+	 * the given policy, with every page unpinned straight after its reference.
+	 *
+	 * @param type   		Replacement policy to simulate
+	 * @param numFrames Number of frames in the simulated pool
+	 * @param trace   	Page references in the order they were made
+	 * @return  				Number of references which hit the simulated pool.
 	 */
-  void advanceClock()
-  {
-		clockHand = (clockHand + 1) % numBufs;
-  }
+  static std::uint64_t simulate(const ReplacementPolicyType type, const std::uint32_t numFrames,
+                                const std::vector<PageRef>& trace);
 
+  virtual ~ReplacementPolicy() {}
 
- public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Returns the name of the policy, for reports.
 	 */
-  Page* bufPool;
+  virtual const char* name() const = 0;
 
 	/**
-   * Constructor of BufMgr class
+   * Called after a frame has been assigned to the page now described by its BufDesc.
 	 */
-  BufMgr(std::uint32_t bufs);
-	
+  virtual void loaded(const FrameId frame) = 0;
+
 	/**
-   * Destructor of BufMgr class
+   * Called when a page is found in the frame (buffer hit).
 	 */
-  ~BufMgr();
+  virtual void accessed(const FrameId frame) = 0;
 
 	/**
-	 * Reads the given page from the file into a frame and returns the pointer to page.
-	 * If the requested page is already present in the buffer pool pointer to that frame is returned
-	 * otherwise a new frame is allocated from the buffer pool for reading the page.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number in the file to be read
-	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+   * Called when allocBuf reuses a valid frame, before its BufDesc is cleared.
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  virtual void evicted(const FrameId frame) = 0;
 
 	/**
-	 * Unpin a page from memory since it is no longer required for it to remain in memory.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
-	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
-   * @throws  PageNotPinnedException If the page is not already pinned
+   * Called after a frame has been emptied by flushFile, disposePage or a failed read.
 	 */
-  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+  virtual void removed(const FrameId frame) = 0;
 
 	/**
-	 * Allocates a new, empty page in the file and returns the Page object.
-	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 * Chooses the frame allocBuf should reuse: an invalid frame, or a valid one which
+	 * is neither pinned nor in the middle of I/O.  The choice is not final until
+	 * evicted() or loaded() is called for it; allocBuf may instead write the frame
+	 * back and ask again.
 	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
-	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * @param frame   	Frame reference, chosen frame returned via this variable
+	 * @param stats   	Statistics of the partition; each frame looked at counts in sweepsteps
+	 * @return  				False if every frame is pinned or busy.
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  virtual bool pickVictim(FrameId& frame, BufStats& stats) = 0;
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
-	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
+	 * Lists valid, evictable frames roughly in the order pickVictim would choose them,
+	 * without changing any state.  The background writer cleans these first.
 	 *
-	 * @param file   	File object
-   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
-   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 * @param frames   	Receives up to count frames
+	 * @param count   	Number of frames wanted
 	 */
-  void flushFile(const File* file);
+  virtual void upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count) const = 0;
 
 	/**
-	 * Delete page from file and also from buffer pool if present.
-	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 * Called when BufMgr::resize has grown or shrunk the range of frames to numFrames
+	 * frames from the same first frame.  Frames added by a grow are invalid; frames
+	 * cut off by a shrink have been emptied, and removed() called for them, first.
 	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
+	 * @param numFramesIn	New number of frames managed by the policy
 	 */
-  void disposePage(File* file, const PageId PageNo);
+  virtual void resized(const std::uint32_t numFramesIn) = 0;
 
-	/**
-   * Print member variable values. 
-	 */
-  void  printSelf();
+ protected:
+  ReplacementPolicy(BufDesc* descsIn, const FrameId firstFrameIn, const std::uint32_t numFramesIn)
+    : descs(descsIn), firstFrame(firstFrameIn), numFrames(numFramesIn)
+  {
+  }
 
 	/**
-   * Get buffer pool usage statistics
+   * True if the frame may be handed out by pickVictim.
 	 */
-  BufStats & getBufStats()
+  bool evictable(const FrameId frame) const
   {
-		return bufStats;
+    return !descs[frame].ioInProgress && (!descs[frame].valid || descs[frame].pinCnt == 0);
   }
 
+  bool isValid(const FrameId frame) const { return descs[frame].valid; }
+
+  bool isReferenced(const FrameId frame) const { return descs[frame].refbit; }
+
+  void clearReferenced(const FrameId frame) { descs[frame].refbit = false; }
+
+  const File* fileOf(const FrameId frame) const { return descs[frame].file; }
+
+  PageId pageNoOf(const FrameId frame) const { return descs[frame].pageNo; }
+
 	/**
-   * Clear buffer pool usage statistics
+   * BufDesc table of the whole buffer pool
+	 */
+  BufDesc* descs;
+
+	/**
+   * First frame managed by the policy
+	 */
+  FrameId firstFrame;
+
+	/**
+   * Number of frames managed by the policy
+	 */
+  std::uint32_t numFrames;
+};
+
+
+/**
+* @brief An independently latched slice of the buffer pool
+*
+* Every partition owns a contiguous range of frames together with the page table
+* and replacement policy for those frames.  The range can grow into address space
+* reserved after it and shrink from its end when the pool is resized.  A (file, page) pair always hashes to the same
+* partition and is only ever cached in one of that partition's frames, so a
+* lookup, pin, unpin or eviction touches exactly one partition latch.
+*/
+class BufPartition {
+
+	friend class BufMgr;
+
+ private:
+	/**
+   * Protects every member below as well as the BufDesc entries of the frames
+   * owned by this partition.
+	 */
+  std::mutex latch;
+
+	/**
+   * Signalled whenever a frame of this partition finishes its disk I/O.
+	 */
+  std::condition_variable ioDone;
+
+	/**
+   * First frame owned by this partition
+	 */
+  FrameId firstFrame;
+
+	/**
+   * Number of frames owned by this partition
+	 */
+  std::uint32_t numFrames;
+
+	/**
+   * Number of Page::SIZE units in each frame of this partition, and where its
+   * frames start in bufPool
+	 */
+  std::uint32_t span;
+  Page* pages;
+
+	/**
+   * NUMA node the frames and descriptors of this partition are placed on
+	 */
+  std::uint32_t node;
+
+	/**
+   * Hash table mapping (File, page) to frame for pages of this partition
+	 */
+  BufHashTbl *hashTable;
+
+	/**
+   * Frames of this partition holding pages of each file, in no particular order,
+   * so that flushFile visits only the file's frames
+	 */
+  std::unordered_map<const File*, std::vector<FrameId> > fileFrames;
+
+	/**
+   * Decides which frame of this partition is reused next
+	 */
+  ReplacementPolicy *policy;
+
+	/**
+   * Buffer pool usage statistics gathered in this partition
+	 */
+  BufStats stats;
+
+	/**
+   * Statistics of this partition broken down by file name, and the entry last
+   * used, since consecutive requests usually name the same file.  Keyed by name
+   * rather than File object, which may be destroyed and its address reused.
+	 */
+  std::unordered_map<std::string, FileBufStats> fileStats;
+  FileBufStats* lastFileStats;
+
+	/**
+   * Compressed copies of clean pages evicted from this partition, NULL if
+   * there is no victim cache
+	 */
+  VictimCache *victimCache;
+
+	/**
+   * Frames allocated since the background writer last cleaned this partition
+	 */
+  std::uint32_t recentAllocs;
+
+	/**
+   * Number of threads waiting on ioDone for a frame to be unpinned
+	 */
+  std::uint32_t frameWaiters;
+
+	/**
+   * Constructor of BufPartition class
+	 */
+  BufPartition()
+    : firstFrame(0), numFrames(0), span(1), pages(NULL), node(0), hashTable(NULL), policy(NULL),
+      lastFileStats(NULL), victimCache(NULL), recentAllocs(0), frameWaiters(0)
+  {
+  }
+
+  ~BufPartition()
+  {
+    delete victimCache;
+    delete policy;
+    delete hashTable;
+  }
+};
+
+
+/**
+* @brief Settings of the BufMgr background writer
+*/
+struct BgWriterConfig
+{
+	/**
+   * Milliseconds the writer sleeps between rounds
+	 */
+  std::uint32_t intervalMs;
+
+	/**
+   * Maximum number of pages written per round over the whole pool
+	 */
+  std::uint32_t maxPagesPerRound;
+
+	/**
+   * Minimum number of frames per partition, next in line for eviction, kept clean.
+   * The writer looks further ahead when allocations since its last round
+   * outnumber this, by lookaheadFactor times their number.
+	 */
+  std::uint32_t lookahead;
+  double lookaheadFactor;
+
+	/**
+   * Fraction of the frames of a partition allowed to stay dirty; above it the
+   * writer also cleans frames which are not about to be evicted
+	 */
+  double dirtyRatio;
+
+  BgWriterConfig()
+    : intervalMs(20), maxPagesPerRound(256), lookahead(32), lookaheadFactor(2.0), dirtyRatio(0.25)
+  {
+  }
+};
+
+
+/**
+* @brief Buffer access strategy giving a sequential scan a small private ring of frames
+*
+* A scan passing its strategy to BufMgr::readPage recycles, on every miss, the frame
+* it loaded ringSize misses earlier instead of asking the replacement policy for a
+* victim, so a scan over a large relation cannot flush the rest of the pool.  Pages
+* read through the ring are loaded with their reference bit clear.  A ring frame
+* that has been pinned or referenced by anybody else since is left to the shared
+* pool and replaced in the ring by a frame from the policy.
+*
+* The ring is split evenly over the partitions of the pool, since a page can only
+* be cached in its own partition.  A strategy must be used with a single BufMgr
+* and by one thread at a time.
+*/
+class BufAccessStrategy {
+
+	friend class BufMgr;
+
+ public:
+	/**
+   * Ring size used by FileScan and the BTreeIndex build scan
+	 */
+  static const std::uint32_t DEFAULT_RING_SIZE = 32;
+
+	/**
+   * Constructor of BufAccessStrategy class
+   *
+   * @param ringSizeIn  Number of frames the scan may cycle through; 0 reads
+   *                    through the shared pool like a plain readPage
+	 */
+  explicit BufAccessStrategy(const std::uint32_t ringSizeIn = DEFAULT_RING_SIZE)
+    : ringSize(ringSizeIn)
+  {
+  }
+
+ private:
+	/**
+   * Total number of frames in the ring
+	 */
+  std::uint32_t ringSize;
+
+	/**
+   * Frames of the ring, per partition, and the slot to recycle next in each
+	 */
+  std::vector<std::vector<FrameId> > rings;
+  std::vector<std::uint32_t> cursors;
+};
+
+
+/**
+* @brief Pin on a page of the buffer pool, released when the handle goes away
+*
+* Returned by the BufMgr::readPage and BufMgr::allocPage overloads which take no
+* Page pointer.  The handle remembers the frame the page was found in, so that
+* unpinning it needs no page table lookup, and unpins the page from its destructor
+* on every return path.  Handles can be moved but not copied.
+*/
+class PageHandle {
+
+	friend class BufMgr;
+
+ public:
+	/**
+   * Constructs an empty handle, pinning nothing.
+	 */
+  PageHandle()
+    : bufMgr(NULL), file_(NULL), pageNo_(Page::INVALID_NUMBER), frameNo(0), page_(NULL), dirty(false)
+  {
+  }
+
+  PageHandle(PageHandle&& other)
+    : bufMgr(other.bufMgr), file_(other.file_), pageNo_(other.pageNo_), frameNo(other.frameNo),
+      page_(other.page_), dirty(other.dirty)
+  {
+    other.bufMgr = NULL;
+    other.page_ = NULL;
+  }
+
+	/**
+   * Releases the page currently held, then takes over the other handle's pin.
+	 */
+  PageHandle& operator=(PageHandle&& other)
+  {
+    if (this != &other)
+    {
+      release();
+      bufMgr = other.bufMgr;
+      file_ = other.file_;
+      pageNo_ = other.pageNo_;
+      frameNo = other.frameNo;
+      page_ = other.page_;
+      dirty = other.dirty;
+      other.bufMgr = NULL;
+      other.page_ = NULL;
+    }
+    return *this;
+  }
+
+  PageHandle(const PageHandle&) = delete;
+  PageHandle& operator=(const PageHandle&) = delete;
+
+  ~PageHandle()
+  {
+    try
+    {
+      release();
+    }
+    catch (...)
+    {
+    }
+  }
+
+	/**
+   * Unpins the page now, marking it dirty if markDirty was called.  The handle is
+   * empty afterwards; releasing an empty handle does nothing.
+   *
+   * @throws  PageNotPinnedException If the page was unpinned behind the handle's back
+	 */
+  void release();
+
+	/**
+   * Marks the page dirty; it is written back when evicted or flushed.
+	 */
+  void markDirty()
+  {
+    dirty = true;
+  }
+
+	/**
+   * Returns the pinned page, or NULL if the handle is empty.
+	 */
+  Page* page() const
+  {
+    return page_;
+  }
+
+  Page* operator->() const
+  {
+    return page_;
+  }
+
+  Page& operator*() const
+  {
+    return *page_;
+  }
+
+  File* file() const
+  {
+    return file_;
+  }
+
+  PageId pageNo() const
+  {
+    return pageNo_;
+  }
+
+	/**
+   * True if the handle holds a pin.
+	 */
+  explicit operator bool() const
+  {
+    return page_ != NULL;
+  }
+
+ private:
+  PageHandle(BufMgr* bufMgrIn, File* fileIn, const PageId pageNoIn, const FrameId frameNoIn, Page* pageIn)
+    : bufMgr(bufMgrIn), file_(fileIn), pageNo_(pageNoIn), frameNo(frameNoIn), page_(pageIn), dirty(false)
+  {
+  }
+
+	/**
+   * Buffer manager holding the pin, or NULL if the handle is empty
+	 */
+  BufMgr* bufMgr;
+
+	/**
+   * File and number of the pinned page
+	 */
+  File* file_;
+  PageId pageNo_;
+
+	/**
+   * Frame the page is pinned in
+	 */
+  FrameId frameNo;
+
+	/**
+   * The page in the buffer pool
+	 */
+  Page* page_;
+
+	/**
+   * True if the page is to be unpinned dirty
+	 */
+  bool dirty;
+};
+
+
+/**
+* @brief Read-only counterpart of PageHandle
+*
+* Returned by BufMgr::readConstPage.  A page of a file opened with
+* BlobFile::openMapped is handed out where it lies in the file's mapping and holds
+* no pin; any other page is pinned in a frame, and unpinned clean when the handle is
+* released or destroyed.  Handles can be moved but not copied.
+*/
+class ConstPageHandle {
+
+	friend class BufMgr;
+
+ public:
+	/**
+   * Constructs an empty handle, pinning nothing.
+	 */
+  ConstPageHandle()
+    : page_(NULL)
+  {
+  }
+
+  ConstPageHandle(ConstPageHandle&& other)
+    : pinned(std::move(other.pinned)), page_(other.page_)
+  {
+    other.page_ = NULL;
+  }
+
+	/**
+   * Releases the page currently held, then takes over the other handle's page.
+	 */
+  ConstPageHandle& operator=(ConstPageHandle&& other)
+  {
+    if (this != &other)
+    {
+      release();
+      pinned = std::move(other.pinned);
+      page_ = other.page_;
+      other.page_ = NULL;
+    }
+    return *this;
+  }
+
+  ConstPageHandle(const ConstPageHandle&) = delete;
+  ConstPageHandle& operator=(const ConstPageHandle&) = delete;
+
+	/**
+   * Unpins the page now, if it was pinned.  The handle is empty afterwards;
+   * releasing an empty handle does nothing.
+   *
+   * @throws  PageNotPinnedException If the page was unpinned behind the handle's back
+	 */
+  void release()
+  {
+    page_ = NULL;
+    pinned.release();
+  }
+
+	/**
+   * Returns the page, or NULL if the handle is empty.
+	 */
+  const Page* page() const
+  {
+    return page_;
+  }
+
+  const Page* operator->() const
+  {
+    return page_;
+  }
+
+  const Page& operator*() const
+  {
+    return *page_;
+  }
+
+	/**
+   * True if the handle holds a page.
+	 */
+  explicit operator bool() const
+  {
+    return page_ != NULL;
+  }
+
+ private:
+  explicit ConstPageHandle(PageHandle&& pinnedIn)
+    : pinned(std::move(pinnedIn)), page_(pinned.page())
+  {
+  }
+
+  explicit ConstPageHandle(const Page* mappedIn)
+    : page_(mappedIn)
+  {
+  }
+
+	/**
+   * Pin on the frame holding the page; empty for a mapped page
+	 */
+  PageHandle pinned;
+
+	/**
+   * The page, in the buffer pool or in the file's mapping
+	 */
+  const Page* page_;
+};
+
+
+/**
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* The pool is split into partitions (see BufPartition) so that readPage, unPinPage,
+* allocPage and disposePage may be called concurrently from many threads.  Disk
+* reads and dirty write-backs are performed with the partition latch released;
+* the frame involved is flagged ioInProgress meanwhile.
+*/
+class BufMgr 
+{
+	friend class PageHandle;
+
+ private:
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::atomic<std::uint32_t> numBufs;
+
+	/**
+   * Frames of address space reserved for each partition: partition p owns the
+   * frames from p * partitionCapacity on, of which its first numFrames are in use.
+   * Partitions of larger page sizes reserve correspondingly more of bufPool.
+	 */
+  std::uint32_t partitionCapacity;
+
+	/**
+   * Address space reserved for bufPool, and its size
+	 */
+  void* poolRegion;
+  std::size_t poolBytes;
+
+	/**
+   * Size of the address space reserved for bufDescTable
+	 */
+  std::size_t descBytes;
+
+	/**
+   * True while every frame in use is backed by huge pages reserved with hugetlbfs;
+   * false once transparent huge pages had to be asked for instead
+	 */
+  bool poolHugeTlb;
+
+	/**
+   * Serializes calls to resize
+	 */
+  std::mutex resizeLatch;
+
+	/**
+	 * Size of the huge pages the frames of every partition are backed by, or whose
+	 * multiples they are committed in
+	 */
+  static const std::size_t HUGE_PAGE_SIZE = 2 << 20;
+
+	/**
+	 * Multiple of its initial size each class of frames reserves address space
+	 * for, unless PageSizeClass::maxFrames asks for more, so that resize can grow
+	 * it without moving pages that are pinned
+	 */
+  static const std::uint32_t POOL_GROWTH_FACTOR = 4;
+
+	/**
+	 * Milliseconds a shrinking resize waits for pages pinned in the frames it gives
+	 * up to be unpinned before it keeps those frames instead
+	 */
+  static const std::uint32_t SHRINK_PIN_WAIT_MS = 100;
+
+	/**
+	 * Backs frames of a partition from its current size up to numFrames with memory,
+	 * from hugetlbfs where it has pages to spare and otherwise ordinary memory with
+	 * transparent huge pages requested, and constructs their BufDesc and Page.
+	 * Memory is committed in whole huge pages.
+	 *
+	 * @param part 				Partition to grow
+	 * @param numFrames 	Number of frames the partition is about to have
+	 * @throws std::bad_alloc If the memory cannot be mapped
+	 */
+  void commitFrames(BufPartition& part, const std::uint32_t numFrames);
+
+	/**
+	 * Returns the memory of the frames of a partition beyond its current size, up to
+	 * oldFrames, to the system.
+	 *
+	 * @param part 				Partition that has shrunk
+	 * @param oldFrames 	Number of frames the partition had before
+	 */
+  void releaseFrames(BufPartition& part, const std::uint32_t oldFrames);
+
+	/**
+	 * Grows a partition to numFrames frames: the new frames are committed, then
+	 * handed to the policy under the partition latch together with a page table
+	 * sized for them.
+	 */
+  void growPartition(BufPartition& part, const std::uint32_t numFrames);
+
+	/**
+	 * Shrinks a partition towards numFrames frames by emptying the frames at the end
+	 * of its range.  Waits for I/O on those frames to finish and claims them, so that
+	 * their pages can no longer be pinned, then waits up to SHRINK_PIN_WAIT_MS for the
+	 * pages already pinned to be unpinned.  A page still pinned cannot be dropped, so
+	 * the partition keeps every frame up to the last one; the pages in the others are
+	 * written back if dirty and dropped from the pool.
+	 *
+	 * @return 	Number of frames the partition has now
+	 */
+  std::uint32_t shrinkPartition(BufPartition& part, std::uint32_t numFrames);
+
+	/**
+   * Number of partitions the buffer pool is split into
+	 */
+  std::uint32_t numPartitions;
+
+	/**
+   * Page size of each class of frames, smallest first, and the consecutive
+   * partitions holding its frames
+	 */
+  std::vector<std::size_t> pageSizes;
+  std::vector<std::uint32_t> classFirstPartition;
+  std::vector<std::uint32_t> classPartitions;
+
+	/**
+   * Number of NUMA nodes the partitions are spread over, partition p being on
+   * node p % numNodes, and how pages are assigned to them
+	 */
+  std::uint32_t numNodes;
+  NumaPlacement placement;
+
+	/**
+   * Array of numPartitions partitions, each owning a range of frames
+	 */
+  BufPartition *partitions;
+
+	/**
+   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+	 */
+  BufDesc *bufDescTable;
+
+	/**
+   * Stream page references are recorded to, or NULL, and the latch serializing it
+	 */
+  std::atomic<std::ostream*> traceStream;
+  std::mutex traceLatch;
+
+	/**
+   * Stream the destructor saves the hot set to, or NULL
+	 */
+  std::ostream* hotSetStream;
+
+	/**
+   * Cache file clean pages are spilled to, shared by the partitions, or NULL
+	 */
+  SsdCache* ssdCache;
+
+	/**
+   * Milliseconds allocBuf waits for a frame to be unpinned before throwing, 0
+   * to throw at once
+	 */
+  std::atomic<std::uint32_t> frameWaitMs;
+
+	/**
+   * Background writer thread, its settings, and the latch and condition used
+   * to stop it
+	 */
+  std::thread bgWriter;
+  BgWriterConfig bgWriterConfig;
+  std::mutex bgWriterLatch;
+  std::condition_variable bgWriterWake;
+  bool bgWriterStop;
+
+	/**
+   * Body of the background writer thread.
+	 */
+  void bgWriterLoop();
+
+	/**
+   * Run of pages of one file claimed by prefetch, each with the frame it goes to
+	 */
+  struct PrefetchJob
+  {
+    File* file;
+    std::vector<std::pair<PageId, FrameId> > pages;
+  };
+
+	/**
+   * Number of threads performing read-ahead I/O, started on the first prefetch
+	 */
+  static const std::uint32_t PREFETCH_THREADS = 4;
+
+	/**
+   * Largest number of adjacent pages flushFile and the destructor write back with one call
+	 */
+  static const std::uint32_t MAX_WRITE_RUN = 64;
+
+	/**
+   * Read-ahead threads, their queue of pending jobs, and the latch and
+   * condition guarding the queue
+	 */
+  std::vector<std::thread> prefetchers;
+  std::deque<PrefetchJob> prefetchQueue;
+  std::mutex prefetchLatch;
+  std::condition_variable prefetchWake;
+  bool prefetchStop;
+
+	/**
+   * Body of the read-ahead threads.
+	 */
+  void prefetchLoop();
+
+	/**
+   * Largest number of adjacent pages a read-ahead thread reads with one call
+	 */
+  static const std::uint32_t MAX_READ_RUN = 64;
+
+	/**
+	 * Claims a frame for the read-ahead of a page: the page is mapped to it unpinned
+	 * and flagged ioInProgress until a read-ahead thread has filled it.
+	 *
+	 * @param part    	Partition of the page, whose latch the caller holds
+	 * @param lock    	Lock the caller holds on the partition latch
+	 * @param file   		File object
+	 * @param pageNo  	Page number
+	 * @param strategy	Ring to recycle a frame from first, or NULL
+	 * @param frameNo 	Frame reference, claimed frame returned via this variable
+	 * @return 					False if the page is in the pool already.
+	 * @throws BufferExceededException If every frame of the partition is pinned
+	 */
+  bool claimForReadAhead(BufPartition& part, std::unique_lock<std::mutex>& lock, File* file,
+                         const PageId pageNo, BufAccessStrategy* strategy, FrameId& frameNo);
+
+	/**
+   * Hands pages claimed by claimForReadAhead to the read-ahead threads, starting
+   * them on first use.
+	 */
+  void queueReadAhead(const PrefetchJob& job);
+
+	/**
+	 * Completes the read-ahead of count pages of a job, adjacent in the file, with
+	 * one read.  If that fails the pages are read one at a time, so that only those
+	 * which cannot be read are dropped from the pool.
+	 */
+  void readAhead(const PrefetchJob& job, const std::size_t first, const std::size_t count);
+
+	/**
+   * Stops the read-ahead threads once their queue is empty.
+	 */
+  void stopPrefetchers();
+
+	/**
+	 * Writes out up to budget dirty, unpinned frames of the partition: those next in
+	 * line for eviction, then others while the partition is above its dirty ratio.
+	 *
+	 * @param part    	Partition to clean
+	 * @param budget  	Maximum number of pages to write
+	 * @return  				Number of pages written.
+	 */
+  std::uint32_t cleanPartition(BufPartition& part, const std::uint32_t budget);
+
+	/**
+   * Appends a page reference to traceStream, if set.
+	 */
+  void tracePage(const File* file, const PageId pageNo)
+  {
+    if (traceStream.load(std::memory_order_relaxed) != NULL)
+    {
+      std::lock_guard<std::mutex> guard(traceLatch);
+      if (traceStream != NULL)
+        *traceStream.load() << file->filename() << ' ' << pageNo << '\n';
+    }
+  }
+
+	/**
+	 * Returns the partition which caches the given page of the file.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Partition owning the page.
+	 */
+  BufPartition& partitionOf(const File* file, const PageId pageNo);
+
+	/**
+	 * Returns the partition owning the given frame.
+	 */
+  BufPartition& partitionOfFrame(const FrameId frameNo);
+
+	/**
+	 * Returns the class of frames the pages of a file are cached in.
+	 *
+	 * @throws  BufferExceededException If the file's pages are larger than any frame
+	 */
+  std::uint32_t classOf(const File* file) const;
+
+	/**
+	 * Reads a page of the file into a frame, or writes it from the frame, as one
+	 * request covering every Page::SIZE unit of the file's page.
+	 */
+  void readFrame(File* file, const PageId pageNo, const FrameId frameNo);
+  void writeFrame(File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+	 * Pins the given page of the file, reading it into a frame if it is not cached.
+	 * Does the work of readPage.
+	 *
+	 * @return  			Frame holding the page.
+	 */
+  FrameId pinPage(File* file, const PageId pageNo, BufAccessStrategy* strategy);
+
+	/**
+	 * Allocates a new page in the file and pins it in a frame.  Does the work of allocPage.
+	 *
+	 * @return  			Frame holding the page.
+	 */
+  FrameId allocFrame(File* file, PageId& pageNo);
+
+	/**
+	 * Enters the page just assigned to a frame with BufDesc::Set in the partition's
+	 * hash table and file directory, and drops any copy of it from the victim
+	 * cache.  Must be called with the partition latch held.
+	 */
+  void mapFrame(BufPartition& part, const FrameId frameNo);
+
+	/**
+	 * Removes the page held in a frame from the partition's hash table and file
+	 * directory, before the frame is cleared.  Must be called with the partition
+	 * latch held.
+	 */
+  void unmapFrame(BufPartition& part, const FrameId frameNo);
+
+	/**
+	 * Ends the stashing of a page allocBuf evicted into the partition's victim cache:
+	 * stores it if it could be compressed and is still reserved, otherwise cancels
+	 * its reservation.  Must be called with the partition latch held.
+	 *
+	 * @param victim 	File and page number of the evicted page
+	 * @param compressed 	The page as compressed by VictimCache::compress
+	 * @param fits 	Whether it compressed well enough to be kept
+	 */
+  void stashVictim(BufPartition& part, const std::pair<const File*, PageId>& victim,
+                   const std::vector<char>& compressed, const bool fits);
+
+	/**
+	 * Returns the partition's statistics entry for a file, creating it if needed.
+	 * Must be called with the partition latch held.
+	 */
+  FileBufStats& fileStatsOf(BufPartition& part, const File* file);
+
+	/**
+	 * Ends a flushFile: frames before upTo in the list have been written and are
+	 * dropped from the pool, the others are handed back untouched.
+	 *
+	 * @param frames 	(page number, frame) of every frame flushFile claimed
+	 * @param upTo  	Number of frames to drop
+	 */
+  void finishFlush(const std::vector<std::pair<PageId, FrameId> >& frames, const std::size_t upTo);
+
+	/**
+	 * Writes back the dirty page in frames[first] together with the dirty pages
+	 * after it in the list which follow it in the same file, up to MAX_WRITE_RUN
+	 * pages, with a single File::writePages call.
+	 *
+	 * @param frames 	Frames sorted by (file, page number)
+	 * @param first  	Position in the list of the first frame to write
+	 * @return 				Number of frames written
+	 */
+  std::size_t writeRun(const std::vector<FrameId>& frames, const std::size_t first);
+
+	/**
+	 * Unpins the page held in a frame, as unPinPage does but without the page table
+	 * lookup.  Used by PageHandle.
+	 *
+	 * @param frameNo	Frame the page is pinned in
+	 * @param dirty		True if the page needs to be marked dirty
+   * @throws  PageNotPinnedException If the page is not pinned
+	 */
+  void unPinFrame(const FrameId frameNo, const bool dirty);
+
+	/**
+	 * Allocate a free frame of the partition, as chosen by its replacement policy.
+	 * Must be called with the partition latch held.
+	 * If the chosen frame is dirty it is written back with the latch released, the
+	 * frame is left clean but still valid, and false is returned: the caller must then
+	 * re-validate whatever it looked up before and call allocBuf again.
+	 *
+	 * @param part    	Partition to allocate the frame from
+	 * @param lock    	Lock the caller holds on the partition latch
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param strategy	Ring to recycle a frame from first, or NULL
+	 * @param victim 	If not NULL and the partition has a victim cache, receives the
+	 *								file and page number of the clean page evicted from the frame
+	 *								if it has been reserved a place there, or a NULL file.  The
+	 *								frame still holds the page for the caller to compress and
+	 *								pass to stashVictim before overwriting it.
+	 * @param spillSlot 	If not NULL, receives the slot of the SSD cache reserved for
+	 *								the same page, or SsdCache::NO_SLOT.  The caller writes the
+	 *								page there with SsdCache::store before overwriting it.
+	 * @param mayWait 	False to throw rather than wait for a frame to be unpinned,
+	 *								whatever the frame wait timeout
+	 * @return  				True if a frame was allocated without releasing the latch.
+	 * @throws BufferExceededException If every frame is pinned and none is unpinned
+	 *								within the frame wait timeout
+	 */
+  bool allocBuf(BufPartition& part, std::unique_lock<std::mutex>& lock, FrameId & frame,
+                BufAccessStrategy* strategy = NULL, std::pair<const File*, PageId>* victim = NULL,
+                std::uint32_t* spillSlot = NULL, const bool mayWait = true);
+
+
+ public:
+	/**
+   * Actual buffer pool from which frames are allocated
+	 */
+  Page* bufPool;
+
+	/**
+   * Constructor of BufMgr class
+   *
+   * @param bufs        Number of frames in the buffer pool
+   * @param partitions  Number of independently latched partitions, or 0 to pick one
+   *                    per hardware thread while keeping at least 64 frames in each
+   * @param policy      Page replacement policy used within every partition
+   * @param placement   How pages are spread over the NUMA nodes.  On a machine
+   *                    with several nodes the number of partitions is rounded
+   *                    down to a multiple of the number of nodes, and the
+   *                    memory of each partition is placed on one node.
+	 */
+  BufMgr(std::uint32_t bufs, std::uint32_t partitions = 0, ReplacementPolicyType policy = CLOCK_POLICY,
+         NumaPlacement placement = NUMA_INTERLEAVE);
+
+	/**
+   * Constructor of BufMgr class for files of several page sizes.  Each class of
+   * frames gets partitions of its own, chosen as above from its number of frames;
+   * a page is cached in the class of the smallest page size that holds it.
+   *
+   * @param classes     Page size and number of frames of each class
+   * @param partitions  Number of partitions of each class, or 0 to pick
+   * @param policy      Page replacement policy used within every partition
+   * @param placement   How pages are spread over the NUMA nodes
+	 */
+  BufMgr(const std::vector<PageSizeClass>& classes, std::uint32_t partitions = 0,
+         ReplacementPolicyType policy = CLOCK_POLICY, NumaPlacement placement = NUMA_INTERLEAVE);
+	
+	/**
+   * Destructor of BufMgr class
+	 */
+  ~BufMgr();
+
+	/**
+	 * Reads the given page from the file into a frame and returns the pointer to page.
+	 * If the requested page is already present in the buffer pool pointer to that frame is returned
+	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 *
+	 * Pages of a file opened with BlobFile::openMapped are read-only; read them with
+	 * the overload taking a const Page*.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param strategy	Ring of frames to read the page into on a miss, or NULL to use the whole pool
+	 * @throws  InvalidPageException If the file is mapped
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page, BufAccessStrategy* strategy = NULL);
+
+	/**
+	 * Reads the given page from the file, as above, for reading only.  A page of a
+	 * file opened with BlobFile::openMapped is not copied into the pool: the pointer
+	 * returned is into the file's read-only mapping, and unPinPage does nothing for
+	 * it.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param strategy	Ring of frames to read the page into on a miss, or NULL to use the whole pool
+	 */
+  void readPage(File* file, const PageId PageNo, const Page*& page, BufAccessStrategy* strategy = NULL);
+
+	/**
+	 * Reads the given page from the file into a frame, as above, and returns a handle
+	 * which unpins it when destroyed.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param strategy	Ring of frames to read the page into on a miss, or NULL to use the whole pool
+	 * @return  			Handle pinning the page.
+	 * @throws  InvalidPageException If the file is mapped
+	 */
+  PageHandle readPage(File* file, const PageId PageNo, BufAccessStrategy* strategy = NULL);
+
+	/**
+	 * Reads the given page from the file for reading only, as the overload taking a
+	 * const Page*, and returns a handle which unpins it, if pinned, when destroyed.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param strategy	Ring of frames to read the page into on a miss, or NULL to use the whole pool
+	 * @return  			Handle on the page.
+	 */
+  ConstPageHandle readConstPage(File* file, const PageId PageNo, BufAccessStrategy* strategy = NULL);
+
+	/**
+	 * Starts reading pages first to first + count - 1 of the file into the buffer pool
+	 * without pinning them, and returns without waiting for the reads.  A later readPage
+	 * of one of the pages waits for its read to complete rather than issuing another.
+	 * Pages already cached are skipped.  Read-ahead is only a hint: it stops early if the
+	 * pool has no frame to spare, and pages which cannot be read (past the end of the
+	 * file, say) are silently dropped.  The file must stay open until the reads are
+	 * done; flushFile waits for them.
+	 *
+	 * @param file   	File object
+	 * @param first  	First page number to read
+	 * @param count  	Number of consecutive pages to read
+	 * @param strategy	Ring of frames to read the pages into, or NULL to use the whole pool
+	 */
+  void prefetch(File* file, const PageId first, const std::uint32_t count, BufAccessStrategy* strategy = NULL);
+
+	/**
+	 * Reads and pins pages first to first + count - 1 of the file, issuing all the
+	 * reads before waiting for the first of them.  Every page must be unpinned as if
+	 * read by readPage.
+	 *
+	 * @param file   	File object
+	 * @param first  	First page number to read
+	 * @param count  	Number of consecutive pages to read
+	 * @param pages  	Receives a pointer to each of the count pages, in page order
+	 * @param strategy	Ring of frames to read the pages into, or NULL to use the whole pool
+	 */
+  void readPages(File* file, const PageId first, const std::uint32_t count, std::vector<Page*>& pages,
+                 BufAccessStrategy* strategy = NULL);
+
+	/**
+	 * Unpin a page from memory since it is no longer required for it to remain in memory.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+   * @throws  PageNotPinnedException If the page is not already pinned
+   * @throws  HashNotFoundException If the page is not in the buffer pool
+   * @throws  InvalidPageException If dirty is set for a page of a mapped file
+	 */
+  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * Allocates a new, empty page in the file and returns the Page object.
+	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page); 
+
+	/**
+	 * Allocates a new, empty page in the file, as above, and returns a handle which
+	 * unpins it when destroyed.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @return  			Handle pinning the new page.
+	 */
+  PageHandle allocPage(File* file, PageId &PageNo);
+
+	/**
+	 * Writes out all dirty pages of the file to disk, in page order, and drops the file's
+	 * pages from the buffer pool.  Only the file's own frames are visited.
+	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
+	 * Otherwise Error returned.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  void flushFile(const File* file);
+
+	/**
+	 * Delete page from file and also from buffer pool if present.
+	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 */
+  void disposePage(File* file, const PageId PageNo);
+
+	/**
+   * Print member variable values. 
+	 */
+  void  printSelf();
+
+	/**
+   * Get buffer pool usage statistics, as statsSnapshot does
+	 */
+  BufStats getBufStats();
+
+	/**
+	 * Returns the buffer pool usage statistics summed over all partitions.  The
+	 * result is a copy, so any thread may take one at any time; the counters are
+	 * read one by one while the pool is in use.
+	 */
+  BufStats statsSnapshot();
+
+	/**
+	 * Returns the usage statistics of every file whose pages have been requested
+	 * since the statistics were last cleared, one entry per file name, sorted by
+	 * name.  A file closed and opened again keeps adding to the same entry.
+	 */
+  std::vector<FileBufStats> fileStatsSnapshot();
+
+	/**
+	 * Writes a snapshot of the statistics to out in the Prometheus text exposition
+	 * format: a badgerdb_buffer_ counter per BufStats field, per-file counters
+	 * labelled with the file name, and the read and write latency histograms in
+	 * seconds.
+	 *
+	 * @param out	Stream to write the metrics to
+	 */
+  void exportStats(std::ostream& out);
+
+	/**
+   * Clear buffer pool usage statistics
+	 */
+  void clearBufStats();
+
+	/**
+	 * Sets the memory budget of the compressed victim cache, split evenly over the
+	 * partitions, and creates the cache if there is none yet.  Clean pages evicted
+	 * to make room for a readPage are then kept there compressed, and a readPage
+	 * which misses the pool decompresses its page from there rather than reading
+	 * the file.  The readPage that evicts a page compresses it.  Scan pages
+	 * recycled through a BufAccessStrategy ring and read-ahead pages never used
+	 * are not kept.  A budget of 0 removes the cache.
+	 *
+	 * @param budgetBytes 	Memory the compressed pages may take in all
+	 */
+  void setVictimCacheSize(const std::size_t budgetBytes);
+
+	/**
+	 * Returns the memory the compressed victim cache takes, 0 if there is none.
+	 */
+  std::size_t victimCacheBytes();
+
+	/**
+	 * Spills clean pages to a cache file on a local disk, for relations on slower
+	 * storage.  Clean pages evicted to make room for a readPage are written to
+	 * the cache file by that readPage, and a readPage which misses the pool reads
+	 * its page from there when it can rather than from the page's file.  Cached
+	 * pages are invalidated when the buffer manager writes them back, disposes
+	 * of them or flushes their file; pages written to their files by other means
+	 * must be flushed from the pool first.  Scan pages recycled through a
+	 * BufAccessStrategy ring and read-ahead pages never used are not spilled.
+	 *
+	 * Replaces any previous SSD cache, and so must not be called while other
+	 * threads use the buffer manager.  A size under one page removes the cache.
+	 *
+	 * @param directory 	Local directory to create the cache file in
+	 * @param bytes 	Size of the cache file
+	 * @throws  FileNotFoundException If no file can be created in the directory
+	 */
+  void setSsdCache(const std::string& directory, const std::size_t bytes);
+
+	/**
+	 * Returns the number of pages in the SSD cache, 0 if there is none.
+	 */
+  std::uint32_t ssdCachePages();
+
+	/**
+	 * Returns true if the buffer pool is backed by reserved (hugetlbfs) huge pages.
+	 * Otherwise it is an ordinary mapping for which transparent huge pages have
+	 * been requested, which the kernel grants at its discretion.
+	 */
+  bool poolOnHugeTlb() const { return poolHugeTlb; }
+
+	/**
+	 * Grows or shrinks the frames of one page size to numFrames while the pool is
+	 * in use, spreading them evenly over the partitions of that size.  New frames
+	 * are empty; shrinking writes back and drops the pages in the frames given up.
+	 * Pages never move between frames, so pointers to pinned pages stay valid.
+	 *
+	 * A class cannot grow beyond the frames it reserved address space for (see
+	 * PageSizeClass), nor shrink below one frame per partition, and frames up to the last
+	 * pinned page of each partition are kept; numFrames is trimmed accordingly.
+	 *
+	 * @param numFrames	Number of frames wanted
+	 * @param pageSize	Page size of the frames to resize
+	 * @return 					Number of frames of that size the pool has now, 0 if it
+	 *									has no frames of that size
+	 */
+  std::uint32_t resize(std::uint32_t numFrames, std::size_t pageSize = Page::SIZE);
+
+	/**
+	 * Returns the number of frames in the buffer pool.
+	 */
+  std::uint32_t numFrames() const { return numBufs; }
+
+	/**
+   * Starts the background writer, which every config.intervalMs milliseconds writes
+   * back dirty, unpinned pages ahead of the replacement policy so that eviction
+   * finds clean frames.  Restarts it with the new settings if already running.
+	 */
+  void startBgWriter(const BgWriterConfig& config = BgWriterConfig());
+
+	/**
+   * Stops the background writer, if running, and waits for it to exit.
+	 */
+  void stopBgWriter();
+
+	/**
+	 * Writes the pages resident in the buffer pool to out, hottest first, one
+	 * "filename pageNo refbit" line per page, for loadHotSet to read back after a
+	 * restart.  Pinned pages come first, then each partition's pages in the reverse
+	 * of the order its replacement policy would evict them, partitions interleaved.
+	 *
+	 * @param out	Stream to write the hot set to
+	 */
+  void saveHotSet(std::ostream& out);
+
+	/**
+	 * Reads a hot set written by saveHotSet and reads its pages back into the pool,
+	 * up to as many as each partition holds, hottest first.  Frames are claimed
+	 * coldest first, so that the replacement policies rank the pages as they did
+	 * before, and the pages are read by the read-ahead threads in page order, runs
+	 * of adjacent pages with one read each.  Pages of files not in the list are
+	 * skipped.  Returns once the reads are queued; a readPage of a page still on
+	 * its way waits for it.  The reads are counted as prefetches in BufStats.
+	 *
+	 * @param in    	Stream to read the hot set from
+	 * @param files 	Open files whose pages to load, matched by file name
+	 * @return 				Number of pages queued for reading
+	 */
+  std::uint32_t loadHotSet(std::istream& in, const std::vector<File*>& files);
+
+	/**
+	 * Makes the destructor save the hot set to out, as saveHotSet does, before it
+	 * writes back the dirty pages.  Pass NULL to stop it.
+	 */
+  void setHotSetStream(std::ostream* out) { hotSetStream = out; }
+
+	/**
+	 * Makes a readPage or allocPage which finds every frame of its partition
+	 * pinned wait for one to be unpinned, rather than throw BufferExceededException
+	 * at once, so that a burst of concurrent pins is absorbed as a delay.  The
+	 * exception is thrown only if no frame becomes free within timeoutMs of
+	 * waiting; a thread which is woken but beaten to the frame by another waits
+	 * again.  Waits are counted in framewaits and timed in frameWaitLatency.
+	 * Read-ahead never waits.  A timeout of 0, the default, restores throwing at
+	 * once.
+	 *
+	 * A thread must not wait while holding pins it will only release afterwards
+	 * if the pool may be pinned out by such threads alone: they would all time out.
+	 *
+	 * @param timeoutMs 	Milliseconds to wait for a frame
+	 */
+  void setFrameWaitTimeout(const std::uint32_t timeoutMs) { frameWaitMs = timeoutMs; }
+
+	/**
+   * Records every page requested through readPage and allocPage to out, one
+   * "filename pageNo" line per reference, for replay by ReplacementPolicy::simulate().
+   * Pass NULL to stop recording.
+	 */
+  void setTraceStream(std::ostream* out)
+  {
+    std::lock_guard<std::mutex> guard(traceLatch);
+    traceStream = out;
+  }
+
+	/**
+   * Returns the number of partitions the buffer pool is split into.
+	 */
+  std::uint32_t getNumPartitions() const
+  {
+		return numPartitions;
+  }
+
+	/**
+   * Returns the number of NUMA nodes the buffer pool is spread over, 1 on a
+   * machine without NUMA or with a pool too small to split.
+	 */
+  std::uint32_t getNumNodes() const
+  {
+		return numNodes;
+  }
+
+	/**
+   * Returns the NUMA node holding the pages of a file under NUMA_FILE_AFFINE
+   * placement, so that the threads working on the file can be kept there with
+   * NumaTopology::bindThread.  Pages are spread over every node otherwise, and
+   * 0 is returned.
 	 */
-  void clearBufStats() 
+  std::uint32_t nodeOfFile(const File* file) const
   {
-		bufStats.clear();
+    if (placement != NUMA_FILE_AFFINE || numNodes == 1)
+      return 0;
+    return (std::uint32_t) ((BufHashTbl::hash64(file, 0) >> 32) % numNodes);
   }
 };
 
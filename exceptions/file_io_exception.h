@@ -0,0 +1,43 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when reading or writing a file fails, or
+ *        a read ends before the end of the data asked for.
+ */
+class FileIOException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a file I/O exception for the given file.
+   *
+   * @param name  Name of file.
+   * @param error Error number of the failed call, or 0 if the file ended
+   *              early.
+   */
+  FileIOException(const std::string& name, const int error);
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string name_;
+
+  /**
+   * Error number of the failed call, or 0 if the file ended early.
+   */
+  const int error_;
+};
+
+}
@@ -7,24 +7,40 @@
 
 #include "file.h"
 
-#include <fstream>
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <cassert>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
+#include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "file_iterator.h"
 #include "page.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
+File::DescriptorMap File::open_fds_;
+File::LatchMap File::open_latches_;
+File::HeaderMap File::open_headers_;
 File::CountMap File::open_counts_;
+File::DescriptorMap File::open_direct_fds_;
+const std::size_t File::DIRECT_IO_ALIGNMENT;
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -44,18 +60,16 @@ bool File::isOpen(const std::string& filename) {
 }
 
 bool File::exists(const std::string& filename) {
-	std::fstream file(filename);
-	if(file)
-	{
-		file.close();
-		return true;
-	}
-
-	return false;
+	return ::access(filename.c_str(), F_OK) == 0;
 }
 
 File::~File() {
-  close();
+  // A destructor must not throw; a failed write-back of the header is reported.
+  try {
+    close();
+  } catch (const BadgerDbException& e) {
+    std::cerr << "Closing " << filename_ << ": " << e.message() << std::endl;
+  }
 }
 
 
@@ -64,41 +78,127 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
-  openIfNeeded(create_new);
+PageId File::numPages() const {
+  return readHeader().num_pages;
+}
+
+File::File(const std::string& name, const bool create_new, const bool direct_io,
+           const std::size_t page_size, const bool read_only)
+: filename_(name), fd_(-1), direct_fd_(-1), page_size_(Page::sizeClassOf(page_size)),
+  pages_per_map_(0), map_pages_(0), mapped_bytes_(0) {
+  openIfNeeded(create_new, direct_io, read_only);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         (std::uint32_t) page_size_, 0 /* last_used_page */};
     writeHeader(header);
+    sync();
+  } else {
+    page_size_ = readHeader().page_size;
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
+void File::openIfNeeded(const bool create_new, const bool direct_io,
+                        const bool read_only) {
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
+    // A read-only descriptor cannot be shared with a writer.
+    if (!read_only && open_headers_[filename_]->read_only) {
+      throw FileOpenException(filename_);
+    }
     ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+    fd_ = open_fds_[filename_];
+    latch_ = open_latches_[filename_];
+    header_ = open_headers_[filename_];
+    DescriptorMap::const_iterator fd = open_direct_fds_.find(filename_);
+    direct_fd_ = (fd == open_direct_fds_.end()) ? -1 : fd->second;
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
+    int flags = read_only ? O_RDONLY : O_RDWR;
     const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
       if (already_exists) {
         throw FileExistsException(filename_);
       }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
+      flags = flags | O_CREAT | O_TRUNC;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
+    fd_ = ::open(filename_.c_str(), flags, 0666);
+    if (fd_ < 0) {
+      throw FileNotFoundException(filename_);
+    }
+    latch_.reset(new std::recursive_mutex());
+    header_.reset(new CachedHeader());
+    header_->unwritten = 0;
+    header_->write_interval = 0;
+    header_->maps_loaded = false;
+    header_->insert_page_number = Page::INVALID_NUMBER;
+    header_->insert_page_unwritten = 0;
+    header_->read_only = read_only;
+    open_fds_[filename_] = fd_;
+    open_latches_[filename_] = latch_;
+    open_headers_[filename_] = header_;
     open_counts_[filename_] = 1;
+
+    direct_fd_ = -1;
+    if (direct_io) {
+      // Filesystems without O_DIRECT support refuse the open; the file then
+      // stays with buffered I/O.
+      direct_fd_ = ::open(filename_.c_str(), O_RDWR | O_DIRECT);
+      if (direct_fd_ >= 0) {
+        open_direct_fds_[filename_] = direct_fd_;
+      }
+    }
+
+    if (!create_new) {
+      readAt(0 /* pos */, reinterpret_cast<char*>(&header_->header),
+             sizeof(FileHeader));
+    }
+  }
+}
+
+void File::map() {
+  const int fd = ::open(filename_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw FileNotFoundException(filename_);
+  }
+  struct stat info;
+  void* addr = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    addr = mmap(NULL, (std::size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  // The mapping keeps the file referenced once the descriptor is closed.
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    return;
+  }
+
+  const std::size_t bytes = (std::size_t) info.st_size;
+  mapping_.reset(static_cast<const char*>(addr), [bytes](const char* start) {
+    munmap(const_cast<char*>(start), bytes);
+  });
+  mapped_bytes_ = bytes;
+}
+
+const Page* File::mappedPage(const PageId page_number) const {
+  if (mapping_ == NULL || page_number == 0) {
+    return NULL;
+  }
+  const std::size_t position = (std::size_t) pagePosition(page_number);
+  if (position + page_size_ > mapped_bytes_) {
+    return NULL;
+  }
+  return reinterpret_cast<const Page*>(mapping_.get() + position);
+}
+
+void File::checkWritable(const PageId page_number) const {
+  if (mapping_ != NULL) {
+    throw InvalidPageException(page_number, filename_);
   }
 }
 
@@ -106,43 +206,329 @@ void File::close() {
 	if(open_counts_[filename_] > 0)
   	--open_counts_[filename_];
 
-  stream_.reset();
+  // The last File object for the file writes back the cached header.  The
+  // file is closed even if that fails.
+  if (open_counts_[filename_] == 0 && header_ != NULL) {
+    try {
+      sync();
+    } catch (...) {
+      detach();
+      throw;
+    }
+  }
+  detach();
+}
+
+void File::detach() {
+  fd_ = -1;
+  latch_.reset();
+  header_.reset();
+  direct_fd_ = -1;
 	assert(open_counts_[filename_] >= 0);
 
   if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
+    DescriptorMap::iterator fd = open_direct_fds_.find(filename_);
+    if (fd != open_direct_fds_.end()) {
+      ::close(fd->second);
+      open_direct_fds_.erase(fd);
+    }
+    DescriptorMap::iterator buffered_fd = open_fds_.find(filename_);
+    if (buffered_fd != open_fds_.end()) {
+      ::close(buffered_fd->second);
+      open_fds_.erase(buffered_fd);
+    }
+    open_latches_.erase(filename_);
+    open_headers_.erase(filename_);
     open_counts_.erase(filename_);
   }
 }
 
 FileHeader File::readHeader() const {
-  FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
-  return header;
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  return header_->header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  header_->header = header;
+  ++header_->unwritten;
+  if (header_->write_interval > 0 &&
+      header_->unwritten >= header_->write_interval) {
+    sync();
+  }
+}
+
+void File::sync() {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  writeInsertPage();
+  const std::size_t words_per_map = pages_per_map_ / 64;
+  for (std::size_t map = 0; map < header_->dirty_maps.size(); ++map) {
+    if (header_->dirty_maps[map]) {
+      writeAt(mapPosition(map), reinterpret_cast<const char*>(
+                  &header_->used_pages[map * words_per_map]), page_size_);
+      header_->dirty_maps[map] = false;
+    }
+  }
+  // Free-space map pages follow the bitmap page of their group.
+  for (std::size_t i = 0; i < header_->dirty_free_space.size(); ++i) {
+    if (header_->dirty_free_space[i]) {
+      const std::size_t map = i / (map_pages_ - 1);
+      writeAt(mapPosition(map) + (std::streamoff) ((1 + i % (map_pages_ - 1)) * page_size_),
+              reinterpret_cast<const char*>(&header_->free_space[i * page_size_]),
+              page_size_);
+      header_->dirty_free_space[i] = false;
+    }
+  }
+  if (header_->unwritten > 0) {
+    writeAt(0 /* pos */, reinterpret_cast<const char*>(&header_->header),
+            sizeof(FileHeader));
+    header_->unwritten = 0;
+  }
+}
+
+void File::writeInsertPage() {
+  const PageId page_number = header_->insert_page_number;
+  if (page_number != Page::INVALID_NUMBER) {
+    writeAt(pagePosition(page_number),
+            reinterpret_cast<const char*>(&header_->insert_page.header_),
+            Page::SIZE);
+    header_->insert_page_number = Page::INVALID_NUMBER;
+  }
+}
+
+void File::setHeaderWriteInterval(const std::uint32_t changes) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  header_->write_interval = changes;
+  if (changes > 0 && header_->unwritten >= changes) {
+    sync();
+  }
+}
+
+/**
+ * Block-aligned scratch buffer for direct I/O, zero-filled.
+ */
+static std::unique_ptr<char, void (*)(void*)> alignedBuffer(
+    const std::size_t alignment, const std::size_t length) {
+  void* buffer = NULL;
+  if (posix_memalign(&buffer, alignment, length) != 0) {
+    throw std::bad_alloc();
+  }
+  std::memset(buffer, 0, length);
+  return std::unique_ptr<char, void (*)(void*)>(static_cast<char*>(buffer),
+                                                std::free);
+}
+
+/**
+ * Reads until length bytes are in or the end of the file is reached, retrying
+ * reads interrupted by a signal, and returns the number of bytes read.
+ */
+static std::size_t readFully(const int fd, char* data, const std::size_t length,
+                             const off_t offset, const std::string& filename) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t n = ::pread(fd, data + done, length - done, offset + done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename, errno);
+    }
+    if (n == 0) {
+      break;
+    }
+    done += n;
+  }
+  return done;
 }
 
+static void writeFully(const int fd, const char* data, const std::size_t length,
+                       const off_t offset, const std::string& filename) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t n = ::pwrite(fd, data + done, length - done, offset + done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename, errno);
+    }
+    if (n == 0) {
+      throw FileIOException(filename, EIO);
+    }
+    done += n;
+  }
+}
 
+/**
+ * Reads or writes consecutive buffers with preadv or pwritev, in batches of
+ * at most IOV_MAX, until all are done or, reading, the end of the file is
+ * reached.  Returns the number of bytes transferred.
+ */
+static std::size_t transferFully(const int fd, std::vector<struct iovec>& buffers,
+                                 off_t offset, const bool write,
+                                 const std::string& filename) {
+  std::size_t transferred = 0;
+  std::size_t first = 0;
+  while (first < buffers.size()) {
+    const int count = (int) std::min<std::size_t>(buffers.size() - first, IOV_MAX);
+    const ssize_t n = write ? ::pwritev(fd, &buffers[first], count, offset)
+                            : ::preadv(fd, &buffers[first], count, offset);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename, errno);
+    }
+    if (n == 0) {
+      if (write) {
+        throw FileIOException(filename, EIO);
+      }
+      break;
+    }
+    offset += n;
+    transferred += n;
+    // Skip the buffers done, and the part of a buffer done, after a short transfer.
+    std::size_t done = n;
+    while (first < buffers.size() && done >= buffers[first].iov_len) {
+      done -= buffers[first].iov_len;
+      ++first;
+    }
+    if (done > 0) {
+      buffers[first].iov_base = static_cast<char*>(buffers[first].iov_base) + done;
+      buffers[first].iov_len -= done;
+    }
+  }
+  return transferred;
+}
 
+void File::readAt(const std::streampos position, char* data,
+                  const std::size_t length) const {
+  if (readUpTo(position, data, length) < length) {
+    throw FileIOException(filename_, 0);
+  }
+}
 
+std::size_t File::readUpTo(const std::streampos position, char* data,
+                           const std::size_t length) const {
+  if (direct_fd_ < 0) {
+    return readFully(fd_, data, length, position, filename_);
+  }
 
-PageFile PageFile::create(const std::string& filename) {
-  return PageFile(filename, true /* create_new */);
+  const off_t start = position;
+  const off_t first = start / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+  const off_t last = (start + length + DIRECT_IO_ALIGNMENT - 1) /
+                     DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+  std::unique_ptr<char, void (*)(void*)> blocks =
+      alignedBuffer(DIRECT_IO_ALIGNMENT, last - first);
+  const std::size_t read =
+      readFully(direct_fd_, blocks.get(), last - first, first, filename_);
+  const std::size_t available =
+      std::min<std::size_t>(length, std::max<off_t>(0, (off_t) read - (start - first)));
+  std::memcpy(data, blocks.get() + (start - first), available);
+  return available;
 }
 
-PageFile PageFile::open(const std::string& filename) {
-  return PageFile(filename, false /* create_new */);
+void File::writeAt(const std::streampos position, const char* data,
+                   const std::size_t length) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  if (direct_fd_ < 0) {
+    writeFully(fd_, data, length, position, filename_);
+    return;
+  }
+
+  const off_t start = position;
+  const off_t end = start + length;
+  const off_t first = start / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+  const off_t last = (end + DIRECT_IO_ALIGNMENT - 1) /
+                     DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+  std::unique_ptr<char, void (*)(void*)> blocks =
+      alignedBuffer(DIRECT_IO_ALIGNMENT, last - first);
+
+  // Keep whatever else lives in the blocks at either end of the range.  They
+  // may lie past the end of the file, which leaves them zero.
+  if (start != first) {
+    readFully(direct_fd_, blocks.get(), DIRECT_IO_ALIGNMENT, first, filename_);
+  }
+  if (end != last && (start == first || last - first > (off_t) DIRECT_IO_ALIGNMENT)) {
+    readFully(direct_fd_, blocks.get() + (last - first - DIRECT_IO_ALIGNMENT),
+              DIRECT_IO_ALIGNMENT, last - DIRECT_IO_ALIGNMENT, filename_);
+  }
+  std::memcpy(blocks.get() + (start - first), data, length);
+
+  struct stat status;
+  if (::fstat(direct_fd_, &status) != 0) {
+    throw FileIOException(filename_, errno);
+  }
+  writeFully(direct_fd_, blocks.get(), last - first, first, filename_);
+  // Do not leave the padding of the last block behind the end of the file.
+  if (last > end && last > status.st_size &&
+      ::ftruncate(direct_fd_, std::max<off_t>(status.st_size, end)) != 0) {
+    throw FileIOException(filename_, errno);
+  }
+}
+
+void File::readPagesAt(const std::streampos position,
+                       const std::vector<char*>& pages) const {
+  if (direct_fd_ >= 0) {
+    std::vector<char> run(pages.size() * Page::SIZE);
+    readAt(position, &run[0], run.size());
+    for (std::size_t i = 0; i < pages.size(); i++) {
+      std::copy(&run[i * Page::SIZE], &run[i * Page::SIZE] + Page::SIZE, pages[i]);
+    }
+    return;
+  }
+  std::vector<struct iovec> buffers(pages.size());
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    buffers[i].iov_base = pages[i];
+    buffers[i].iov_len = Page::SIZE;
+  }
+  if (transferFully(fd_, buffers, position, false /* write */, filename_) <
+      pages.size() * Page::SIZE) {
+    throw FileIOException(filename_, 0);
+  }
 }
 
-PageFile::PageFile(const std::string& name, const bool create_new)
-: File(name, create_new)
+void File::writePagesAt(const std::streampos position,
+                        const std::vector<const char*>& pages) {
+  if (direct_fd_ >= 0) {
+    std::vector<char> run(pages.size() * Page::SIZE);
+    for (std::size_t i = 0; i < pages.size(); i++) {
+      std::copy(pages[i], pages[i] + Page::SIZE, &run[i * Page::SIZE]);
+    }
+    writeAt(position, &run[0], run.size());
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  std::vector<struct iovec> buffers(pages.size());
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    buffers[i].iov_base = const_cast<char*>(pages[i]);
+    buffers[i].iov_len = Page::SIZE;
+  }
+  transferFully(fd_, buffers, position, true /* write */, filename_);
+}
+
+
+
+
+
+PageFile PageFile::create(const std::string& filename, const bool direct_io) {
+  return PageFile(filename, true /* create_new */, direct_io);
+}
+
+PageFile PageFile::open(const std::string& filename, const bool direct_io) {
+  return PageFile(filename, false /* create_new */, direct_io);
+}
+
+const std::uint32_t PageFile::PAGES_PER_MAP;
+const std::uint32_t PageFile::FREE_SPACE_MAP_PAGES;
+const std::size_t PageFile::FREE_SPACE_UNIT;
+
+PageFile::PageFile(const std::string& name, const bool create_new,
+                   const bool direct_io)
+: File(name, create_new, direct_io)
 {
+  pages_per_map_ = PAGES_PER_MAP;
+  map_pages_ = 1 + FREE_SPACE_MAP_PAGES;
 }
 
 PageFile::~PageFile() {
@@ -151,6 +537,8 @@ PageFile::~PageFile() {
 PageFile::PageFile(const PageFile& other)
 : File(other.filename_, false /* create_new */)
 {
+  pages_per_map_ = PAGES_PER_MAP;
+  map_pages_ = 1 + FREE_SPACE_MAP_PAGES;
 }
 
 PageFile& PageFile::operator=(const PageFile& rhs) {
@@ -158,80 +546,61 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
   // same file.
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
+  page_size_ = rhs.page_size_;
+  pages_per_map_ = rhs.pages_per_map_;
+  map_pages_ = rhs.map_pages_;
   openIfNeeded(false /* create_new */);
   return *this;
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  loadMaps();
   FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-		new_page_number = new_page.page_number();
-    header.first_free_page = new_page.next_page_number();
+    // Reuse the lowest numbered free page, which keeps the file compact.
+    new_page_number = header.first_free_page;
     --header.num_free_pages;
-
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
-    }
-
-    assert((header.num_free_pages == 0) ==
-           (header.first_free_page == Page::INVALID_NUMBER));
-  }
-	else
-	{
-    new_page.set_page_number(header.num_pages);
-		new_page_number = new_page.page_number();
-
-    if (header.first_used_page == Page::INVALID_NUMBER)
-		{
-      header.first_used_page = new_page.page_number();
-    }
-		else
-		{
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
-    }
+    header.first_free_page = (header.num_free_pages > 0)
+        ? nextFreePage(new_page_number + 1, header)
+        : Page::INVALID_NUMBER;
+  } else {
+    new_page_number = header.num_pages;
     ++header.num_pages;
   }
+  new_page.set_page_number(new_page_number);
+
+  // Link the new page in after the used page before it, so that the used list
+  // stays in page order.  A page added at the end goes after the tail.
+  PageId previous_page_number = header.last_used_page;
+  if (previous_page_number == Page::INVALID_NUMBER ||
+      previous_page_number > new_page_number) {
+    previous_page_number = previousUsedPage(new_page_number);
+  }
+  PageHeader previous_header;
+  if (previous_page_number == Page::INVALID_NUMBER) {
+    new_page.set_next_page_number(header.first_used_page);
+    header.first_used_page = new_page_number;
+  } else {
+    previous_header = readPageHeader(previous_page_number);
+    new_page.set_next_page_number(previous_header.next_page_number);
+    previous_header.next_page_number = new_page_number;
+  }
+  if (new_page.next_page_number() == Page::INVALID_NUMBER) {
+    header.last_used_page = new_page_number;
+  }
+
   writePage(new_page_number, new_page.header_, new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page.header_, existing_page);
+  if (previous_page_number != Page::INVALID_NUMBER) {
+    writePageHeader(previous_page_number, previous_header);
   }
+  markUsed(new_page_number, true);
+  setFreeSpace(new_page_number, new_page.getFreeSpace());
   writeHeader(header);
 
+  assert((header.num_free_pages == 0) ==
+         (header.first_free_page == Page::INVALID_NUMBER));
   return new_page;
 }
 
@@ -245,11 +614,52 @@ Page PageFile::readPage(const PageId page_number) const {
 	return readPage(page_number, false /* allow_free */);
 }
 
+void PageFile::readPages(const PageId first_page_number,
+                         const std::vector<Page*>& pages) const {
+  if (pages.empty()) {
+    return;
+  }
+  FileHeader header = readHeader();
+  if (first_page_number + pages.size() > header.num_pages) {
+    throw InvalidPageException(std::max(first_page_number, header.num_pages),
+                               filename_);
+  }
+
+  std::unique_lock<std::recursive_mutex> guard =
+      lockIfHeld(first_page_number, pages.size());
+  // A map page interrupts the run on disk after every PAGES_PER_MAP pages.
+  for (std::size_t done = 0; done < pages.size(); ) {
+    const PageId page_number = first_page_number + done;
+    const std::size_t count = std::min<std::size_t>(
+        pages.size() - done, PAGES_PER_MAP - (page_number - 1) % PAGES_PER_MAP);
+    std::vector<char*> buffers(count);
+    for (std::size_t i = 0; i < count; i++) {
+      buffers[i] = reinterpret_cast<char*>(&pages[done + i]->header_);
+    }
+    readPagesAt(pagePosition(page_number), buffers);
+    done += count;
+  }
+  if (guard.owns_lock()) {
+    const PageId held = header_->insert_page_number;
+    if (held >= first_page_number && held < first_page_number + pages.size()) {
+      *pages[held - first_page_number] = header_->insert_page;
+    }
+  }
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    if (!pages[i]->isUsed()) {
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+  }
+}
+
 Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
+  std::unique_lock<std::recursive_mutex> guard = lockIfHeld(page_number, 1);
+  if (guard.owns_lock() && header_->insert_page_number == page_number) {
+    return header_->insert_page;
+  }
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+  readAt(pagePosition(page_number), reinterpret_cast<char*>(&page.header_),
+         Page::SIZE);
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
@@ -258,6 +668,7 @@ Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
 	PageHeader header = readPageHeader(new_page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
 	{
@@ -271,39 +682,145 @@ void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 	header = new_page.header_;
 	header.next_page_number = next_page_number;
 	writePage(new_page_number, header, new_page);
+	loadMaps();
+	setFreeSpace(new_page_number, new_page.getFreeSpace());
+}
+
+void PageFile::writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) {
+  if (pages.empty()) {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  // The run is read back from disk below, so write the held page out first.
+  const PageId held = header_->insert_page_number;
+  if (held >= first_page_number && held < first_page_number + pages.size()) {
+    writeInsertPage();
+  }
+  // A map page interrupts the run on disk after every PAGES_PER_MAP pages.
+  for (std::size_t done = 0; done < pages.size(); ) {
+    const PageId page_number = first_page_number + done;
+    const std::size_t count = std::min<std::size_t>(
+        pages.size() - done, PAGES_PER_MAP - (page_number - 1) % PAGES_PER_MAP);
+    // Read the run as it is on disk so that every page keeps its next page
+    // pointer, then lay the new contents over it and write it back in one go.
+    std::vector<char> run(count * Page::SIZE);
+    readAt(pagePosition(page_number), &run[0], run.size());
+    for (std::size_t i = 0; i < count; i++) {
+      PageHeader* header = reinterpret_cast<PageHeader*>(&run[i * Page::SIZE]);
+      if (header->current_page_number == Page::INVALID_NUMBER) {
+        // Page has been deleted since it was read.
+        throw InvalidPageException(page_number + i, filename_);
+      }
+      const PageId next_page_number = header->next_page_number;
+      *header = pages[done + i]->header_;
+      header->next_page_number = next_page_number;
+      std::copy(&pages[done + i]->data_[0],
+                &pages[done + i]->data_[0] + Page::DATA_SIZE,
+                &run[i * Page::SIZE + sizeof(PageHeader)]);
+    }
+    writeAt(pagePosition(page_number), &run[0], run.size());
+    done += count;
+  }
+  loadMaps();
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    setFreeSpace(first_page_number + i, pages[i]->getFreeSpace());
+  }
 }
 
 void PageFile::deletePage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  loadMaps();
   FileHeader header = readHeader();
 
   Page existing_page = readPage(page_number);
-  Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
+  // The bitmap gives the used page before this one, which is the page that
+  // points to it unless it is the head of the used list.
+  const PageId previous_page_number = previousUsedPage(page_number);
+  if (previous_page_number == Page::INVALID_NUMBER) {
     header.first_used_page = existing_page.next_page_number();
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    PageHeader previous_header = readPageHeader(previous_page_number);
+    previous_header.next_page_number = existing_page.next_page_number();
+    writePageHeader(previous_page_number, previous_header);
+  }
+  if (page_number == header.last_used_page) {
+    header.last_used_page = previous_page_number;
   }
-  // Clear the page and add it to the head of the free list.
+  // Clear the page and mark it free in the bitmap.
   existing_page.initialize();
-  existing_page.set_next_page_number(header.first_free_page);
-  header.first_free_page = page_number;
-  ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page.header_, previous_page);
+  markUsed(page_number, false);
+  setFreeSpace(page_number, 0);
+  if (header.num_free_pages == 0 || page_number < header.first_free_page) {
+    header.first_free_page = page_number;
   }
+  ++header.num_free_pages;
   writePage(page_number, existing_page.header_, existing_page);
   writeHeader(header);
 }
 
+RecordId PageFile::insertRecord(const std::string& record_data) {
+  return insertRecords(std::vector<std::string>(1, record_data)).front();
+}
+
+std::vector<RecordId> PageFile::insertRecords(
+    const std::vector<std::string>& records) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  loadMaps();
+  Page& held_page = header_->insert_page;
+  std::vector<RecordId> record_ids;
+  record_ids.reserve(records.size());
+  std::size_t next = 0;
+  while (next < records.size()) {
+    if (header_->insert_page_number == Page::INVALID_NUMBER ||
+        !held_page.hasSpaceForRecord(records[next])) {
+      // Ask for room for a new slot as well; the page may have none to reuse.
+      const std::size_t bytes = records[next].length() + sizeof(PageSlot);
+      if (bytes > Page::DATA_SIZE) {
+        throw InsufficientSpaceException(Page::INVALID_NUMBER,
+                                         records[next].length(), Page::DATA_SIZE);
+      }
+      PageId page_number = findFreeSpace(bytes);
+      Page page;
+      if (page_number != Page::INVALID_NUMBER) {
+        page = readPage(page_number);
+        if (!page.hasSpaceForRecord(records[next])) {
+          // The map was out of date for this page; correct it and look again.
+          setFreeSpace(page_number, page.getFreeSpace());
+          continue;
+        }
+      } else {
+        // The map rounds free space down, so the last page, which a load
+        // fills, may still have room for a small record.
+        const PageId last_page_number = readHeader().last_used_page;
+        if (last_page_number != Page::INVALID_NUMBER &&
+            last_page_number != header_->insert_page_number) {
+          page = readPage(last_page_number);
+          if (page.hasSpaceForRecord(records[next])) {
+            page_number = last_page_number;
+          }
+        }
+        if (page_number == Page::INVALID_NUMBER) {
+          page = allocatePage(page_number);
+        }
+      }
+      writeInsertPage();
+      held_page = page;
+      header_->insert_page_number = page_number;
+      header_->insert_page_unwritten = 0;
+    }
+    record_ids.push_back(held_page.insertRecord(records[next]));
+    setFreeSpace(header_->insert_page_number, held_page.getFreeSpace());
+    ++next;
+    // The held page is written back as lazily as the header.
+    if (header_->write_interval > 0 &&
+        ++header_->insert_page_unwritten >= header_->write_interval) {
+      writeInsertPage();
+    }
+  }
+  return record_ids;
+}
+
 FileIterator PageFile::begin() {
   const FileHeader& header = readHeader();
   return FileIterator(this, header.first_used_page);
@@ -315,55 +832,235 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  // The whole page is replaced, so a held copy of it is out of date.
+  if (header_->insert_page_number == page_number) {
+    header_->insert_page_number = Page::INVALID_NUMBER;
+  }
+  // Header and data go out together, as one write.
+  Page page(new_page);
+  page.header_ = header;
+  writeAt(pagePosition(page_number), reinterpret_cast<const char*>(&page.header_),
+          Page::SIZE);
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
+  std::unique_lock<std::recursive_mutex> guard = lockIfHeld(page_number, 1);
+  if (guard.owns_lock() && header_->insert_page_number == page_number) {
+    return header_->insert_page.header_;
+  }
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  readAt(pagePosition(page_number), reinterpret_cast<char*>(&header),
+         sizeof(PageHeader));
   return header;
 }
 
+std::unique_lock<std::recursive_mutex> PageFile::lockIfHeld(
+    const PageId first_page_number, const std::size_t count) const {
+  // Without the held page among them the pages on disk are current, since a
+  // page is written before it stops being held.
+  const PageId held = header_->insert_page_number;
+  if (held >= first_page_number && held < first_page_number + count) {
+    return std::unique_lock<std::recursive_mutex>(*latch_);
+  }
+  return std::unique_lock<std::recursive_mutex>(*latch_, std::defer_lock);
+}
+
+void PageFile::writePageHeader(const PageId page_number,
+                               const PageHeader& header) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  if (header_->insert_page_number == page_number) {
+    header_->insert_page.header_ = header;
+    return;
+  }
+  writeAt(pagePosition(page_number), reinterpret_cast<const char*>(&header),
+          sizeof(PageHeader));
+}
+
+void PageFile::loadMaps() {
+  if (header_->maps_loaded) {
+    return;
+  }
+  const FileHeader& header = header_->header;
+  const std::size_t words_per_map = PAGES_PER_MAP / 64;
+  const std::size_t num_maps =
+      (header.num_pages - 1 + PAGES_PER_MAP - 1) / PAGES_PER_MAP;
+  header_->used_pages.clear();
+  header_->dirty_maps.clear();
+  header_->free_space.clear();
+  header_->dirty_free_space.clear();
+  header_->free_space_hints.assign(256, 0);
+  if (num_maps > 0) {
+    growMaps(num_maps - 1);
+  }
+  // The maps of a group never synced may lie past the end of the file; what
+  // is missing is left zero, as the maps of unused pages.
+  for (std::size_t map = 0; map < num_maps; ++map) {
+    readUpTo(mapPosition(map),
+             reinterpret_cast<char*>(&header_->used_pages[map * words_per_map]),
+             Page::SIZE);
+    readUpTo(mapPosition(map) + (std::streamoff) Page::SIZE,
+             reinterpret_cast<char*>(&header_->free_space[map * PAGES_PER_MAP]),
+             PAGES_PER_MAP);
+  }
+  header_->maps_loaded = true;
+}
+
+void PageFile::growMaps(const std::size_t map_number) {
+  if (map_number < header_->dirty_maps.size()) {
+    return;
+  }
+  // The map pages of a new group are written at the next sync.
+  const std::size_t num_maps = map_number + 1;
+  header_->used_pages.resize(num_maps * (PAGES_PER_MAP / 64), 0);
+  header_->dirty_maps.resize(num_maps, false);
+  header_->free_space.resize(num_maps * PAGES_PER_MAP, 0);
+  header_->dirty_free_space.resize(num_maps * FREE_SPACE_MAP_PAGES, false);
+}
+
+void PageFile::setFreeSpace(const PageId page_number,
+                            const std::size_t free_bytes) {
+  const std::size_t index = page_number - 1;
+  growMaps(index / PAGES_PER_MAP);
+  const std::uint8_t steps =
+      (std::uint8_t) std::min<std::size_t>(free_bytes / FREE_SPACE_UNIT, 255);
+  std::uint8_t& entry = header_->free_space[index];
+  if (entry == steps) {
+    return;
+  }
+  // The page now has room it did not have, so searches for that much must
+  // start no later than at it.
+  std::vector<std::uint32_t>& hints = header_->free_space_hints;
+  for (std::size_t wanted = entry + 1; wanted <= steps; ++wanted) {
+    hints[wanted] = std::min<std::uint32_t>(hints[wanted], index);
+  }
+  entry = steps;
+  header_->dirty_free_space[index / Page::SIZE] = true;
+}
+
+PageId PageFile::findFreeSpace(const std::size_t bytes) {
+  const std::size_t wanted = (bytes + FREE_SPACE_UNIT - 1) / FREE_SPACE_UNIT;
+  if (wanted > 255) {
+    return Page::INVALID_NUMBER;
+  }
+  const std::vector<std::uint8_t>& free_space = header_->free_space;
+  const std::size_t end =
+      std::min<std::size_t>(free_space.size(), header_->header.num_pages - 1);
+  // Pages below the hint have less room; each search moves the hint past the
+  // pages it rules out, so searches cost O(1) amortised.
+  std::uint32_t& hint = header_->free_space_hints[wanted];
+  std::size_t index = hint;
+  while (index < end && free_space[index] < wanted) {
+    ++index;
+  }
+  hint = (std::uint32_t) index;
+  return (index < end) ? (PageId) index + 1 : Page::INVALID_NUMBER;
+}
+
+void PageFile::markUsed(const PageId page_number, const bool used) {
+  std::vector<std::uint64_t>& used_pages = header_->used_pages;
+  const std::size_t bit = page_number - 1;
+  const std::size_t map = bit / PAGES_PER_MAP;
+  growMaps(map);
+  if (used) {
+    used_pages[bit / 64] |= (std::uint64_t) 1 << (bit % 64);
+  } else {
+    used_pages[bit / 64] &= ~((std::uint64_t) 1 << (bit % 64));
+  }
+  header_->dirty_maps[map] = true;
+}
+
+PageId PageFile::previousUsedPage(const PageId page_number) const {
+  const std::vector<std::uint64_t>& used_pages = header_->used_pages;
+  const std::size_t bit = page_number - 1;
+  std::size_t word = bit / 64;
+  std::uint64_t bits = 0;
+  if (word < used_pages.size()) {
+    bits = used_pages[word] & (((std::uint64_t) 1 << (bit % 64)) - 1);
+  } else {
+    word = used_pages.size();
+  }
+  while (bits == 0) {
+    if (word == 0) {
+      return Page::INVALID_NUMBER;
+    }
+    bits = used_pages[--word];
+  }
+  return (PageId) (word * 64 + (63 - __builtin_clzll(bits))) + 1;
+}
+
+PageId PageFile::nextFreePage(const PageId page_number,
+                              const FileHeader& header) const {
+  const std::vector<std::uint64_t>& used_pages = header_->used_pages;
+  const std::size_t end = header.num_pages - 1;
+  std::size_t bit = page_number - 1;
+  while (bit < end) {
+    const std::size_t word = bit / 64;
+    std::uint64_t bits = (word < used_pages.size()) ? ~used_pages[word] : ~0ULL;
+    bits &= ~0ULL << (bit % 64);
+    if (bits != 0) {
+      bit = word * 64 + __builtin_ctzll(bits);
+      return (bit < end) ? (PageId) bit + 1 : Page::INVALID_NUMBER;
+    }
+    bit = (word + 1) * 64;
+  }
+  return Page::INVALID_NUMBER;
+}
+
 
 
 
-BlobFile BlobFile::create(const std::string& filename) {
-  return BlobFile(filename, true /* create_new */);
+BlobFile BlobFile::create(const std::string& filename, const bool direct_io,
+                          const std::size_t page_size) {
+  return BlobFile(filename, true /* create_new */, direct_io, page_size);
 }
 
-BlobFile BlobFile::open(const std::string& filename) {
-  return BlobFile(filename, false /* create_new */);
+BlobFile BlobFile::open(const std::string& filename, const bool direct_io) {
+  return BlobFile(filename, false /* create_new */, direct_io);
 }
 
-BlobFile::BlobFile(const std::string& name, const bool create_new)
-: File(name, create_new) {
+BlobFile BlobFile::openMapped(const std::string& filename) {
+  BlobFile file(filename, false /* create_new */, false /* direct_io */,
+                Page::SIZE, true /* read_only */);
+  file.map();
+  return file;
+}
+
+BlobFile::BlobFile(const std::string& name, const bool create_new,
+                   const bool direct_io, const std::size_t page_size,
+                   const bool read_only)
+: File(name, create_new, direct_io, page_size, read_only) {
 }
 
 BlobFile::~BlobFile() {
 }
 
 BlobFile::BlobFile(const BlobFile& other)
-: File(other.filename_, false /* create_new */)
+: File(other.filename_, false /* create_new */, false /* direct_io */,
+       Page::SIZE, other.header_ && other.header_->read_only)
 {
+  mapping_ = other.mapping_;
+  mapped_bytes_ = other.mapped_bytes_;
 }
 
 BlobFile& BlobFile::operator=(const BlobFile& rhs) {
   // This accounts for self-assignment and assignment of a File object for the
   // same file.
+  const bool read_only = rhs.header_ && rhs.header_->read_only;
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
-  openIfNeeded(false /* create_new */);
+  page_size_ = rhs.page_size_;
+  mapping_ = rhs.mapping_;
+  mapped_bytes_ = rhs.mapped_bytes_;
+  openIfNeeded(false /* create_new */, false /* direct_io */, read_only);
   return *this;
 }
 
 Page BlobFile::allocatePage(PageId &new_page_number) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   FileHeader header = readHeader();
 	Page new_page;
+	checkWritable(header.num_pages);
 
 	new_page_number = header.num_pages;
 
@@ -373,23 +1070,67 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
 
 	++header.num_pages;
 
-	writePage(new_page_number, new_page);
+	// a larger page is written out whole so that the file covers it
+	if (pageSpan() == 1) {
+		writePage(new_page_number, new_page);
+	} else {
+		std::vector<const Page*> span(pageSpan(), &new_page);
+		writePages(new_page_number, span);
+	}
 	writeHeader(header);
 
 	return new_page;
 }
 
 Page BlobFile::readPage(const PageId page_number) const {
+	const Page* mapped_page = mappedPage(page_number);
+	if (mapped_page != NULL) {
+		return *mapped_page;
+	}
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readAt(pagePosition(page_number), reinterpret_cast<char*>(&page), Page::SIZE);
 	return page;
 }
 
+void BlobFile::readPages(const PageId first_page_number,
+                         const std::vector<Page*>& pages) const {
+  if (pages.empty()) {
+    return;
+  }
+  const std::size_t position = (std::size_t) pagePosition(first_page_number);
+  if (mapping_ != NULL && position + pages.size() * Page::SIZE <= mapped_bytes_) {
+    for (std::size_t i = 0; i < pages.size(); i++) {
+      std::copy(mapping_.get() + position + i * Page::SIZE,
+                mapping_.get() + position + (i + 1) * Page::SIZE,
+                reinterpret_cast<char*>(pages[i]));
+    }
+    return;
+  }
+  std::vector<char*> buffers(pages.size());
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    buffers[i] = reinterpret_cast<char*>(pages[i]);
+  }
+  readPagesAt(pagePosition(first_page_number), buffers);
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+  checkWritable(new_page_number);
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+	writeAt(pagePosition(new_page_number), reinterpret_cast<const char*>(&new_page),
+	        Page::SIZE);
+}
+
+void BlobFile::writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) {
+  if (pages.empty()) {
+    return;
+  }
+  checkWritable(first_page_number);
+  std::vector<const char*> buffers(pages.size());
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    buffers[i] = reinterpret_cast<const char*>(pages[i]);
+  }
+  writePagesAt(pagePosition(first_page_number), buffers);
 }
 
 //delePage should not be called for a blob_file, not supported
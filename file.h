@@ -7,10 +7,13 @@
 
 #pragma once
 
-#include <fstream>
+#include <atomic>
+#include <ios>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "page.h"
 
@@ -38,10 +41,20 @@ struct FileHeader {
   PageId num_free_pages;
 
   /**
-   * Page number of the first free (allocated but unused) page in the file.
+   * Lowest page number of the free (allocated but unused) pages in the file.
    */
   PageId first_free_page;
 
+  /**
+   * Size in bytes of the pages of the file, a power of two multiple of Page::SIZE.
+   */
+  std::uint32_t page_size;
+
+  /**
+   * Page number of the last used page in the file, the tail of the used list.
+   */
+  PageId last_used_page;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,7 +65,9 @@ struct FileHeader {
     return num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        page_size == rhs.page_size &&
+        last_used_page == rhs.last_used_page;
   }
 };
 
@@ -60,15 +75,38 @@ struct FileHeader {
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
+ * The File class wraps a descriptor of an underlying file on disk.  Files contain
  * fixed-sized pages, and they never deallocate space (though they do reuse
  * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * underlying file, they will share the descriptor.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the open_fds_ map) and just returns a file object with
+ * the already opened descriptor for the file without actually opening the UNIX file again. 
+ *
+ * Pages and the header are read and written with positional I/O (pread, pwrite
+ * and their vectored forms), so there is no file offset to share and readers
+ * need no latch.  The file header is read once, when the file is first opened,
+ * and kept in memory with the descriptor; changes to it are written back by
+ * sync, when the last File object for the file is closed, and otherwise as
+ * setHeaderWriteInterval asks.  Writes, and compound operations such as allocatePage, are
+ * serialized by a latch which is shared, like the descriptor, by every File
+ * object for the same file, so several threads may read and write pages of one
+ * file through the buffer manager.
  *
- * @warning This class is not threadsafe.
+ * A file may be opened for direct I/O, in which case pages are read and written
+ * with O_DIRECT and bypass the kernel page cache, leaving the buffer manager as
+ * the only cache of the file.  Pages do not start on block boundaries (the file
+ * header comes first), so every transfer covers the enclosing blocks, and a
+ * write reads back the partial blocks at either end of it first.  Whether a
+ * file uses direct I/O is decided by the File object which opens it first.
+ *
+ * The pages of a file are Page::SIZE bytes unless it was created with a larger
+ * page size, which is recorded in its header.  A larger page spans pageSpan()
+ * consecutive Page objects in memory: readPages and writePages then take
+ * pageSpan() entries per page, while readPage, writePage and allocatePage only
+ * deal with the first Page::SIZE bytes of a page.
+ *
+ * @warning Opening, closing and removing files is not threadsafe.
  */
 
 
@@ -80,12 +118,20 @@ class File {
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the kernel page cache, if the file is
+   *                    not open already and its filesystem supports it.
+   * @param page_size   Size of the pages of a new file, rounded up by
+   *                    Page::sizeClassOf; an existing file keeps its own.
+   * @param read_only   Whether to open an existing file read-only.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  FileOpenException       If read_only is false and the file is
+   *                                  open read-only already.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new, const bool direct_io = false,
+       const std::size_t page_size = Page::SIZE, const bool read_only = false);
 
   /**
    * Deletes an existing file.
@@ -113,7 +159,8 @@ class File {
 
   /**
    * Destructor that automatically closes the underlying file if no other
-   * File objects are using it.
+   * File objects are using it.  Errors writing back the header are reported
+   * on std::cerr rather than thrown.
    */
   virtual ~File();
 
@@ -134,6 +181,18 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads a run of existing pages at consecutive page numbers starting at
+   * first_page_number, with a single read of the underlying file.
+   *
+   * @param first_page_number Number of page to read into pages[0].
+   * @param pages             Where to store the pages read.
+   * @throws  InvalidPageException  If one of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  virtual void readPages(const PageId first_page_number,
+                         const std::vector<Page*>& pages) const = 0;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -144,7 +203,19 @@ class File {
   virtual void writePage(const PageId page_number, const Page& new_page) = 0;
 
   /**
-   * Deletes a page from the file.
+   * Writes a run of pages into the file at consecutive page numbers starting
+   * at first_page_number, with a single write to the underlying file.
+   * No bounds checking is performed.
+   *
+   * @param first_page_number Number of page to replace with pages[0].
+   * @param pages             Pages to write.
+   */
+  virtual void writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) = 0;
+
+  /**
+   * Deletes a page from the file.  The pages after it keep their order in the
+   * used list.
    *
    * @param page_number   Number of page to delete.
    */
@@ -164,6 +235,65 @@ class File {
    */
 	PageId getFirstPageNo();
 
+  /**
+   * Returns the number of pages in the file, the header page included: no
+   * page of the file has a number this high.
+   */
+  PageId numPages() const;
+
+  /**
+   * Returns true if pages of this file bypass the kernel page cache.
+   */
+  bool directIO() const { return direct_fd_ >= 0; }
+
+  /**
+   * Writes the file header, and the allocation bitmap, free-space map and held
+   * insert page of a PageFile, back to disk where they have changed since they
+   * were last written.
+   */
+  void sync();
+
+  /**
+   * Sets how often changes to the cached file header, such as allocating or
+   * deleting a page, are written to disk without waiting for sync or close.
+   * Applies to every File object for the file.
+   *
+   * A record inserted into the page held by PageFile::insertRecord counts as
+   * a change too: once as many have been inserted, the page is written and
+   * no longer held.
+   *
+   * @param changes   Number of changes after which the header is written: 1
+   *                  writes every change through, 0 (the default) waits for
+   *                  sync or close.
+   */
+  void setHeaderWriteInterval(const std::uint32_t changes);
+
+  /**
+   * Returns the size in bytes of the pages of this file.
+   */
+  std::size_t pageSize() const { return page_size_; }
+
+  /**
+   * Returns the number of Page objects a page of this file spans in memory.
+   */
+  std::uint32_t pageSpan() const { return (std::uint32_t) (page_size_ / Page::SIZE); }
+
+  /**
+   * Returns true if the file was opened read-only with its pages mapped into
+   * memory (see BlobFile::openMapped).
+   */
+  bool mapped() const { return mapping_ != NULL; }
+
+  /**
+   * Returns the page with the given number where it lies in the file's mapping.
+   * The memory is read-only; writing to it faults.
+   *
+   * @param page_number   Number of page.
+   * @return  The page, or NULL if the file is not mapped or the page lies
+   *          beyond the end of the file as it was when mapped.
+   */
+  const Page* mappedPage(const PageId page_number) const;
+
  protected:
   /**
    * Returns the position of the page with the given number in the file (as an
@@ -172,104 +302,374 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  std::streampos pagePosition(const PageId page_number) const {
+    std::streamoff index = page_number - 1;
+    if (pages_per_map_ > 0) {
+      // Skip the map pages of this group of pages and of the ones before it.
+      index += (index / pages_per_map_ + 1) * map_pages_;
+    }
+    return sizeof(FileHeader) + index * (std::streamoff) page_size_;
+  }
+
+  /**
+   * Returns the position in the file of the first of the map pages ahead of
+   * the given group of pages_per_map_ pages.
+   *
+   * @param map_number  Number of the group, from 0.
+   * @return  Position of map page in file.
+   */
+  std::streampos mapPosition(const std::size_t map_number) const {
+    return sizeof(FileHeader) + (std::streamoff) map_number *
+        (pages_per_map_ + map_pages_) * page_size_;
   }
 
+  /**
+   * Reads length bytes at the given position of the file.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param data      Where to store the bytes read.
+   * @param length    Number of bytes to read.
+   * @throws  FileIOException   If the read fails or the file ends first.
+   */
+  void readAt(const std::streampos position, char* data, const std::size_t length) const;
+
+  /**
+   * Reads up to length bytes at the given position of the file, stopping at
+   * the end of the file, for callers which expect it there.  Bytes past the
+   * end are left as they were.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param data      Where to store the bytes read.
+   * @param length    Number of bytes to read.
+   * @return  Number of bytes read.
+   * @throws  FileIOException   If the read fails.
+   */
+  std::size_t readUpTo(const std::streampos position, char* data,
+                       const std::size_t length) const;
+
+  /**
+   * Writes length bytes at the given position of the file.
+   * No bounds checking is performed.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param data      Bytes to write.
+   * @param length    Number of bytes to write.
+   * @throws  FileIOException   If the write fails.
+   */
+  void writeAt(const std::streampos position, const char* data, const std::size_t length);
+
+  /**
+   * Reads consecutive Page::SIZE blocks at the given position into separate
+   * buffers, with one preadv unless the file uses direct I/O.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param pages     Where to store each block.
+   * @throws  FileIOException   If the read fails or the file ends first.
+   */
+  void readPagesAt(const std::streampos position, const std::vector<char*>& pages) const;
+
+  /**
+   * Writes separate Page::SIZE buffers as consecutive blocks at the given
+   * position, with one pwritev unless the file uses direct I/O.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param pages     Blocks to write.
+   * @throws  FileIOException   If the write fails.
+   */
+  void writePagesAt(const std::streampos position, const std::vector<const char*>& pages);
+
+  /**
+   * Writes the page held by PageFile::insertRecord, if any, and stops holding
+   * it.  Must be called with the latch held.
+   */
+  void writeInsertPage();
+
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
    *
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the kernel page cache, if the file is
+   *                    not open already and its filesystem supports it.
+   * @param read_only   Whether to open the file read-only, if it is not open
+   *                    already.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
-   *                                  create_new is false.
+   *                                  create_new is false, or cannot be opened.
+   * @throws  FileOpenException       If read_only is false and the file is
+   *                                  open read-only already.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const bool create_new, const bool direct_io = false,
+                    const bool read_only = false);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file descriptor in <fd_>.
    * This method only closes the file if no other File objects exist that access
-   * the same file.
+   * the same file.  The file is closed even if writing back its header fails.
+   *
+   * @throws  FileIOException  If the header or held page cannot be written back
    */
   void close();
 
   /**
-   * Reads the header for this file from disk.
+   * Drops this object's references to the shared descriptor, latch and header,
+   * and closes the descriptor once no File object refers to it.  Called by
+   * close() after the open count is decremented.
+   */
+  void detach();
+
+  /**
+   * Maps the whole file into memory read-only.  If the kernel refuses, the file
+   * stays unmapped and is read through <fd_>.
+   *
+   * @throws  FileNotFoundException   If the file cannot be opened for reading.
+   */
+  void map();
+
+  /**
+   * Throws if the file is mapped, since mapped files are read-only.
+   *
+   * @param page_number   Number of the page about to be written.
+   * @throws  InvalidPageException  If the file is mapped.
+   */
+  void checkWritable(const PageId page_number) const;
+
+  /**
+   * Returns the header for this file, as cached in memory.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Replaces the cached header for this file, writing it to disk if the write
+   * interval says so.
    *
    * @param header  File header to write.
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
+  /**
+   * Header of an opened file as cached in memory, the number of changes to it
+   * not yet written to disk, and how many to allow (0 for no limit).  Guarded
+   * by the file's latch.
+   */
+  struct CachedHeader {
+    FileHeader header;
+    std::uint32_t unwritten;
+    std::uint32_t write_interval;
+
+    /**
+     * Allocation bitmap of a file with map pages, bit n - 1 set when page n is
+     * used, read from the map pages on first use; and which of those have
+     * changed since they were last written.
+     */
+    std::vector<std::uint64_t> used_pages;
+    std::vector<bool> dirty_maps;
+    bool maps_loaded;
+
+    /**
+     * Free-space map of a file with map pages, byte n - 1 holding the free
+     * space of page n in units of PageFile::FREE_SPACE_UNIT, and which of its
+     * pages have changed since they were last written.
+     */
+    std::vector<std::uint8_t> free_space;
+    std::vector<bool> dirty_free_space;
+
+    /**
+     * For each amount of free space in the map, the page index below which no
+     * page has that much.
+     */
+    std::vector<std::uint32_t> free_space_hints;
+
+    /**
+     * Page PageFile::insertRecord inserted into last, held here rather than
+     * written after every record, and its number, or Page::INVALID_NUMBER if
+     * no page is held.  The number may be read without the latch: a page
+     * stops being held only after it has been written.
+     */
+    Page insert_page;
+    std::atomic<PageId> insert_page_number;
+
+    /**
+     * Number of records inserted into the held page since it was read, counted
+     * against write_interval as changes to the header are.
+     */
+    std::uint32_t insert_page_unwritten;
+
+    /**
+     * True if the descriptor shared by the File objects was opened read-only,
+     * by BlobFile::openMapped.
+     */
+    bool read_only;
+  };
+
+  typedef std::map<std::string, std::shared_ptr<std::recursive_mutex> > LatchMap;
+  typedef std::map<std::string, std::shared_ptr<CachedHeader> > HeaderMap;
   typedef std::map<std::string, int> CountMap;
+  typedef std::map<std::string, int> DescriptorMap;
 
   /**
-   * Streams for opened files.
+   * Descriptors of opened files.
    */
-  static StreamMap open_streams_;
+  static DescriptorMap open_fds_;
+
+  /**
+   * Latches serializing writes to opened files.
+   */
+  static LatchMap open_latches_;
+
+  /**
+   * Cached headers of opened files.
+   */
+  static HeaderMap open_headers_;
 
   /**
    * Counts for opened files.
    */
   static CountMap open_counts_;
 
+  /**
+   * Descriptors, opened with O_DIRECT, of opened files using direct I/O.
+   */
+  static DescriptorMap open_direct_fds_;
+
+  /**
+   * Block size direct I/O transfers are aligned to.
+   */
+  static const std::size_t DIRECT_IO_ALIGNMENT = 4096;
+
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Descriptor for underlying filesystem object.
    */
-  std::shared_ptr<std::fstream> stream_;
+  int fd_;
+
+  /**
+   * Latch held while writing the file.  Recursive because compound operations
+   * such as allocatePage are built from the primitive reads and writes.
+   */
+  std::shared_ptr<std::recursive_mutex> latch_;
+
+  /**
+   * Cached header of the underlying file, shared like <fd_>.
+   */
+  std::shared_ptr<CachedHeader> header_;
+
+  /**
+   * Direct I/O descriptor for the underlying filesystem object, or -1 if
+   * pages go through <fd_>.
+   */
+  int direct_fd_;
+
+  /**
+   * Size in bytes of the pages of the file, as recorded in its header.
+   */
+  std::size_t page_size_;
+
+  /**
+   * Number of pages in each group following map pages in the file, or 0 if
+   * the file has no map pages; and the number of map pages ahead of each
+   * group: an allocation bitmap page, then free-space map pages.
+   */
+  std::uint32_t pages_per_map_;
+  std::uint32_t map_pages_;
+
+  /**
+   * Read-only mapping of the whole file, shared by copies of this object and
+   * unmapped with the last of them, or NULL; and its length.
+   */
+  std::shared_ptr<const char> mapping_;
+  std::size_t mapped_bytes_;
 
   friend class FileIterator;
 };
 
+/**
+ * @brief File of pages holding records, linked in page order into a list of
+ *        the used pages.
+ *
+ * Every PAGES_PER_MAP pages are preceded in the file by map pages: one
+ * holding their allocation bitmap, one bit per page, and FREE_SPACE_MAP_PAGES
+ * holding their free-space map, one byte per page.  Map pages have no page
+ * numbers, so pages are still numbered from 1 without gaps.  The maps are
+ * read on first use, kept in memory with the file header and written back
+ * with it.
+ *
+ * The bitmap gives the used page a new page is linked in after, or a deleted
+ * page is unlinked from, and the lowest free page to reuse without walking the
+ * used list, so allocatePage and deletePage take O(1) reads and writes of
+ * pages.  The free-space map, kept up to date by every
+ * write of a page, lets insertRecord find a page with room for a record
+ * without reading any other.
+ *
+ * insertRecord keeps the page it inserted into last in memory, shared by every
+ * PageFile object for the file, and writes it once it moves on to another
+ * page, after as many records as setHeaderWriteInterval allows changes to
+ * the header, or at sync or close.  Reads through a PageFile see the held
+ * page in place of the copy on disk.  Until the page is written, a frame of
+ * the buffer manager already holding it does not see the new records, and a
+ * crash loses them; set a write interval of 1 to write every insert through.
+ */
 class PageFile : public File {
  public:
+  /**
+   * Number of pages whose bits fit on one map page.
+   */
+  static const std::uint32_t PAGES_PER_MAP = Page::SIZE * 8;
+
+  /**
+   * Number of map pages holding the free space of PAGES_PER_MAP pages.
+   */
+  static const std::uint32_t FREE_SPACE_MAP_PAGES = PAGES_PER_MAP / Page::SIZE;
+
+  /**
+   * Bytes of free space each step of the free-space map stands for.
+   */
+  static const std::size_t FREE_SPACE_UNIT = Page::SIZE / 256;
 
   /**
    * Creates a new file.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the kernel page cache.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static PageFile create(const std::string& filename);
+  static PageFile create(const std::string& filename, const bool direct_io = false);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_fds_ map.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the kernel page cache, if the file is
+   *                  not open already.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
-  static PageFile open(const std::string& filename);
+  static PageFile open(const std::string& filename, const bool direct_io = false);
 
   /**
    * Constructs a file object representing a file on the filesystem.
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the kernel page cache, if the file is
+   *                    not open already and its filesystem supports it.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  PageFile(const std::string& name, const bool create_new);
+  PageFile(const std::string& name, const bool create_new, const bool direct_io = false);
 
   /**
    * Copy constructor.
@@ -310,6 +710,18 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads a run of existing pages at consecutive page numbers starting at
+   * first_page_number, with a single read of the underlying file.
+   *
+   * @param first_page_number Number of page to read into pages[0].
+   * @param pages             Where to store the pages read.
+   * @throws  InvalidPageException  If one of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  void readPages(const PageId first_page_number,
+                 const std::vector<Page*>& pages) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -320,12 +732,51 @@ class PageFile : public File {
   void writePage(const PageId page_number, const Page& new_page);
 
   /**
-   * Deletes a page from the file.
+   * Writes a run of pages into the file at consecutive page numbers starting
+   * at first_page_number, with a single write to the underlying file.
+   * As in writePage, each page keeps the next page number it has on disk.
+   * No bounds checking is performed.
+   *
+   * @param first_page_number Number of page to replace with pages[0].
+   * @param pages             Pages to write.
+   */
+  void writePages(const PageId first_page_number,
+                  const std::vector<const Page*>& pages);
+
+  /**
+   * Deletes a page from the file.  The pages after it keep their order in the
+   * used list.
    *
    * @param page_number   Number of page to delete.
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Inserts a record into the page held from the last insert if it has room
+   * for it, else into the lowest numbered used page which the free-space map
+   * says has room, else into the last used page if it has room (the map rounds
+   * free space down), else into a newly allocated page.  The page is held in
+   * memory rather than written; see the class comment.
+   *
+   * @param record_data   Bytes that compose the record.
+   * @return  ID of the newly inserted record.
+   * @throws  InsufficientSpaceException  If the record does not fit even on
+   *                                      an empty page.
+   */
+  RecordId insertRecord(const std::string& record_data);
+
+  /**
+   * Inserts records as insertRecord does, one after another.  Either way a
+   * bulk load writes every page once.
+   *
+   * @param records   Records to insert, in order.
+   * @return  IDs of the newly inserted records, in the same order.
+   * @throws  InsufficientSpaceException  If a record does not fit even on an
+   *                                      empty page.  The records before it
+   *                                      are inserted.
+   */
+  std::vector<RecordId> insertRecords(const std::vector<std::string>& records);
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -347,14 +798,14 @@ class PageFile : public File {
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
    * @return  The page.
    * @throws  InvalidPageException  If the page is free (unused) and
    *                                allow_free is false.
+   * @throws  FileIOException       If the page lies past the end of the file.
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
@@ -379,6 +830,84 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Takes the latch if the page held by insertRecord lies among the given
+   * pages, so that it cannot be written and released mid-read.
+   *
+   * @param first_page_number Number of first page.
+   * @param count             Number of pages.
+   * @return  Lock, owning the latch if the held page was among the pages.
+   */
+  std::unique_lock<std::recursive_mutex> lockIfHeld(
+      const PageId first_page_number, const std::size_t count) const;
+
+  /**
+   * Writes only the header of the given page to disk, leaving its record data
+   * and slot table alone.  No bounds checking is performed.
+   *
+   * @param page_number   Number of page whose header is to be written.
+   * @param header        Header to write.
+   */
+  void writePageHeader(const PageId page_number, const PageHeader& header);
+
+  /**
+   * Reads the allocation bitmap from the map pages unless it is in memory
+   * already.  Must be called with the latch held.
+   */
+  void loadMaps();
+
+  /**
+   * Extends the maps in memory to cover a group of pages.  Must be called with
+   * the latch held.
+   *
+   * @param map_number  Number of the group, from 0.
+   */
+  void growMaps(const std::size_t map_number);
+
+  /**
+   * Records the free space of a page in the free-space map.  Must be called
+   * with the latch held.
+   *
+   * @param page_number   Number of page.
+   * @param free_bytes    Bytes free on the page, 0 for a free page.
+   */
+  void setFreeSpace(const PageId page_number, const std::size_t free_bytes);
+
+  /**
+   * Returns the lowest numbered page with the given number of bytes free
+   * according to the free-space map, or Page::INVALID_NUMBER if there is
+   * none.  Must be called with the latch held.
+   *
+   * @param bytes   Bytes wanted.
+   */
+  PageId findFreeSpace(const std::size_t bytes);
+
+  /**
+   * Sets or clears the bit of a page in the allocation bitmap.  Must be called
+   * with the latch held.
+   *
+   * @param page_number   Number of page.
+   * @param used          Whether the page is now used.
+   */
+  void markUsed(const PageId page_number, const bool used);
+
+  /**
+   * Returns the highest numbered used page below the given page, or
+   * Page::INVALID_NUMBER if there is none.  Must be called with the latch held.
+   *
+   * @param page_number   Number of page.
+   */
+  PageId previousUsedPage(const PageId page_number) const;
+
+  /**
+   * Returns the lowest numbered free page from the given page on, or
+   * Page::INVALID_NUMBER if there is none.  Must be called with the latch held.
+   *
+   * @param page_number   Number of page to start at.
+   * @param header        Header of the file.
+   */
+  PageId nextFreePage(const PageId page_number, const FileHeader& header) const;
+
   friend class FileIterator;
 };
 
@@ -389,21 +918,43 @@ class BlobFile : public File {
    * Creates a new BlobFile.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the kernel page cache.
+   * @param page_size Size of the pages of the file, rounded up by
+   *                  Page::sizeClassOf.  Pages larger than Page::SIZE suit
+   *                  index nodes which want a wider fan-out.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static BlobFile create(const std::string& filename);
+  static BlobFile create(const std::string& filename, const bool direct_io = false,
+                         const std::size_t page_size = Page::SIZE);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_fds_ map.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the kernel page cache, if the file is
+   *                  not open already.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
-  static BlobFile open(const std::string& filename);
+  static BlobFile open(const std::string& filename, const bool direct_io = false);
+
+  /**
+   * Opens the file named fileName read-only, with the whole file mapped into
+   * memory.  Pages are then copied out of the mapping rather than read from
+   * the descriptor, and BufMgr hands out pointers straight into the mapping instead
+   * of copying pages into its frames, leaving their caching to the kernel.
+   * Suits read-mostly index files.  Writing or allocating pages throws.  Pages
+   * added to the file after it is mapped are read as usual.  Unless the file
+   * is open already, its descriptor is opened read-only, and the file cannot
+   * be opened for writing until every File object for it is closed.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the requested file doesn't exist.
+   */
+  static BlobFile openMapped(const std::string& filename);
 
   /**
    * Constructs a file object representing a file on the filesystem.
@@ -412,12 +963,20 @@ class BlobFile : public File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the kernel page cache, if the file is
+   *                    not open already and its filesystem supports it.
+   * @param page_size   Size of the pages of a new file.
+   * @param read_only   Whether to open an existing file read-only; see
+   *                    openMapped.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  FileOpenException       If read_only is false and the file is
+   *                                  open read-only already.
    */
-  BlobFile(const std::string& name, const bool create_new);
+  BlobFile(const std::string& name, const bool create_new, const bool direct_io = false,
+           const std::size_t page_size = Page::SIZE, const bool read_only = false);
 
   /**
    * Copy constructor.
@@ -458,6 +1017,18 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads a run of existing pages at consecutive page numbers starting at
+   * first_page_number, with a single read of the underlying file.
+   *
+   * @param first_page_number Number of page to read into pages[0].
+   * @param pages             Where to store the pages read.
+   * @throws  InvalidPageException  If one of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  void readPages(const PageId first_page_number,
+                 const std::vector<Page*>& pages) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -468,7 +1039,19 @@ class BlobFile : public File {
   void writePage(const PageId page_number, const Page& new_page);
 
   /**
-   * Deletes a page from the file.
+   * Writes a run of pages into the file at consecutive page numbers starting
+   * at first_page_number, with a single write to the underlying file.
+   * No bounds checking is performed.
+   *
+   * @param first_page_number Number of page to replace with pages[0].
+   * @param pages             Pages to write.
+   */
+  void writePages(const PageId first_page_number,
+                  const std::vector<const Page*>& pages);
+
+  /**
+   * Deletes a page from the file.  The pages after it keep their order in the
+   * used list.
    *
    * @param page_number   Number of page to delete.
    */
@@ -94,6 +94,13 @@ class FileIterator {
         (current_page_number_ != rhs.current_page_number_);
   }
 
+  /**
+   * Returns the number of the page the iterator points to, without reading it.
+   *
+   * @return  Page number, or Page::INVALID_NUMBER at the end of the file.
+   */
+  inline PageId page_number() const { return current_page_number_; }
+
   /**
    * Dereferences the iterator, returning a copy of the current page in the
    * file.
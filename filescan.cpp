@@ -10,23 +10,23 @@
 
 namespace badgerdb { 
 
-FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
+const std::uint32_t FileScan::READ_AHEAD_WINDOW;
+
+FileScan::FileScan(const std::string &name, BufMgr *bufferMgr, const std::uint32_t ringSize)
+  : strategy(ringSize)
 {
   file = new PageFile(name, false);	//dont create new file
 	bufMgr = bufferMgr;
-	curDirtyFlag = false;
-  curPage = NULL;
+  readAheadPending = 0;
 	filePageIter = file->begin();
 }
 
 FileScan::~FileScan()
 {
   // generally must unpin last page of the scan
-  if (curPage != NULL)
+  if (curPage)
   {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-		curDirtyFlag = false;
+    curPage.release();
     filePageIter = file->begin();
   }
   bufMgr->flushFile(file);
@@ -43,7 +43,7 @@ void FileScan::scanNext(RecordId& outRid)
 	}
 
   // special case of the first record of the first page of the file
-  if (curPage == NULL)
+  if (!curPage)
   {
     // need to get the first page of the file
 		filePageIter = file->begin();
@@ -53,8 +53,8 @@ void FileScan::scanNext(RecordId& outRid)
 		}
 	 
 		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
-		curDirtyFlag = false;
+    readAhead();
+    curPage = bufMgr->readPage(file, (*filePageIter).page_number(), &strategy);
 
 		// get the first record off the page
     pageRecordIter = curPage->begin(); 
@@ -76,19 +76,17 @@ void FileScan::scanNext(RecordId& outRid)
   while (pageRecordIter == curPage->end())
   {
     // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-    curDirtyFlag = false;
+    curPage.release();
 
     filePageIter++;
     if (filePageIter == file->end())
     {
-      curPage = NULL;
 			throw EndOfFileException();
     }
 
     // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+    readAhead();
+    curPage = bufMgr->readPage(file, (*filePageIter).page_number(), &strategy);
 
     // get the first record off the page
     pageRecordIter = curPage->begin(); 
@@ -111,10 +109,50 @@ std::string FileScan::getRecord()
   return *pageRecordIter;
 }
 
+void FileScan::readAhead()
+{
+  if (readAheadPending > 0)
+  {
+    // the scan has reached the first of the pages read ahead
+    readAheadPending--;
+  }
+  else
+  {
+    readAheadIter = filePageIter;
+    ++readAheadIter;
+  }
+  if (readAheadPending > READ_AHEAD_WINDOW / 2)
+    return;
+
+  // hand the next pages to prefetch in runs of adjacent page numbers
+  const PageId numPages = file->numPages();
+  const FileIterator end = file->end();
+  PageId first = 0;
+  std::uint32_t count = 0;
+  while (readAheadPending < READ_AHEAD_WINDOW && readAheadIter != end)
+  {
+    const PageId pageNo = readAheadIter.page_number();
+    if (pageNo >= numPages)
+      break;
+    if (count > 0 && pageNo != first + count)
+    {
+      bufMgr->prefetch(file, first, count, &strategy);
+      count = 0;
+    }
+    if (count == 0)
+      first = pageNo;
+    count++;
+    readAheadPending++;
+    ++readAheadIter;
+  }
+  if (count > 0)
+    bufMgr->prefetch(file, first, count, &strategy);
+}
+
 // mark current page of scan dirty
 void FileScan::markDirty()
 {
-  curDirtyFlag = true;
+  curPage.markDirty();
 }
 
 }
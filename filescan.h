@@ -24,7 +24,13 @@ class FileScan
 {
  public:
 
-  FileScan(const std::string &name, BufMgr *bufMgr);
+  /**
+   * Opens the relation for a sequential scan.  Its pages are read through a
+   * private ring of ringSize frames (see BufAccessStrategy) so that the scan
+   * does not evict the rest of the buffer pool; 0 reads through the whole pool.
+   */
+  FileScan(const std::string &name, BufMgr *bufMgr,
+           const std::uint32_t ringSize = BufAccessStrategy::DEFAULT_RING_SIZE);
 
   ~FileScan();
 
@@ -37,6 +43,11 @@ class FileScan
   //marks current page of scan dirty
   void markDirty();
 
+  /**
+   * Number of pages the scan keeps read ahead of its current page
+   */
+  static const std::uint32_t READ_AHEAD_WINDOW = 8;
+
  private:
   /**
    * File which is being scanned.
@@ -49,17 +60,34 @@ class FileScan
 	BufMgr				*bufMgr;
 
   /**
-   * Current page being scanned.
+   * Ring of frames the scan reads its pages into.
+   */
+  BufAccessStrategy strategy;
+
+  /**
+   * Current page being scanned, pinned until the scan moves off it.
    */
-  Page*         curPage;
+  PageHandle    curPage;
 
   FileIterator  filePageIter;
   PageIterator  pageRecordIter;
 
   /**
-   * True if page has been updated
+   * Next used page of the file to read ahead, following filePageIter
+   */
+  FileIterator  readAheadIter;
+
+  /**
+   * Number of pages read ahead that the scan has not reached yet
+   */
+  std::uint32_t readAheadPending;
+
+  /**
+   * Called as the scan moves onto the page of filePageIter.  Tops up the
+   * read-ahead window once the scan reaches its second half, taking the next
+   * pages from the file's list of used pages, up to its last page.
    */
-  bool  	      curDirtyFlag;
+  void readAhead();
 };
 
 }
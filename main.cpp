@@ -5,6 +5,8 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <map>
+#include <sstream>
 #include <vector>
 #include "btree.h"
 #include "page.h"
@@ -73,6 +75,18 @@ void indexTests();
 void test1();
 void test2();
 void test3();
+void test4();
+void test5();
+void test6();
+void test7();
+void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+int roundTrips(const Page& page);
+int countPages(PageFile* file);
+PageId allocateKeyedPage(PageFile* file, int key);
 void errorTests();
 void deleteRelation();
 
@@ -140,6 +154,15 @@ int main(int argc, char **argv)
 	test1();
 	test2();
 	test3();
+	test4();
+	test5();
+	test6();
+	test7();
+	test8();
+	test9();
+	test10();
+	test11();
+	test12();
 	//errorTests();
 
   return 1;
@@ -178,6 +201,434 @@ void test3()
 	deleteRelation();
 }
 
+void test4()
+{
+	// Load the same tuples through insertRecord, by filling pages by hand and
+	// through insertRecords; all three must pack them into as many pages.
+	std::cout << "------------------" << std::endl;
+	std::cout << "insertRecordPacking" << std::endl;
+	std::vector<std::string> records;
+	memset(record1.s, ' ', sizeof(record1.s));
+	for(int i = 0; i < relationSize; i++ )
+	{
+		sprintf(record1.s, "%05d string record", i);
+		record1.i = i;
+		record1.d = (double)i;
+		records.push_back(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+	}
+
+	createRelationBackward();
+	int loopPages = countPages(file1);
+	deleteRelation();
+
+	createRelationForward();
+	checkPassFail(countPages(file1), loopPages)
+	deleteRelation();
+
+	file1 = new PageFile(relationName, true);
+	file1->insertRecords(records);
+	checkPassFail(countPages(file1), loopPages)
+	deleteRelation();
+}
+
+void test5()
+{
+	// Two hot pages referenced twice each, a scan of one-time pages through a
+	// pool too small for both, and the hot pages again.  LRU-K and ARC evict
+	// the scan's pages before the hot ones; CLOCK lets the scan flush them.
+	std::cout << "--------------------" << std::endl;
+	std::cout << "replacementPolicies" << std::endl;
+	std::vector<PageRef> trace;
+	const PageId hot[] = {1, 1, 2, 2};
+	for (int i = 0; i < 4; i++)
+	{
+		PageRef ref = {0, hot[i]};
+		trace.push_back(ref);
+	}
+	for (PageId pageNo = 100; pageNo < 110; pageNo++)
+	{
+		PageRef ref = {0, pageNo};
+		trace.push_back(ref);
+	}
+	for (PageId pageNo = 1; pageNo <= 2; pageNo++)
+	{
+		PageRef ref = {0, pageNo};
+		trace.push_back(ref);
+	}
+
+	checkPassFail((int) ReplacementPolicy::simulate(LRUK_POLICY, 4, trace), 4)
+	checkPassFail((int) ReplacementPolicy::simulate(ARC_POLICY, 4, trace), 4)
+	checkPassFail((int) ReplacementPolicy::simulate(CLOCK_POLICY, 4, trace), 2)
+}
+
+void test6()
+{
+	// Save the hot set of one pool and load it into a fresh one: the pages read
+	// before must come back without a miss, and only those.
+	std::cout << "----------" << std::endl;
+	std::cout << "hotSetReload" << std::endl;
+	const std::string hotFileName = relationName + ".hot";
+	const PageId hotPages = 8;
+	try
+	{
+		File::remove(hotFileName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		BlobFile hotFile = BlobFile::create(hotFileName);
+		PageId pageNo;
+		for (PageId i = 0; i < 4 * hotPages; i++)
+			hotFile.allocatePage(pageNo);
+	}
+
+	{
+		BlobFile hotFile = BlobFile::open(hotFileName);
+		std::stringstream hotSet;
+		{
+			BufMgr before(2 * hotPages, 1);
+			Page* page;
+			for (PageId pageNo = 1; pageNo <= hotPages; pageNo++)
+			{
+				before.readPage(&hotFile, pageNo, page);
+				before.unPinPage(&hotFile, pageNo, false);
+			}
+			before.saveHotSet(hotSet);
+		}
+
+		BufMgr after(2 * hotPages, 1);
+		checkPassFail((int) after.loadHotSet(hotSet, std::vector<File*>(1, &hotFile)), (int) hotPages)
+		Page* page;
+		for (PageId pageNo = 1; pageNo <= hotPages + 1; pageNo++)
+		{
+			after.readPage(&hotFile, pageNo, page);
+			after.unPinPage(&hotFile, pageNo, false);
+		}
+		checkPassFail((int) after.getBufStats().misses, 1)
+		after.flushFile(&hotFile);
+	}
+	File::remove(hotFileName);
+}
+
+void test7()
+{
+	// The victim cache codec must give back the exact page it was given: an
+	// empty page, a page half full of random bytes and a page of tuples.  A page
+	// full of random bytes does not shrink enough and must be refused.
+	std::cout << "-----------" << std::endl;
+	std::cout << "pageCodec" << std::endl;
+	Page emptyPage;
+	checkPassFail(roundTrips(emptyPage), 1)
+
+	std::string noise(Page::DATA_SIZE / 2, ' ');
+	for (std::size_t i = 0; i < noise.size(); i++)
+		noise[i] = (char) random();
+	Page halfRandomPage;
+	halfRandomPage.insertRecord(noise);
+	checkPassFail(roundTrips(halfRandomPage), 1)
+
+	Page tuplePage;
+	memset(record1.s, ' ', sizeof(record1.s));
+	for (int i = 0; tuplePage.hasSpaceForRecord(std::string(sizeof(record1), ' ')); i++)
+	{
+		sprintf(record1.s, "%05d string record", i);
+		record1.i = i;
+		record1.d = (double)i;
+		tuplePage.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+	}
+	checkPassFail(roundTrips(tuplePage), 1)
+
+	noise.resize(Page::DATA_SIZE - sizeof(PageSlot));
+	for (std::size_t i = 0; i < noise.size(); i++)
+		noise[i] = (char) random();
+	Page randomPage;
+	randomPage.insertRecord(noise);
+	std::vector<char> compressed;
+	checkPassFail(VictimCache::compress(randomPage, compressed), false)
+}
+
+void test8()
+{
+	// Pages spilled to the SSD cache must be read back from there, but never
+	// once the pool has written a newer version of the page to its file.
+	std::cout << "---------------" << std::endl;
+	std::cout << "ssdInvalidation" << std::endl;
+	const std::string ssdFileName = relationName + ".ssd";
+	const PageId ssdPages = 8;
+	const PageId stamp = 12345;
+	try
+	{
+		File::remove(ssdFileName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		BlobFile ssdFile = BlobFile::create(ssdFileName);
+		PageId pageNo;
+		for (PageId i = 0; i < ssdPages; i++)
+			ssdFile.allocatePage(pageNo);
+	}
+
+	{
+		BlobFile ssdFile = BlobFile::open(ssdFileName);
+		BufMgr pool(2, 1);
+		pool.setSsdCache(".", 2 * ssdPages * Page::SIZE);
+		Page* page;
+		// the second pass finds the pages the first spilled in the cache
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (PageId pageNo = 1; pageNo <= ssdPages; pageNo++)
+			{
+				pool.readPage(&ssdFile, pageNo, page);
+				pool.unPinPage(&ssdFile, pageNo, false);
+			}
+		}
+		bool cacheHit = pool.getBufStats().ssdhits > 0;
+		checkPassFail(cacheHit, true)
+
+		// change the first page and push it out of the pool, so it is written back
+		pool.readPage(&ssdFile, 1, page);
+		memcpy(reinterpret_cast<char*>(page) + Page::SIZE - sizeof(PageId), &stamp, sizeof(PageId));
+		pool.unPinPage(&ssdFile, 1, true);
+		for (PageId pageNo = 2; pageNo <= ssdPages; pageNo++)
+		{
+			pool.readPage(&ssdFile, pageNo, page);
+			pool.unPinPage(&ssdFile, pageNo, false);
+		}
+
+		PageId found;
+		pool.readPage(&ssdFile, 1, page);
+		memcpy(&found, reinterpret_cast<char*>(page) + Page::SIZE - sizeof(PageId), sizeof(PageId));
+		pool.unPinPage(&ssdFile, 1, false);
+		checkPassFail(found, stamp)
+		pool.flushFile(&ssdFile);
+	}
+	File::remove(ssdFileName);
+}
+
+void test9()
+{
+	// Records deleted from the first page of a loaded relation leave room that
+	// the free-space map must offer to later inserts, also after reopening.
+	std::cout << "-----------" << std::endl;
+	std::cout << "freeSpaceReuse" << std::endl;
+	const int deleted = 10;
+	createRelationForward();
+	const int loadedPages = countPages(file1);
+	PageId firstPageNo = file1->getFirstPageNo();
+	Page firstPage = file1->readPage(firstPageNo);
+	std::vector<RecordId> deletedRids;
+	for (PageIterator iter = firstPage.begin(); iter != firstPage.end() && (int) deletedRids.size() < deleted; ++iter)
+		deletedRids.push_back(iter.getCurrentRecord());
+	for (std::size_t i = 0; i < deletedRids.size(); i++)
+		firstPage.deleteRecord(deletedRids[i]);
+	file1->writePage(firstPageNo, firstPage);
+	delete file1;
+
+	file1 = new PageFile(relationName, false);
+	int reused = 0;
+	memset(record1.s, ' ', sizeof(record1.s));
+	for (int i = 0; i < deleted; i++)
+	{
+		sprintf(record1.s, "%05d string record", relationSize + i);
+		record1.i = relationSize + i;
+		record1.d = (double)(relationSize + i);
+		if (file1->insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1))).page_number == firstPageNo)
+			reused++;
+	}
+	checkPassFail(reused, deleted)
+	checkPassFail(countPages(file1), loadedPages)
+	deleteRelation();
+}
+
+void test10()
+{
+	// An index on 32 KB pages holds four times the keys per node; it must answer
+	// scans as the 8 KB one does, also once reopened with the default page size.
+	std::cout << "---------------" << std::endl;
+	std::cout << "largeIndexPages" << std::endl;
+	createRelationForward();
+	BufMgr* smallPageBufMgr = bufMgr;
+	std::vector<PageSizeClass> classes;
+	classes.push_back(PageSizeClass(Page::SIZE, 100));
+	classes.push_back(PageSizeClass(4 * Page::SIZE, 20));
+	bufMgr = new BufMgr(classes);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, false, 4 * Page::SIZE);
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+		checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize)
+	}
+	bufMgr->flushFile(file1);
+	delete bufMgr;
+	bufMgr = smallPageBufMgr;
+	File::remove(intIndexName);
+	deleteRelation();
+}
+
+void test11()
+{
+	// Pages deleted at random leave holes that later allocations fill, lowest
+	// first.  Reopened, the file must list its used pages in page order, both
+	// through FileIterator and FileScan, each holding the record written to it.
+	std::cout << "---------------" << std::endl;
+	std::cout << "deletePageOrder" << std::endl;
+	const int numPages = 200;
+	deleteRelation();
+	file1 = new PageFile(relationName, true);
+	std::map<PageId, int> expected;
+	for (int key = 0; key < numPages; key++)
+		expected[allocateKeyedPage(file1, key)] = key;
+
+	int deleted = 0;
+	for (std::map<PageId, int>::iterator it = expected.begin(); it != expected.end(); )
+	{
+		if (random() % 3 == 0)
+		{
+			file1->deletePage(it->first);
+			expected.erase(it++);
+			deleted++;
+		}
+		else
+			++it;
+	}
+	for (int key = numPages; key < numPages + deleted / 2; key++)
+		expected[allocateKeyedPage(file1, key)] = key;
+	delete file1;
+	file1 = new PageFile(relationName, false);
+
+	int iterMatches = 0;
+	std::map<PageId, int>::const_iterator next = expected.begin();
+	for (FileIterator iter = file1->begin(); iter != file1->end() && next != expected.end(); ++iter, ++next)
+	{
+		Page page = *iter;
+		const std::string record = *page.begin();
+		if (page.page_number() == next->first &&
+				reinterpret_cast<const RECORD*>(record.data())->i == next->second)
+			iterMatches++;
+	}
+	checkPassFail(countPages(file1), (int) expected.size())
+	checkPassFail(iterMatches, (int) expected.size())
+
+	int scanMatches = 0;
+	bool scanEnded = false;
+	{
+		FileScan fscan(relationName, bufMgr);
+		next = expected.begin();
+		try
+		{
+			RecordId scanRid;
+			for (; next != expected.end(); ++next)
+			{
+				fscan.scanNext(scanRid);
+				const std::string record = fscan.getRecord();
+				if (scanRid.page_number == next->first &&
+						reinterpret_cast<const RECORD*>(record.data())->i == next->second)
+					scanMatches++;
+			}
+			fscan.scanNext(scanRid);
+		}
+		catch(EndOfFileException e)
+		{
+			scanEnded = next == expected.end();
+		}
+	}
+	checkPassFail(scanMatches, (int) expected.size())
+	checkPassFail(scanEnded, true)
+	deleteRelation();
+}
+
+void test12()
+{
+	// Allocating past the first PAGES_PER_MAP pages starts the next group of map
+	// pages.  Pages freed on both sides of the boundary and at the tail must be
+	// handed out again lowest first, and once the file is reopened a new page
+	// must be linked in after the last one.
+	std::cout << "------------------" << std::endl;
+	std::cout << "mapGroupAllocation" << std::endl;
+	const PageId numPages = PageFile::PAGES_PER_MAP + 100;
+	deleteRelation();
+	file1 = new PageFile(relationName, true);
+	PageId pageNo;
+	for (PageId i = 0; i < numPages; i++)
+		file1->allocatePage(pageNo);
+	const PageId lastPageNo = pageNo;
+
+	const PageId freed[] = {PageFile::PAGES_PER_MAP - 1, PageFile::PAGES_PER_MAP,
+			PageFile::PAGES_PER_MAP + 1, lastPageNo};
+	const int numFreed = sizeof(freed) / sizeof(freed[0]);
+	for (int i = numFreed - 1; i >= 0; i--)
+		file1->deletePage(freed[i]);
+	int reused = 0;
+	for (int i = 0; i < numFreed; i++)
+	{
+		file1->allocatePage(pageNo);
+		if (pageNo == freed[i])
+			reused++;
+	}
+	checkPassFail(reused, numFreed)
+
+	delete file1;
+	file1 = new PageFile(relationName, false);
+	PageId newPageNo;
+	file1->allocatePage(newPageNo);
+	checkPassFail(newPageNo, lastPageNo + 1)
+
+	int usedPages = 0;
+	int inOrder = 0;
+	PageId previousPageNo = 0;
+	for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+	{
+		pageNo = (*iter).page_number();
+		if (pageNo > previousPageNo)
+			inOrder++;
+		previousPageNo = pageNo;
+		usedPages++;
+	}
+	checkPassFail(usedPages, (int) numPages + 1)
+	checkPassFail(inOrder, usedPages)
+	checkPassFail(previousPageNo, newPageNo)
+	deleteRelation();
+}
+
+int roundTrips(const Page& page)
+{
+	std::vector<char> compressed;
+	Page copy;
+	if (!VictimCache::compress(page, compressed) || !VictimCache::decompress(compressed, copy))
+		return 0;
+	return memcmp(&page, &copy, sizeof(Page)) == 0 ? 1 : 0;
+}
+
+PageId allocateKeyedPage(PageFile* file, int key)
+{
+	PageId pageNo;
+	Page page = file->allocatePage(pageNo);
+	memset(record1.s, ' ', sizeof(record1.s));
+	sprintf(record1.s, "%05d string record", key);
+	record1.i = key;
+	record1.d = (double)key;
+	page.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+	file->writePage(pageNo, page);
+	return pageNo;
+}
+
+int countPages(PageFile* file)
+{
+	int pages = 0;
+	for (FileIterator iter = file->begin(); iter != file->end(); ++iter)
+	{
+		pages++;
+	}
+	return pages;
+}
+
 // -----------------------------------------------------------------------------
 // createRelationForward
 // -----------------------------------------------------------------------------
@@ -198,10 +649,8 @@ void createRelationForward()
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
 
-  // Insert a bunch of tuples into the relation.
+  // Insert a bunch of tuples into the relation; the file finds each a page.
   for(int i = 0; i < relationSize; i++ )
 	{
     sprintf(record1.s, "%05d string record", i);
@@ -209,22 +658,8 @@ void createRelationForward()
     record1.d = (double)i;
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+		file1->insertRecord(new_data);
   }
-
-	file1->writePage(new_page_number, new_page);
 }
 
 // -----------------------------------------------------------------------------
@@ -0,0 +1,150 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "numaTopology.h"
+
+namespace badgerdb {
+
+/**
+ * Policy mode of mbind which prefers a node without insisting on it, from
+ * linux/mempolicy.h
+ */
+static const int MPOL_PREFERRED_MODE = 1;
+
+/**
+ * Parses a sysfs CPU list such as "0-3,8-11".
+ */
+static std::vector<int> parseCpuList(const std::string& list)
+{
+  std::vector<int> cpus;
+  std::stringstream in(list);
+  std::string range;
+  while (std::getline(in, range, ','))
+  {
+    if (range.empty() || range[0] == '\n')
+      continue;
+    const std::size_t dash = range.find('-');
+    const int first = std::atoi(range.c_str());
+    const int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+    for (int cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+//----------------------------------------
+// Constructor of the class NumaTopology
+//----------------------------------------
+
+NumaTopology::NumaTopology()
+{
+  std::vector<int> ids;
+  DIR* dir = opendir("/sys/devices/system/node");
+  if (dir != NULL)
+  {
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+      const std::string name = entry->d_name;
+      if (name.compare(0, 4, "node") == 0 && name.size() > 4 && name.find_first_not_of("0123456789", 4) == std::string::npos)
+        ids.push_back(std::atoi(name.c_str() + 4));
+    }
+    closedir(dir);
+  }
+  std::sort(ids.begin(), ids.end());
+
+  for (std::size_t i = 0; i < ids.size(); i++)
+  {
+    std::ostringstream path;
+    path << "/sys/devices/system/node/node" << ids[i] << "/cpulist";
+    std::ifstream in(path.str().c_str());
+    std::string list;
+    std::getline(in, list);
+
+    // memory-only nodes hold no frames worth binding to; skip them
+    const std::vector<int> cpus = parseCpuList(list);
+    if (cpus.empty())
+      continue;
+    kernelIds.push_back(ids[i]);
+    nodeCpus.push_back(cpus);
+  }
+
+  // no topology to go by: one node with every CPU
+  if (nodeCpus.empty())
+  {
+    kernelIds.assign(1, 0);
+    nodeCpus.assign(1, std::vector<int>());
+    const long numCpus = sysconf(_SC_NPROCESSORS_CONF);
+    for (int cpu = 0; cpu < std::max(1L, numCpus); cpu++)
+      nodeCpus[0].push_back(cpu);
+  }
+
+  for (std::uint32_t node = 0; node < nodeCpus.size(); node++)
+  {
+    for (std::size_t i = 0; i < nodeCpus[node].size(); i++)
+    {
+      const int cpu = nodeCpus[node][i];
+      if ((std::size_t) cpu >= cpuNodes.size())
+        cpuNodes.resize(cpu + 1, 0);
+      cpuNodes[cpu] = node;
+    }
+  }
+}
+
+const NumaTopology& NumaTopology::system()
+{
+  static const NumaTopology topology;
+  return topology;
+}
+
+std::uint32_t NumaTopology::currentNode() const
+{
+  if (numNodes() == 1)
+    return 0;
+  return nodeOfCpu(sched_getcpu());
+}
+
+bool NumaTopology::bindMemory(void* addr, const std::size_t bytes, const std::uint32_t node) const
+{
+  if (numNodes() == 1)
+    return false;
+
+  const std::uintptr_t pageSize = (std::uintptr_t) sysconf(_SC_PAGESIZE);
+  const std::uintptr_t start = ((std::uintptr_t) addr + pageSize - 1) / pageSize * pageSize;
+  const std::uintptr_t end = ((std::uintptr_t) addr + bytes) / pageSize * pageSize;
+  if (end <= start)
+    return false;
+
+  const int kernelId = kernelIds[node];
+  std::vector<unsigned long> mask(kernelId / (8 * sizeof(unsigned long)) + 1, 0);
+  mask[kernelId / (8 * sizeof(unsigned long))] |= 1UL << (kernelId % (8 * sizeof(unsigned long)));
+  return syscall(SYS_mbind, (void*) start, end - start, MPOL_PREFERRED_MODE, mask.data(),
+                 mask.size() * 8 * sizeof(unsigned long), 0) == 0;
+}
+
+bool NumaTopology::bindThread(const std::uint32_t node) const
+{
+  if (numNodes() == 1)
+    return false;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (std::size_t i = 0; i < nodeCpus[node].size(); i++)
+    CPU_SET(nodeCpus[node][i], &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+}
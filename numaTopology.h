@@ -0,0 +1,89 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+* @brief The NUMA nodes of the machine and the CPUs on each
+*
+* Read once from /sys/devices/system/node.  Nodes are numbered densely from 0
+* here, whatever numbers the kernel gives them.  Where the directory is missing
+* or lists a single node, the machine is taken to have one node holding every
+* CPU, and binding memory or threads does nothing.
+*
+* Memory is bound with the mbind system call and threads with
+* sched_setaffinity, so no NUMA library is needed.
+*/
+class NumaTopology
+{
+ public:
+	/**
+	 * Returns the topology of this machine.
+	 */
+  static const NumaTopology& system();
+
+	/**
+	 * Number of NUMA nodes, at least 1
+	 */
+  std::uint32_t numNodes() const { return (std::uint32_t) nodeCpus.size(); }
+
+	/**
+	 * CPUs of a node
+	 */
+  const std::vector<int>& cpusOf(const std::uint32_t node) const { return nodeCpus[node]; }
+
+	/**
+	 * Returns the node of a CPU, 0 if it is not known.
+	 */
+  std::uint32_t nodeOfCpu(const int cpu) const
+  {
+    return cpu >= 0 && (std::size_t) cpu < cpuNodes.size() ? cpuNodes[cpu] : 0;
+  }
+
+	/**
+	 * Returns the node the calling thread is running on.
+	 */
+  std::uint32_t currentNode() const;
+
+	/**
+	 * Asks the kernel to place the pages of a memory range on a node when they are
+	 * first touched.  The kernel falls back to other nodes if the node runs out of
+	 * memory.  The range is trimmed to whole pages.
+	 *
+	 * @return  			False if the kernel refused, or the machine has one node.
+	 */
+  bool bindMemory(void* addr, const std::size_t bytes, const std::uint32_t node) const;
+
+	/**
+	 * Restricts the calling thread to the CPUs of a node.
+	 *
+	 * @return  			False if the kernel refused, or the machine has one node.
+	 */
+  bool bindThread(const std::uint32_t node) const;
+
+ private:
+  NumaTopology();
+
+	/**
+	 * Kernel number of each node
+	 */
+  std::vector<int> kernelIds;
+
+	/**
+	 * CPUs of each node, and node of each CPU
+	 */
+  std::vector<std::vector<int> > nodeCpus;
+  std::vector<std::uint32_t> cpuNodes;
+};
+
+}
@@ -118,6 +118,27 @@ class Page {
    */
   static const std::size_t DATA_SIZE = SIZE - sizeof(PageHeader);
 
+  /**
+   * Largest page size a file may be created with.  Files with pages larger than
+   * SIZE hold blobs such as index nodes; the slotted records of this class
+   * always take SIZE bytes.
+   */
+  static const std::size_t MAX_SIZE = 8 * SIZE;
+
+  /**
+   * Returns the page size a file asking for the given size gets: the smallest
+   * power of two multiple of SIZE which holds it, at most MAX_SIZE.
+   *
+   * @param size  Page size asked for, in bytes.
+   */
+  static std::size_t sizeClassOf(const std::size_t size) {
+    std::size_t page_size = SIZE;
+    while (page_size < size && page_size < MAX_SIZE) {
+      page_size *= 2;
+    }
+    return page_size;
+  }
+
   /**
    * Number of page indicating that it's invalid.
    */
@@ -0,0 +1,222 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdlib>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ssdCache.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb {
+
+//----------------------------------------
+// Constructor of the class SsdCache
+//----------------------------------------
+
+const std::uint32_t SsdCache::NO_SLOT;
+
+SsdCache::SsdCache(const std::string& directory, const std::uint32_t numSlots)
+  : fd(-1), direct(false), slots(numSlots), clockHand(0), numValid(0), nextGeneration(1)
+{
+  std::string path = directory + "/badgerdb-cache.XXXXXX";
+  std::vector<char> name(path.begin(), path.end());
+  name.push_back('\0');
+  fd = mkstemp(name.data());
+  if (fd < 0)
+    throw FileNotFoundException(directory);
+  path = name.data();
+
+  // file systems without O_DIRECT support refuse the open; the cache then
+  // goes through the page cache
+  const int directFd = ::open(path.c_str(), O_RDWR | O_DIRECT);
+  if (directFd >= 0)
+  {
+    ::close(fd);
+    fd = directFd;
+    direct = true;
+  }
+
+  // nothing else is to find the file; it goes away once closed
+  ::unlink(path.c_str());
+  if (ftruncate(fd, (off_t) numSlots * Page::SIZE) != 0)
+  {
+    ::close(fd);
+    throw FileNotFoundException(directory);
+  }
+
+  for (std::uint32_t i = 0; i < numSlots; i++)
+  {
+    slots[i].owner = NULL;
+    slots[i].pageNo = 0;
+    slots[i].generation = 0;
+    slots[i].state = FREE;
+    slots[i].refbit = false;
+    freeSlots.push_back(numSlots - 1 - i);
+  }
+}
+
+SsdCache::~SsdCache()
+{
+  ::close(fd);
+}
+
+std::uint32_t SsdCache::reserve(const std::string& filename, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  if (find(filename, pageNo) != NO_SLOT)
+    return NO_SLOT;
+
+  const std::uint32_t slot = pickSlot();
+  if (slot == NO_SLOT)
+    return NO_SLOT;
+
+  FileSlots& owner = files[filename];
+  owner[pageNo] = slot;
+  Slot& s = slots[slot];
+  s.owner = &owner;
+  s.pageNo = pageNo;
+  s.generation = nextGeneration++;
+  s.state = FILLING;
+  s.refbit = true;
+  return slot;
+}
+
+bool SsdCache::store(const std::uint32_t slot, const Page& page)
+{
+  const bool written = ::pwrite(fd, &page, Page::SIZE, (off_t) slot * Page::SIZE) == (ssize_t) Page::SIZE;
+
+  std::lock_guard<std::mutex> guard(latch);
+  Slot& s = slots[slot];
+  if (s.state == FILLING && written)
+  {
+    s.state = VALID;
+    numValid++;
+    return true;
+  }
+
+  // cancelled meanwhile, or the write failed: the slot is free again
+  if (s.state == FILLING)
+    s.owner->erase(s.pageNo);
+  s.owner = NULL;
+  s.state = FREE;
+  freeSlots.push_back(slot);
+  return false;
+}
+
+bool SsdCache::read(const std::string& filename, const PageId pageNo, Page& page)
+{
+  std::uint32_t slot;
+  std::uint64_t generation;
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    slot = find(filename, pageNo);
+    if (slot == NO_SLOT || slots[slot].state != VALID)
+      return false;
+    slots[slot].refbit = true;
+    generation = slots[slot].generation;
+  }
+
+  if (::pread(fd, &page, Page::SIZE, (off_t) slot * Page::SIZE) != (ssize_t) Page::SIZE)
+    return false;
+
+  // the slot may have been given to another page while it was read
+  std::lock_guard<std::mutex> guard(latch);
+  return slots[slot].state == VALID && slots[slot].generation == generation;
+}
+
+bool SsdCache::contains(const std::string& filename, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  const std::uint32_t slot = find(filename, pageNo);
+  return slot != NO_SLOT && slots[slot].state == VALID;
+}
+
+void SsdCache::invalidate(const std::string& filename, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  const std::uint32_t slot = find(filename, pageNo);
+  if (slot != NO_SLOT)
+    release(slot);
+}
+
+void SsdCache::invalidateFile(const std::string& filename)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  std::unordered_map<std::string, FileSlots>::iterator it = files.find(filename);
+  if (it == files.end())
+    return;
+
+  std::vector<std::uint32_t> fileSlots;
+  for (FileSlots::const_iterator s = it->second.begin(); s != it->second.end(); ++s)
+    fileSlots.push_back(s->second);
+  for (std::size_t i = 0; i < fileSlots.size(); i++)
+    release(fileSlots[i]);
+  files.erase(it);
+}
+
+std::uint32_t SsdCache::size()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return numValid;
+}
+
+std::uint32_t SsdCache::find(const std::string& filename, const PageId pageNo)
+{
+  std::unordered_map<std::string, FileSlots>::const_iterator it = files.find(filename);
+  if (it == files.end())
+    return NO_SLOT;
+  FileSlots::const_iterator s = it->second.find(pageNo);
+  return s == it->second.end() ? NO_SLOT : s->second;
+}
+
+void SsdCache::release(const std::uint32_t slot)
+{
+  Slot& s = slots[slot];
+  s.owner->erase(s.pageNo);
+  s.owner = NULL;
+
+  // store frees the slot once its write is done
+  if (s.state == FILLING)
+  {
+    s.state = CANCELLED;
+    return;
+  }
+
+  if (s.state == VALID)
+    numValid--;
+  s.state = FREE;
+  freeSlots.push_back(slot);
+}
+
+std::uint32_t SsdCache::pickSlot()
+{
+  if (freeSlots.empty())
+  {
+    // two sweeps of the clock find an unreferenced page unless every slot is
+    // being filled
+    for (std::size_t step = 0; step < 2 * slots.size() && freeSlots.empty(); step++)
+    {
+      const std::uint32_t slot = clockHand;
+      clockHand = (clockHand + 1) % (std::uint32_t) slots.size();
+      if (slots[slot].state != VALID)
+        continue;
+      if (slots[slot].refbit)
+        slots[slot].refbit = false;
+      else
+        release(slot);
+    }
+    if (freeSlots.empty())
+      return NO_SLOT;
+  }
+
+  const std::uint32_t slot = freeSlots.back();
+  freeSlots.pop_back();
+  return slot;
+}
+
+}
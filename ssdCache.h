@@ -0,0 +1,195 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+* @brief Clean pages spilled from the buffer pool to a cache file on a fast local disk
+*
+* A tier below the buffer pool for relations kept on slow storage: BufMgr writes
+* the clean pages it evicts into a cache file in a local directory, and a page
+* missing from the pool is read from there rather than from its own file when
+* it is present.  Pages are keyed by file name and page number, so they outlive
+* the File object they were read through.  Unlike the VictimCache, a page stays
+* cached when it is loaded back into the pool; BufMgr invalidates it whenever
+* it writes the page back, since only then does the copy here go stale.
+*
+* The cache file is divided into page-sized slots, reused with a CLOCK once all
+* are taken.  It is created in the directory given and unlinked at once, so it
+* disappears with the process, and is opened with O_DIRECT where the file
+* system allows, to keep the spilled pages out of the operating system's page
+* cache.  Pages read or written must then be aligned as the buffer pool frames
+* are.
+*
+* A slot is reserved under the cache's latch, then filled by store without it.
+* Invalidating a page while its slot is being filled cancels the slot, which
+* is only reused once store is done with it.  read checks that the slot still
+* holds the page after reading it, so a slot reused meanwhile reads as a miss.
+*
+* @warning Failing reads and writes of the cache file are not reported: the
+* page is simply treated as not cached.
+*/
+class SsdCache
+{
+ public:
+	/**
+	 * Slot number reserve returns when the page needs no storing
+	 */
+  static const std::uint32_t NO_SLOT = 0xffffffffu;
+
+	/**
+	 * Constructor of SsdCache class.  Creates the cache file.
+	 *
+	 * @param directory 	Local directory to create the cache file in
+	 * @param numSlots 	Number of pages the cache holds
+	 * @throws  FileNotFoundException If no file can be created in the directory
+	 */
+  SsdCache(const std::string& directory, const std::uint32_t numSlots);
+
+	/**
+	 * Destructor of SsdCache class.  Closes, and so deletes, the cache file.
+	 */
+  ~SsdCache();
+
+	/**
+	 * Reserves a slot for a page, evicting the least recently used page if every
+	 * slot is taken, to be filled by store.
+	 *
+	 * @param filename 	Name of the file the page belongs to
+	 * @param pageNo  	Page number within the file
+	 * @return  				The slot, or NO_SLOT if the page is already cached or being
+	 *									stored, or every slot is being filled.
+	 */
+  std::uint32_t reserve(const std::string& filename, const PageId pageNo);
+
+	/**
+	 * Writes a page into the slot reserve gave it and makes it available to read,
+	 * unless the page was invalidated meanwhile.
+	 *
+	 * @param slot   	Slot returned by reserve
+	 * @param page   	Contents of the page
+	 * @return  			True if the page is now cached.
+	 */
+  bool store(const std::uint32_t slot, const Page& page);
+
+	/**
+	 * Reads a page from the cache.
+	 *
+	 * @param filename 	Name of the file the page belongs to
+	 * @param pageNo  	Page number within the file
+	 * @param page   		Receives the page; undefined if false is returned
+	 * @return  				True if the page was cached and has been read.
+	 */
+  bool read(const std::string& filename, const PageId pageNo, Page& page);
+
+	/**
+	 * Returns true if the page is cached.
+	 */
+  bool contains(const std::string& filename, const PageId pageNo);
+
+	/**
+	 * Drops a page from the cache, if present, and cancels any store of it in progress.
+	 */
+  void invalidate(const std::string& filename, const PageId pageNo);
+
+	/**
+	 * Drops every page of a file from the cache and cancels their stores.
+	 */
+  void invalidateFile(const std::string& filename);
+
+	/**
+	 * Number of pages cached
+	 */
+  std::uint32_t size();
+
+	/**
+	 * Number of pages the cache holds
+	 */
+  std::uint32_t capacity() const { return (std::uint32_t) slots.size(); }
+
+	/**
+	 * Returns true if the cache file was opened for direct I/O.
+	 */
+  bool directIo() const { return direct; }
+
+ private:
+  enum SlotState { FREE, FILLING, CANCELLED, VALID };
+
+	/**
+	 * Slots of the cached pages of one file, by page number
+	 */
+  typedef std::unordered_map<PageId, std::uint32_t> FileSlots;
+
+  struct Slot
+  {
+    FileSlots* owner;
+    PageId pageNo;
+    std::uint64_t generation;
+    SlotState state;
+    bool refbit;
+  };
+
+  std::mutex latch;
+
+	/**
+	 * Descriptor of the cache file
+	 */
+  int fd;
+  bool direct;
+
+  std::vector<Slot> slots;
+
+	/**
+	 * Slots being filled or holding a page, by file name
+	 */
+  std::unordered_map<std::string, FileSlots> files;
+
+	/**
+	 * Free slots, and the clock hand over the others
+	 */
+  std::vector<std::uint32_t> freeSlots;
+  std::uint32_t clockHand;
+
+	/**
+	 * Number of slots holding a page
+	 */
+  std::uint32_t numValid;
+
+	/**
+	 * Bumped whenever a slot is given a new page, so that read can tell the slot
+	 * it read from was reused meanwhile
+	 */
+  std::uint64_t nextGeneration;
+
+	/**
+	 * Finds the slot of a page, or returns NO_SLOT.  Must be called with the latch held.
+	 */
+  std::uint32_t find(const std::string& filename, const PageId pageNo);
+
+	/**
+	 * Takes a page out of its slot and frees the slot, or cancels it if it is
+	 * being filled.  Must be called with the latch held.
+	 */
+  void release(const std::uint32_t slot);
+
+	/**
+	 * Picks a slot for a new page, evicting its page if needed.  Must be called
+	 * with the latch held.
+	 */
+  std::uint32_t pickSlot();
+};
+
+}
@@ -0,0 +1,278 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "victimCache.h"
+
+namespace badgerdb {
+
+//----------------------------------------
+// Page codec
+//----------------------------------------
+
+/**
+ * Shortest match worth encoding, and the number of bits of the match finder's hash
+ */
+static const std::size_t MIN_MATCH = 4;
+static const std::uint32_t HASH_BITS = 12;
+
+static std::uint32_t read32(const unsigned char* p)
+{
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static std::uint64_t read64(const unsigned char* p)
+{
+  std::uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+/**
+ * Appends the bytes of a length beyond the 15 its token nibble holds.
+ */
+static void putLength(std::vector<char>& out, std::size_t length)
+{
+  while (length >= 255)
+  {
+    out.push_back((char) 255);
+    length -= 255;
+  }
+  out.push_back((char) length);
+}
+
+/**
+ * Reads the bytes of a length beyond the 15 its token nibble holds.
+ */
+static bool getLength(const unsigned char*& in, const unsigned char* end, std::size_t& length)
+{
+  unsigned char b;
+  do
+  {
+    if (in == end)
+      return false;
+    b = *in++;
+    length += b;
+  } while (b == 255);
+  return true;
+}
+
+/**
+ * Appends one sequence: literals, then a match of matchLength bytes at offset
+ * bytes back, or no match if matchLength is 0 (the last sequence of a page).
+ */
+static void putSequence(std::vector<char>& out, const unsigned char* literals, const std::size_t numLiterals,
+                        const std::size_t offset, const std::size_t matchLength)
+{
+  const std::size_t extra = matchLength > 0 ? matchLength - MIN_MATCH : 0;
+  out.push_back((char) ((std::min<std::size_t>(numLiterals, 15) << 4) | std::min<std::size_t>(extra, 15)));
+  if (numLiterals >= 15)
+    putLength(out, numLiterals - 15);
+  out.insert(out.end(), literals, literals + numLiterals);
+
+  if (matchLength > 0)
+  {
+    out.push_back((char) (offset & 0xff));
+    out.push_back((char) (offset >> 8));
+    if (extra >= 15)
+      putLength(out, extra - 15);
+  }
+}
+
+bool VictimCache::compress(const Page& page, std::vector<char>& out)
+{
+  const unsigned char* src = reinterpret_cast<const unsigned char*>(&page);
+  const std::size_t size = Page::SIZE;
+
+  // most recent position of each hashed 4-byte sequence
+  std::int32_t lastSeen[1 << HASH_BITS];
+  std::fill(lastSeen, lastSeen + (1 << HASH_BITS), -1);
+
+  out.clear();
+  std::size_t pos = 0;
+  std::size_t anchor = 0;
+  while (pos + MIN_MATCH <= size)
+  {
+    const std::uint32_t sequence = read32(src + pos);
+    const std::uint32_t h = (sequence * 2654435761u) >> (32 - HASH_BITS);
+    const std::int32_t candidate = lastSeen[h];
+    lastSeen[h] = (std::int32_t) pos;
+
+    if (candidate < 0 || pos - candidate > 0xffff || read32(src + candidate) != sequence)
+    {
+      // step faster the longer nothing has matched, to give up on noise quickly
+      pos += 1 + ((pos - anchor) >> 5);
+      if (out.size() + (pos - anchor) > MAX_STORED_SIZE)
+        return false;
+      continue;
+    }
+
+    // extend the match a word at a time, then to the first differing byte
+    std::size_t length = MIN_MATCH;
+    while (pos + length + 8 <= size && read64(src + candidate + length) == read64(src + pos + length))
+      length += 8;
+    while (pos + length < size && src[candidate + length] == src[pos + length])
+      length++;
+    putSequence(out, src + anchor, pos - anchor, pos - candidate, length);
+    pos += length;
+    anchor = pos;
+
+    if (out.size() > MAX_STORED_SIZE)
+      return false;
+  }
+  putSequence(out, src + anchor, size - anchor, 0, 0);
+
+  return out.size() <= MAX_STORED_SIZE;
+}
+
+bool VictimCache::decompress(const std::vector<char>& in, Page& page)
+{
+  unsigned char* dst = reinterpret_cast<unsigned char*>(&page);
+  const std::size_t size = Page::SIZE;
+  const unsigned char* ip = reinterpret_cast<const unsigned char*>(in.data());
+  const unsigned char* end = ip + in.size();
+  std::size_t pos = 0;
+
+  while (ip < end)
+  {
+    const unsigned char token = *ip++;
+
+    std::size_t numLiterals = token >> 4;
+    if (numLiterals == 15 && !getLength(ip, end, numLiterals))
+      return false;
+    if ((std::size_t) (end - ip) < numLiterals || size - pos < numLiterals)
+      return false;
+    std::memcpy(dst + pos, ip, numLiterals);
+    pos += numLiterals;
+    ip += numLiterals;
+    if (ip == end)
+      break;
+
+    if (end - ip < 2)
+      return false;
+    const std::size_t offset = ip[0] | ((std::size_t) ip[1] << 8);
+    ip += 2;
+    std::size_t length = token & 15;
+    if (length == 15 && !getLength(ip, end, length))
+      return false;
+    length += MIN_MATCH;
+    if (offset == 0 || offset > pos || size - pos < length)
+      return false;
+
+    // a match may overlap the bytes it produces, e.g. a run of zeros at offset
+    // 1.  Such a match repeats the offset bytes before it, so it is copied in
+    // doubling chunks, each from the start of the pattern.
+    const unsigned char* pattern = dst + pos - offset;
+    std::size_t copied = 0;
+    while (copied < length)
+    {
+      const std::size_t chunk = std::min(length - copied, offset + copied);
+      std::memcpy(dst + pos + copied, pattern, chunk);
+      copied += chunk;
+    }
+    pos += length;
+  }
+
+  return pos == size;
+}
+
+//----------------------------------------
+// Constructor of the class VictimCache
+//----------------------------------------
+
+const std::size_t VictimCache::MAX_STORED_SIZE;
+const std::size_t VictimCache::ENTRY_OVERHEAD;
+
+VictimCache::VictimCache(const std::size_t budgetBytes)
+  : budget(budgetBytes), used(0)
+{
+}
+
+bool VictimCache::insert(const File* file, const PageId pageNo, const std::vector<char>& compressed,
+                         std::uint32_t& dropped)
+{
+  const PageKey key(file, pageNo);
+  dropped = 0;
+  if (pending.erase(key) == 0)
+    return false;
+
+  std::map<PageKey, Entry>::iterator it = entries.find(key);
+  if (it != entries.end())
+    erase(it);
+
+  Entry& entry = entries[key];
+  entry.data.assign(compressed.begin(), compressed.end());
+  ages.push_front(key);
+  entry.age = ages.begin();
+  used += entry.data.size() + ENTRY_OVERHEAD;
+
+  dropped = trim();
+  return true;
+}
+
+bool VictimCache::take(const File* file, const PageId pageNo, std::vector<char>& compressed)
+{
+  std::map<PageKey, Entry>::iterator it = entries.find(std::make_pair(file, pageNo));
+  if (it == entries.end())
+    return false;
+
+  compressed.swap(it->second.data);
+  used -= compressed.size() + ENTRY_OVERHEAD;
+  ages.erase(it->second.age);
+  entries.erase(it);
+  return true;
+}
+
+void VictimCache::remove(const File* file, const PageId pageNo)
+{
+  const PageKey key(file, pageNo);
+  pending.erase(key);
+  std::map<PageKey, Entry>::iterator it = entries.find(key);
+  if (it != entries.end())
+    erase(it);
+}
+
+void VictimCache::removeFile(const File* file)
+{
+  const PageKey first(file, 0);
+  std::map<PageKey, Entry>::iterator it = entries.lower_bound(first);
+  while (it != entries.end() && it->first.first == file)
+    erase(it++);
+
+  std::set<PageKey>::iterator p = pending.lower_bound(first);
+  while (p != pending.end() && p->first == file)
+    pending.erase(p++);
+}
+
+std::uint32_t VictimCache::setBudget(const std::size_t budgetBytes)
+{
+  budget = budgetBytes;
+  return trim();
+}
+
+void VictimCache::erase(std::map<PageKey, Entry>::iterator it)
+{
+  used -= it->second.data.size() + ENTRY_OVERHEAD;
+  ages.erase(it->second.age);
+  entries.erase(it);
+}
+
+std::uint32_t VictimCache::trim()
+{
+  std::uint32_t dropped = 0;
+  while (used > budget && !ages.empty())
+  {
+    erase(entries.find(ages.back()));
+    dropped++;
+  }
+  return dropped;
+}
+
+}
@@ -0,0 +1,183 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+#include "file.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+* @brief Compressed copies of clean pages recently evicted from the buffer pool
+*
+* A second tier below the buffer pool: BufMgr hands it the clean pages it evicts,
+* compressed, and looks a page up here before reading it from its file.  A page
+* found here is taken out again, so a page is held either in the pool or here,
+* never in both.  When the compressed pages exceed the memory budget the least
+* recently stored ones are dropped; being clean, they are still on disk.
+*
+* A page is reserved when it is evicted and stored once it has been compressed,
+* outside the partition latch.  Loading the page back into the pool in between
+* cancels the reservation, so a copy which may have gone stale is never stored.
+*
+* Pages are compressed with a small LZ77 codec in the LZ4 block format, which
+* packs the zero-filled tails and repeated keys of index and heap pages well
+* and decompresses a page in a few microseconds.  Pages that do not shrink to
+* MAX_STORED_SIZE are not kept.
+*
+* @warning This class is not threadsafe; BufMgr keeps one per partition and
+* uses it with the partition latch held.  compress and decompress touch no
+* state and can be called without it.
+*/
+class VictimCache
+{
+ public:
+	/**
+	 * Largest compressed page kept, a quarter less than the page itself
+	 */
+  static const std::size_t MAX_STORED_SIZE = Page::SIZE * 3 / 4;
+
+	/**
+	 * Memory charged per stored page on top of its compressed bytes, for the
+	 * index and list entries
+	 */
+  static const std::size_t ENTRY_OVERHEAD = 96;
+
+	/**
+	 * Constructor of VictimCache class
+	 *
+	 * @param budgetBytes 	Memory the compressed pages may take, overheads included
+	 */
+  VictimCache(const std::size_t budgetBytes);
+
+	/**
+	 * Compresses a page.
+	 *
+	 * @param page   	Page to compress
+	 * @param out   	Receives the compressed page
+	 * @return  			False if the page does not compress to MAX_STORED_SIZE bytes or less;
+	 *								out is then undefined.
+	 */
+  static bool compress(const Page& page, std::vector<char>& out);
+
+	/**
+	 * Decompresses a page compressed by compress.
+	 *
+	 * @param in    	Compressed page
+	 * @param page   	Receives the page
+	 * @return  			False if in is not a compressed page.
+	 */
+  static bool decompress(const std::vector<char>& in, Page& page);
+
+	/**
+	 * Reserves a place for a page being evicted, to be filled by insert.
+	 */
+  void reserve(const File* file, const PageId pageNo) { pending.insert(std::make_pair(file, pageNo)); }
+
+	/**
+	 * Stores a compressed page if its reservation still stands, and drops the
+	 * least recently stored pages while the cache is over its budget.
+	 *
+	 * @param file   	File the page belongs to
+	 * @param pageNo  Page number within the file
+	 * @param compressed 	Page as compressed by compress
+	 * @param dropped 	Receives the number of pages dropped to make room
+	 * @return  			False if the reservation was cancelled and nothing was stored.
+	 */
+  bool insert(const File* file, const PageId pageNo, const std::vector<char>& compressed, std::uint32_t& dropped);
+
+	/**
+	 * Removes a page from the cache and returns it, still compressed.
+	 *
+	 * @param file   	File the page belongs to
+	 * @param pageNo  Page number within the file
+	 * @param compressed 	Receives the compressed page
+	 * @return  			False if the page is not in the cache.
+	 */
+  bool take(const File* file, const PageId pageNo, std::vector<char>& compressed);
+
+	/**
+	 * Returns true if the page is in the cache.
+	 */
+  bool contains(const File* file, const PageId pageNo) const
+  {
+    return entries.find(std::make_pair(file, pageNo)) != entries.end();
+  }
+
+	/**
+	 * Drops a page from the cache, if present, and cancels any reservation for it.
+	 */
+  void remove(const File* file, const PageId pageNo);
+
+	/**
+	 * Drops every page of a file from the cache and cancels their reservations.
+	 */
+  void removeFile(const File* file);
+
+	/**
+	 * Changes the memory budget, dropping pages as needed.
+	 *
+	 * @return  			Number of pages dropped
+	 */
+  std::uint32_t setBudget(const std::size_t budgetBytes);
+
+	/**
+	 * Memory taken by the stored pages, overheads included
+	 */
+  std::size_t bytesUsed() const { return used; }
+
+	/**
+	 * Number of pages stored
+	 */
+  std::size_t size() const { return entries.size(); }
+
+ private:
+  typedef std::pair<const File*, PageId> PageKey;
+
+  struct Entry
+  {
+    std::vector<char> data;
+    std::list<PageKey>::iterator age;
+  };
+
+	/**
+	 * Stored pages, ordered so that the pages of a file are adjacent
+	 */
+  std::map<PageKey, Entry> entries;
+
+	/**
+	 * Stored pages, most recently stored at the front
+	 */
+  std::list<PageKey> ages;
+
+	/**
+	 * Pages reserved and not yet stored
+	 */
+  std::set<PageKey> pending;
+
+	/**
+	 * Memory budget and memory in use, in bytes
+	 */
+  std::size_t budget;
+  std::size_t used;
+
+  void erase(std::map<PageKey, Entry>::iterator it);
+
+	/**
+	 * Drops the least recently stored pages until the cache is within its budget.
+	 */
+  std::uint32_t trim();
+};
+
+}